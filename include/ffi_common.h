@@ -77,6 +77,9 @@ void ffi_type_test(ffi_type *a, char *file, int line);
 #define ALIGN(v, a)  (((((size_t) (v))-1) | ((a)-1))+1)
 #define ALIGN_DOWN(v, a) (((size_t) (v)) & -a)
 
+/* The number of elements of T, an FFI_TYPE_ARRAY.  */
+#define FFI_ARRAY_COUNT(t) (((ffi_array_type *) (t))->count)
+
 /* Perform machine dependent cif processing */
 ffi_status ffi_prep_cif_machdep(ffi_cif *cif);
 ffi_status ffi_prep_cif_machdep_var(ffi_cif *cif,
@@ -105,6 +108,242 @@ typedef struct
   void **avalue;
 } extended_cif;
 
+/* Columnar calls.  The machine dependent routine returns FFI_OK if it
+   performed all the calls, or anything else to fall back to the
+   generic per-row loop.  */
+#ifdef FFI_TARGET_HAS_COLUMN_CALL
+ffi_status ffi_call_columns_machdep (ffi_cif *cif, void (*fn)(void),
+				     size_t nrows, void *rvalue,
+				     size_t rstride, void **columns,
+				     const size_t *strides) FFI_HIDDEN;
+#endif
+int ffi_column_rvalue_is_widened (ffi_type *rtype) FFI_HIDDEN;
+void ffi_column_store_rvalue (ffi_type *rtype, void *dst,
+			      const ffi_arg *src) FFI_HIDDEN;
+
+/* Argument frames.  Generic frames keep a copy of every argument in
+   AVALUE; machine dependent ones leave AVALUE null and keep their
+   marshalled argument area in IMAGE, described by PLAN.  */
+struct ffi_frame
+{
+  ffi_cif *cif;
+  void **avalue;
+  void *image;
+  void *plan;
+};
+
+#ifdef FFI_TARGET_HAS_FRAMES
+ffi_status ffi_prep_frame_machdep (ffi_frame *frame, void **avalue) FFI_HIDDEN;
+void ffi_frame_set_arg_machdep (ffi_frame *frame, unsigned n,
+				void *value) FFI_HIDDEN;
+void ffi_frame_get_arg_machdep (ffi_frame *frame, unsigned n,
+				void *value) FFI_HIDDEN;
+void ffi_frame_call_machdep (ffi_frame *frame, void (*fn)(void),
+			     void *rvalue) FFI_HIDDEN;
+#endif
+
+/* Packed plans.  OFFSETS holds the offset of every argument in the
+   packed buffer.  The machine dependent routine returns FFI_OK if it
+   set up MACHDEP, which is released with free, to load the buffer
+   straight into the argument registers; otherwise calls go through
+   ffi_call.  */
+struct ffi_packed_plan
+{
+  ffi_cif *cif;
+  size_t *offsets;
+  void *machdep;
+};
+
+#ifdef FFI_TARGET_HAS_PACKED_CALL
+ffi_status ffi_prep_packed_plan_machdep (ffi_packed_plan *plan) FFI_HIDDEN;
+void ffi_packed_plan_call_machdep (ffi_packed_plan *plan, void (*fn)(void),
+				   void *rvalue, void *args) FFI_HIDDEN;
+#endif
+
+/* Argument placement.  The machine dependent routine fills in where
+   the return value and each argument of CIF are passed, or returns
+   anything else than FFI_OK if it cannot describe CIF's ABI.  The
+   register names are those of integer or, if FP, floating point
+   register N, for arguments or, if RET, for return values.  */
+#ifdef FFI_TARGET_HAS_EXPLAIN
+ffi_status ffi_explain_machdep (ffi_cif *cif, ffi_placement *rvalue,
+				ffi_placement *args) FFI_HIDDEN;
+const char *ffi_explain_reg_machdep (int fp, int ret, unsigned n) FFI_HIDDEN;
+#endif
+
+/* Describe type T at *POS in the SIZE bytes at BUF, or the signature
+   of CIF in BUF, as in "sint32 (pointer, {double, float})".  The text
+   is cut short if it does not fit.  */
+void ffi_describe_type (char *buf, size_t size, size_t *pos,
+			ffi_type *t) FFI_HIDDEN;
+void ffi_describe_cif (char *buf, size_t size, ffi_cif *cif) FFI_HIDDEN;
+
+/* Raw calls and closures, for ports whose FFI_NATIVE_RAW_API is 0.
+   The machine dependent routines return FFI_OK if they use the raw
+   argument array directly, or anything else to fall back to the
+   translation through a pointer array in raw_api.c.  */
+#ifdef FFI_TARGET_HAS_RAW_CALL
+ffi_status ffi_raw_call_machdep (ffi_cif *cif, void (*fn)(void),
+				 void *rvalue, ffi_raw *raw) FFI_HIDDEN;
+#if FFI_CLOSURES
+ffi_status ffi_prep_raw_closure_machdep (ffi_raw_closure *cl, ffi_cif *cif,
+					 void (*fun)(ffi_cif*,void*,ffi_raw*,void*),
+					 void *user_data,
+					 void *codeloc) FFI_HIDDEN;
+ffi_status ffi_prep_java_raw_closure_machdep (ffi_java_raw_closure *cl,
+					      ffi_cif *cif,
+					      void (*fun)(ffi_cif*,void*,ffi_java_raw*,void*),
+					      void *user_data,
+					      void *codeloc) FFI_HIDDEN;
+#endif
+#endif
+
+/* Java raw plans.  OFFSETS holds the byte offset of every argument in
+   the raw array.  The machine dependent routine returns FFI_OK if it
+   set up MACHDEP, which is released with free, to load the raw array
+   straight into the argument registers; otherwise calls go through
+   ffi_call.  */
+struct ffi_java_raw_plan
+{
+  ffi_cif *cif;
+  size_t *offsets;
+  void *machdep;
+};
+
+#ifdef FFI_TARGET_HAS_JAVA_RAW_PLAN
+ffi_status ffi_prep_java_raw_plan_machdep (ffi_java_raw_plan *plan) FFI_HIDDEN;
+void ffi_java_raw_plan_call_machdep (ffi_java_raw_plan *plan,
+				     void (*fn)(void), void *rvalue,
+				     ffi_java_raw *raw) FFI_HIDDEN;
+#endif
+
+/* Dense closure arrays.  The dispatchers read CIF, FUN and USER_DATA
+   at fixed offsets.  Ports with entry stubs keep them in the
+   executable memory at WRITABLE and CODE; otherwise CLOSURES holds the
+   writable addresses of COUNT whole closures followed by their
+   executable addresses.  */
+#if FFI_CLOSURES
+struct ffi_closure_array
+{
+  ffi_cif *cif;
+  void (*fun)(ffi_cif*,void*,void**,void*);
+  void **user_data;
+  size_t count;
+  void *writable;
+  void *code;
+  void **closures;
+};
+
+#ifdef FFI_TARGET_HAS_CLOSURE_ARRAY
+size_t ffi_closure_array_size_machdep (size_t count) FFI_HIDDEN;
+ffi_status ffi_prep_closure_array_machdep (ffi_closure_array *array) FFI_HIDDEN;
+void *ffi_closure_array_entry_machdep (ffi_closure_array *array,
+				       size_t index) FFI_HIDDEN;
+#endif
+
+/* Forwarding closures.  CIF describes the calls they receive, that is
+   the TARGET signature without its NBOUND leading arguments, whose
+   values are in BOUND.  The machine dependent routine returns FFI_OK
+   if it wrote a stub that calls the target directly, keeping its
+   writable address in STUB; otherwise CLOSURE is an ordinary closure
+   that goes through ffi_call.  */
+struct ffi_forward_closure
+{
+  ffi_cif cif;
+  ffi_cif *target;
+  void (*fn)(void);
+  unsigned nbound;
+  void **bound;
+  void *stub;
+  ffi_closure *closure;
+};
+
+#ifdef FFI_TARGET_HAS_FORWARD_CLOSURE
+ffi_status ffi_prep_forward_closure_machdep (ffi_forward_closure *fwd,
+					     void **code) FFI_HIDDEN;
+#endif
+
+/* Interposers.  The machine dependent routine returns FFI_OK if it
+   set up CLOSURE to replay the incoming registers and stack arguments
+   into FN as they are, keeping whatever it needs in PLAN, which is
+   released with free.  Otherwise CLOSURE is an ordinary closure that
+   goes through ffi_call.  A call made by a machine dependent
+   interposer leaves AVALUE null and describes the incoming arguments
+   with REGS and STACK.  */
+struct ffi_interposer
+{
+  ffi_cif *cif;
+  void (*fn)(void);
+  void (*pre)(ffi_interposer_call *call, void *user_data);
+  void (*post)(ffi_interposer_call *call, void *rvalue, void *user_data);
+  void *user_data;
+  void *plan;
+  ffi_closure *closure;
+};
+
+struct ffi_interposer_call
+{
+  ffi_interposer *interposer;
+  void **avalue;
+  void *regs;
+  char *stack;
+  char *scratch;
+};
+
+#ifdef FFI_TARGET_HAS_INTERPOSER
+ffi_status ffi_prep_interposer_machdep (ffi_interposer *ip,
+					void **code) FFI_HIDDEN;
+const void *ffi_interposer_arg_machdep (ffi_interposer_call *call,
+					unsigned n) FFI_HIDDEN;
+#endif
+
+/* Describe executable memory to profilers and unwinders, see
+   code_map.c.  Any range can be removed, such as the tail of a
+   region.  */
+void ffi_code_map_add (void *code, size_t size, const char *name) FFI_HIDDEN;
+void ffi_code_map_remove (void *code, size_t size) FFI_HIDDEN;
+
+/* Memory for code generated at run time, see closures.c.  */
+void *ffi_closure_code_alloc (size_t size, void **code) FFI_HIDDEN;
+void ffi_closure_code_free (void *ptr) FFI_HIDDEN;
+#endif
+
+/* Static trampolines, see closures.c.  */
+#if FFI_EXEC_STATIC_TRAMP
+int ffi_tramp_is_present (void *code) FFI_HIDDEN;
+void ffi_tramp_set_parms (void *code, void *entry, void *closure) FFI_HIDDEN;
+#endif
+
+/* Statistics hooks, see stats.c.  They compile to nothing unless
+   configured with --enable-stats.  */
+#ifdef FFI_STATS
+enum ffi_stats_counter
+{
+  FFI_STATS_CALLS,
+  FFI_STATS_CLOSURE_CALLS,
+  FFI_STATS_BYTES_MARSHALLED,
+  FFI_STATS_STRUCT_COPIES,
+  FFI_STATS_STACK_BYTES,
+  FFI_STATS_CLOSURE_ALLOCS,
+  FFI_STATS_CLOSURE_FREES,
+  FFI_STATS_EXEC_MAPPED,
+  FFI_STATS_EXEC_UNMAPPED,
+  FFI_STATS_NCOUNTERS
+};
+
+void ffi_stats_add (int counter, size_t n) FFI_HIDDEN;
+void ffi_stats_call (ffi_cif *cif) FFI_HIDDEN;
+void ffi_stats_closure_call (ffi_cif *cif) FFI_HIDDEN;
+
+# define FFI_STATS_ADD(counter, n) ffi_stats_add (counter, n)
+# define FFI_STATS_CALL(cif) ffi_stats_call (cif)
+# define FFI_STATS_CLOSURE_CALL(cif) ffi_stats_closure_call (cif)
+#else
+# define FFI_STATS_ADD(counter, n) ((void) 0)
+# define FFI_STATS_CALL(cif) ((void) 0)
+# define FFI_STATS_CLOSURE_CALL(cif) ((void) 0)
+#endif
+
 /* Terse sized type definitions.  */
 #if defined(_MSC_VER) || defined(__sgi) || defined(__SUNPRO_C)
 typedef unsigned char UINT8;
@@ -140,6 +379,92 @@ typedef float FLOAT32;
 #define LIKELY(x)    __builtin_expect(!!(x),1)
 #define UNLIKELY(x)  __builtin_expect((x)!=0,0)
 
+/* Observer hooks, see observer.c.  With no observer registered they
+   cost one load and a well predicted branch.  Paths that have no
+   avalue vector at hand test FFI_OBSERVING and, while it is true,
+   either build one for ffi_observe or go through ffi_call instead.  */
+extern int ffi_observers_active FFI_HIDDEN;
+void ffi_observe (ffi_observe_event event, ffi_cif *cif, void (*fn)(void),
+		  void *rvalue, void **avalue) FFI_HIDDEN;
+
+#define FFI_OBSERVING()							\
+  UNLIKELY (__atomic_load_n (&ffi_observers_active, __ATOMIC_RELAXED))
+
+#define FFI_OBSERVE(event, cif, fn, rvalue, avalue)			\
+  do {									\
+    if (FFI_OBSERVING ())						\
+      ffi_observe (event, cif, fn, rvalue, avalue);			\
+  } while (0)
+
+/* Precompiled signatures, see aot.c.  ffi_prep_cif binds each cif it
+   prepares while tables are registered; FFI_AOT_CALL is nonzero if it
+   made the call through the cif's precompiled thunk.  */
+extern int ffi_aot_active FFI_HIDDEN;
+void ffi_aot_bind (ffi_cif *cif, int variadic) FFI_HIDDEN;
+int ffi_aot_call (ffi_cif *cif, void (*fn)(void), void *rvalue,
+		  void **avalue) FFI_HIDDEN;
+
+#define FFI_AOT_CALL(cif, fn, rvalue, avalue)				\
+  (UNLIKELY (__atomic_load_n (&ffi_aot_active, __ATOMIC_RELAXED))	\
+   && ffi_aot_call (cif, fn, rvalue, avalue))
+
+/* Profiling hooks, see profile.c.  A profiled routine declares its
+   time stamps with FFI_PROFILE_DECL, takes stamp 0 on entry, 1 when
+   the arguments are marshalled and 2 when the callee returns, and
+   hands them to FFI_PROFILE_RECORD.  The return value is stored by
+   assembly right next to the call, so it counts as callee time.  These
+   compile to nothing unless configured with --enable-profile.  */
+#ifdef FFI_PROFILE
+enum ffi_profile_kind
+{
+  FFI_PROFILE_CALL,
+  FFI_PROFILE_CLOSURE
+};
+
+# if !defined (__x86_64__) && !defined (__i386__) && !defined (__riscv)
+#  include <time.h>
+# endif
+
+/* Read the cycle counter, or the closest thing there is.  */
+static inline UINT64
+ffi_profile_now (void)
+{
+# if defined (__x86_64__) || defined (__i386__)
+  unsigned int lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((UINT64) hi << 32) | lo;
+# elif defined (__riscv)
+  unsigned long c;
+
+  /* Linux only lets user mode read the cycle counter when perf allows
+     it; the time counter can always be read.  */
+#  ifdef __linux__
+  __asm__ __volatile__ ("rdtime %0" : "=r" (c));
+#  else
+  __asm__ __volatile__ ("rdcycle %0" : "=r" (c));
+#  endif
+  return c;
+# else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (UINT64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+# endif
+}
+
+void ffi_profile_record (ffi_cif *cif, int kind, const UINT64 *t) FFI_HIDDEN;
+
+# define FFI_PROFILE_DECL UINT64 ffi_profile_t[3];
+# define FFI_PROFILE_STAMP(i) (ffi_profile_t[i] = ffi_profile_now ())
+# define FFI_PROFILE_RECORD(cif, kind) \
+  ffi_profile_record (cif, kind, ffi_profile_t)
+#else
+# define FFI_PROFILE_DECL
+# define FFI_PROFILE_STAMP(i) ((void) 0)
+# define FFI_PROFILE_RECORD(cif, kind) ((void) 0)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -82,7 +82,8 @@ ffi_clear_cache (void *start, void *end)
 #endif
 
 /* A subroutine of is_vfp_type.  Given a structure type, return the type code
-   of the first non-structure element.  Recurse for structure elements.
+   of the first non-structure element.  Recurse for structure elements,
+   and for arrays, whose only element stands for all of them.
    Return -1 if the structure is in fact empty, i.e. no nested elements.  */
 
 static int
@@ -95,7 +96,8 @@ is_hfa0 (const ffi_type *ty)
     for (i = 0; elements[i]; ++i)
       {
         ret = elements[i]->type;
-        if (ret == FFI_TYPE_STRUCT || ret == FFI_TYPE_COMPLEX)
+        if (ret == FFI_TYPE_STRUCT || ret == FFI_TYPE_COMPLEX
+            || ret == FFI_TYPE_ARRAY)
           {
             ret = is_hfa0 (elements[i]);
             if (ret < 0)
@@ -120,7 +122,8 @@ is_hfa1 (const ffi_type *ty, int candidate)
     for (i = 0; elements[i]; ++i)
       {
         int t = elements[i]->type;
-        if (t == FFI_TYPE_STRUCT || t == FFI_TYPE_COMPLEX)
+        if (t == FFI_TYPE_STRUCT || t == FFI_TYPE_COMPLEX
+            || t == FFI_TYPE_ARRAY)
           {
             if (!is_hfa1 (elements[i], candidate))
               return 0;
@@ -181,7 +184,8 @@ is_vfp_type (const ffi_type *ty)
   /* Find the type of the first non-structure member.  */
   elements = ty->elements;
   candidate = elements[0]->type;
-  if (candidate == FFI_TYPE_STRUCT || candidate == FFI_TYPE_COMPLEX)
+  if (candidate == FFI_TYPE_STRUCT || candidate == FFI_TYPE_COMPLEX
+      || candidate == FFI_TYPE_ARRAY)
     {
       for (i = 0; ; ++i)
         {
@@ -220,7 +224,8 @@ is_vfp_type (const ffi_type *ty)
   for (i = 0; elements[i]; ++i)
     {
       int t = elements[i]->type;
-      if (t == FFI_TYPE_STRUCT || t == FFI_TYPE_COMPLEX)
+      if (t == FFI_TYPE_STRUCT || t == FFI_TYPE_COMPLEX
+          || t == FFI_TYPE_ARRAY)
         {
           if (!is_hfa1 (elements[i], candidate))
             return 0;
@@ -77,5 +77,6 @@ typedef enum ffi_abi
 #endif
 
 #define FFI_TARGET_HAS_COMPLEX_TYPE
+#define FFI_TARGET_HAS_ARRAY_TYPE
 
 #endif
@@ -0,0 +1,426 @@
+/* -----------------------------------------------------------------------
+   aot.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file keeps the tables of precompiled signatures emitted by
+   src/riscv/aot.py.  ffi_prep_cif looks every cif up in the tables and
+   binds matching ones to their call thunk in a small cache indexed by
+   the cif's address, which leaves the layout of ffi_cif alone; ffi_call
+   then finds the thunk there and skips the generic marshalling.  A
+   binding is changed under a lock and bracketed by a sequence count,
+   as in observer.c, and is only used while the cif still has the
+   types it was bound with.
+
+   Cifs whose addresses share a slot are chained from it.  Once a
+   chain is full, the slot is marked, and further bindings go to an
+   overflow table that only calls missing in a marked slot search, so
+   a binding is never lost.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+static pthread_mutex_t ffi_aot_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ffi_aot_lock() pthread_mutex_lock (&ffi_aot_lock)
+#define ffi_aot_unlock() pthread_mutex_unlock (&ffi_aot_lock)
+#else
+#define ffi_aot_lock() ((void) 0)
+#define ffi_aot_unlock() ((void) 0)
+#endif
+
+/* The number of cache slots, a power of two, and how many bindings
+   can be chained from each.  */
+#define FFI_AOT_BINDINGS_BITS 10
+#define FFI_AOT_BINDINGS (1 << FFI_AOT_BINDINGS_BITS)
+#define FFI_AOT_CHAIN 4
+
+struct ffi_aot_table
+{
+  const ffi_aot_signature *sigs;
+  unsigned count;
+  uint32_t *hashes;
+  struct ffi_aot_table *next;
+};
+
+struct ffi_aot_binding
+{
+  unsigned seq;			/* Odd while the binding is being changed.  */
+  ffi_cif *cif;
+  ffi_abi abi;
+  unsigned nargs;
+  ffi_type *rtype;
+  ffi_type **arg_types;
+  const ffi_aot_signature *sig;
+  struct ffi_aot_binding *next;	/* More bindings in the same slot.  */
+  int full;			/* In a slot, set once its chain is full.  */
+};
+
+/* The overflow table, open addressed by the cif.  Its entries keep
+   their cif for good.  It is replaced by one twice the size when half
+   full; replaced tables are never freed, as calls may still be
+   searching them.  */
+struct ffi_aot_overflow
+{
+  unsigned bits;
+  unsigned count;
+  struct ffi_aot_binding *entries[1];
+};
+
+static struct ffi_aot_table *ffi_aot_tables;
+static struct ffi_aot_binding ffi_aot_bindings[FFI_AOT_BINDINGS];
+static struct ffi_aot_overflow *ffi_aot_overflow;
+
+int ffi_aot_active;
+
+static uint32_t
+ffi_aot_hash_type (uint32_t h, const ffi_type *t)
+{
+  ffi_type **e;
+
+  h = (h ^ t->type) * 16777619u;
+  if (t->type == FFI_TYPE_ARRAY)
+    h = (h ^ (uint32_t) FFI_ARRAY_COUNT (t)) * 16777619u;
+  if (t->type == FFI_TYPE_STRUCT || t->type == FFI_TYPE_COMPLEX
+      || t->type == FFI_TYPE_ARRAY)
+    {
+      for (e = t->elements; *e; e++)
+	h = ffi_aot_hash_type (h, *e);
+      h = (h ^ 0xff) * 16777619u;
+    }
+  return h;
+}
+
+static uint32_t
+ffi_aot_hash (ffi_abi abi, unsigned nargs, ffi_type *rtype,
+	      ffi_type **arg_types)
+{
+  uint32_t h = (2166136261u ^ abi) * 16777619u;
+  unsigned i;
+
+  h = (h ^ nargs) * 16777619u;
+  h = ffi_aot_hash_type (h, rtype);
+  for (i = 0; i < nargs; i++)
+    h = ffi_aot_hash_type (h, arg_types[i]);
+  return h;
+}
+
+static int
+ffi_aot_same_type (const ffi_type *a, const ffi_type *b)
+{
+  ffi_type **ea, **eb;
+
+  if (a == b)
+    return 1;
+  if (a->type != b->type)
+    return 0;
+  if (a->type == FFI_TYPE_ARRAY && FFI_ARRAY_COUNT (a) != FFI_ARRAY_COUNT (b))
+    return 0;
+  if (a->type != FFI_TYPE_STRUCT && a->type != FFI_TYPE_COMPLEX
+      && a->type != FFI_TYPE_ARRAY)
+    return 1;
+  for (ea = a->elements, eb = b->elements; *ea && *eb; ea++, eb++)
+    if (!ffi_aot_same_type (*ea, *eb))
+      return 0;
+  return *ea == *eb;
+}
+
+/* Return the precompiled signature of CIF, or NULL.  */
+static const ffi_aot_signature *
+ffi_aot_lookup (ffi_cif *cif)
+{
+  struct ffi_aot_table *t;
+  uint32_t h = ffi_aot_hash (cif->abi, cif->nargs, cif->rtype,
+			     cif->arg_types);
+  unsigned i, j;
+
+  for (t = __atomic_load_n (&ffi_aot_tables, __ATOMIC_ACQUIRE); t != NULL;
+       t = t->next)
+    for (i = 0; i < t->count; i++)
+      {
+	const ffi_aot_signature *s = &t->sigs[i];
+
+	if (t->hashes[i] != h || s->abi != cif->abi || s->nargs != cif->nargs
+	    || !ffi_aot_same_type (s->rtype, cif->rtype))
+	  continue;
+	for (j = 0; j < s->nargs; j++)
+	  if (!ffi_aot_same_type (s->arg_types[j], cif->arg_types[j]))
+	    break;
+	if (j == s->nargs)
+	  return s;
+      }
+  return NULL;
+}
+
+/* Hash CIF into BITS bits.  The high bits of the product depend on
+   all of the address; the low ones would repeat for cifs 16 KiB
+   apart.  */
+static unsigned
+ffi_aot_index (ffi_cif *cif, uint32_t mult, unsigned bits)
+{
+  return ((uint32_t) ((uintptr_t) cif >> 4) * mult) >> (32 - bits);
+}
+
+static struct ffi_aot_binding *
+ffi_aot_slot (ffi_cif *cif)
+{
+  return &ffi_aot_bindings[ffi_aot_index (cif, 2654435761u,
+					  FFI_AOT_BINDINGS_BITS)];
+}
+
+/* Return the entry for CIF in the overflow table O, or the empty
+   entry where it would go.  The overflow table uses another
+   multiplier, so that cifs sharing a slot are spread out.  */
+static struct ffi_aot_binding **
+ffi_aot_overflow_entry (struct ffi_aot_overflow *o, ffi_cif *cif)
+{
+  unsigned mask = (1u << o->bits) - 1;
+  unsigned i = ffi_aot_index (cif, 2246822519u, o->bits);
+  struct ffi_aot_binding *b;
+
+  while ((b = __atomic_load_n (&o->entries[i], __ATOMIC_ACQUIRE)) != NULL
+	 && __atomic_load_n (&b->cif, __ATOMIC_RELAXED) != cif)
+    i = (i + 1) & mask;
+  return &o->entries[i];
+}
+
+/* Return the binding of CIF in the overflow table, or NULL.  */
+static struct ffi_aot_binding *
+ffi_aot_overflow_find (ffi_cif *cif)
+{
+  struct ffi_aot_overflow *o
+    = __atomic_load_n (&ffi_aot_overflow, __ATOMIC_ACQUIRE);
+
+  return o != NULL ? __atomic_load_n (ffi_aot_overflow_entry (o, cif),
+				      __ATOMIC_ACQUIRE) : NULL;
+}
+
+/* Add the new binding B to the overflow table, growing it if need
+   be.  Called with the lock held.  Return 0 if memory ran out.  */
+static int
+ffi_aot_overflow_add (struct ffi_aot_binding *b)
+{
+  struct ffi_aot_overflow *o = ffi_aot_overflow, *n;
+  unsigned i;
+
+  if (o == NULL || 2 * (o->count + 1) > (1u << o->bits))
+    {
+      unsigned bits = o != NULL ? o->bits + 1 : 6;
+
+      n = calloc (1, sizeof (*n)
+		  + ((1u << bits) - 1) * sizeof (n->entries[0]));
+      if (n == NULL)
+	return 0;
+      n->bits = bits;
+      if (o != NULL)
+	for (i = 0; i < (1u << o->bits); i++)
+	  if (o->entries[i] != NULL)
+	    {
+	      *ffi_aot_overflow_entry (n, o->entries[i]->cif) = o->entries[i];
+	      n->count++;
+	    }
+      __atomic_store_n (&ffi_aot_overflow, n, __ATOMIC_RELEASE);
+      o = n;
+    }
+
+  __atomic_store_n (ffi_aot_overflow_entry (o, b->cif), b, __ATOMIC_RELEASE);
+  o->count++;
+  return 1;
+}
+
+/* Return the binding of CIF in the chain from SLOT, or NULL.  */
+static struct ffi_aot_binding *
+ffi_aot_find (struct ffi_aot_binding *slot, ffi_cif *cif)
+{
+  struct ffi_aot_binding *b;
+
+  for (b = slot; b != NULL; b = __atomic_load_n (&b->next, __ATOMIC_ACQUIRE))
+    if (__atomic_load_n (&b->cif, __ATOMIC_RELAXED) == cif)
+      return b;
+  return NULL;
+}
+
+/* Bind CIF to SIG in B.  Called with the lock held.  */
+static void
+ffi_aot_set (struct ffi_aot_binding *b, ffi_cif *cif,
+	     const ffi_aot_signature *sig)
+{
+  __atomic_store_n (&b->seq, b->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  __atomic_store_n (&b->cif, cif, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->abi, cif->abi, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->nargs, cif->nargs, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->rtype, cif->rtype, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->arg_types, cif->arg_types, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->sig, sig, __ATOMIC_RELAXED);
+  __atomic_store_n (&b->seq, b->seq + 1, __ATOMIC_RELEASE);
+}
+
+ffi_status
+ffi_aot_register (const ffi_aot_signature *sigs, unsigned int count)
+{
+  struct ffi_aot_table *t;
+  unsigned i;
+
+  if (sigs == NULL && count)
+    return FFI_BAD_TYPEDEF;
+  t = malloc (sizeof (*t));
+  if (t == NULL || (t->hashes = malloc (count * sizeof (uint32_t) + 1))
+      == NULL)
+    {
+      free (t);
+      return FFI_BAD_TYPEDEF;
+    }
+  t->sigs = sigs;
+  t->count = count;
+  for (i = 0; i < count; i++)
+    t->hashes[i] = ffi_aot_hash (sigs[i].abi, sigs[i].nargs, sigs[i].rtype,
+				 sigs[i].arg_types);
+
+  ffi_aot_lock ();
+  t->next = ffi_aot_tables;
+  __atomic_store_n (&ffi_aot_tables, t, __ATOMIC_RELEASE);
+  __atomic_store_n (&ffi_aot_active, 1, __ATOMIC_RELAXED);
+  ffi_aot_unlock ();
+  return FFI_OK;
+}
+
+void
+ffi_aot_bind (ffi_cif *cif, int variadic)
+{
+  const ffi_aot_signature *sig = variadic ? NULL : ffi_aot_lookup (cif);
+  struct ffi_aot_binding *slot = ffi_aot_slot (cif), *b, *spare = NULL;
+  unsigned n = 0;
+
+  if (sig == NULL && ffi_aot_find (slot, cif) == NULL
+      && (!__atomic_load_n (&slot->full, __ATOMIC_RELAXED)
+	  || ffi_aot_overflow_find (cif) == NULL))
+    return;
+
+  ffi_aot_lock ();
+  for (b = slot; b != NULL; b = b->next, n++)
+    {
+      if (b->cif == cif)
+	break;
+      /* Bindings without a signature can be given to another cif.  */
+      if (spare == NULL && (b->cif == NULL || b->sig == NULL))
+	spare = b;
+    }
+  if (b == NULL && slot->full)
+    b = ffi_aot_overflow_find (cif);
+
+  if (b == NULL && sig != NULL)
+    {
+      b = spare;
+      if (b == NULL && (b = calloc (1, sizeof (*b))) != NULL)
+	{
+	  ffi_aot_set (b, cif, sig);
+	  if (n <= FFI_AOT_CHAIN)
+	    {
+	      b->next = slot->next;
+	      __atomic_store_n (&slot->next, b, __ATOMIC_RELEASE);
+	    }
+	  else
+	    {
+	      __atomic_store_n (&slot->full, 1, __ATOMIC_RELAXED);
+	      if (!ffi_aot_overflow_add (b))
+		free (b);
+	    }
+	  b = NULL;
+	}
+    }
+  if (b != NULL)
+    ffi_aot_set (b, cif, sig);
+  ffi_aot_unlock ();
+}
+
+int
+ffi_aot_call (ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+{
+  struct ffi_aot_binding *slot = ffi_aot_slot (cif);
+  struct ffi_aot_binding *b = ffi_aot_find (slot, cif);
+  const ffi_aot_signature *sig;
+  unsigned seq;
+  int same;
+
+  if (b == NULL && __atomic_load_n (&slot->full, __ATOMIC_RELAXED))
+    b = ffi_aot_overflow_find (cif);
+  if (b == NULL)
+    return 0;
+
+  seq = __atomic_load_n (&b->seq, __ATOMIC_ACQUIRE);
+  if ((seq & 1) || __atomic_load_n (&b->cif, __ATOMIC_RELAXED) != cif)
+    return 0;
+  sig = __atomic_load_n (&b->sig, __ATOMIC_RELAXED);
+  same = (__atomic_load_n (&b->abi, __ATOMIC_RELAXED) == cif->abi
+	  && __atomic_load_n (&b->nargs, __ATOMIC_RELAXED) == cif->nargs
+	  && __atomic_load_n (&b->rtype, __ATOMIC_RELAXED) == cif->rtype
+	  && (__atomic_load_n (&b->arg_types, __ATOMIC_RELAXED)
+	      == cif->arg_types));
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  if (__atomic_load_n (&b->seq, __ATOMIC_RELAXED) != seq
+      || sig == NULL || !same)
+    return 0;
+
+  sig->call (fn, rvalue, avalue);
+  return 1;
+}
+
+ffi_aot_closure *
+ffi_aot_closure_alloc (ffi_cif *cif,
+		       void (*fun)(ffi_cif*,void*,void**,void*),
+		       void *user_data, void **code)
+{
+  const ffi_aot_signature *sig = ffi_aot_lookup (cif);
+  unsigned i;
+
+  if (sig == NULL)
+    return NULL;
+  for (i = 0; i < sig->nclosures; i++)
+    {
+      ffi_aot_closure *c = &sig->closures[i];
+      int expected = 0;
+
+      if (__atomic_compare_exchange_n (&c->used, &expected, 1, 0,
+				       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+	  c->cif = cif;
+	  c->fun = fun;
+	  c->user_data = user_data;
+	  *code = (void *) sig->entries[i];
+	  return c;
+	}
+    }
+  return NULL;
+}
+
+void
+ffi_aot_closure_free (ffi_aot_closure *closure)
+{
+  if (closure != NULL)
+    __atomic_store_n (&closure->used, 0, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,552 @@
+/* -----------------------------------------------------------------------
+   cif_cache.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file keeps prepared cifs in a file, so that a program that
+   prepares the same signatures on every start can load the results
+   instead of computing them again.
+
+   A cache file is only read by the build of libffi that wrote it, so it
+   is in native byte order and holds ffi_cif images as they are.  It
+   starts with a header naming the build, followed by COUNT records:
+
+     u32 size, u32 hash, u32 ntypes, u32 unused,
+     the prepared ffi_cif, with its pointers cleared,
+     NTYPES type nodes.
+
+   The type nodes are the return type and the argument types in
+   preorder, each with its size, alignment, FFI_TYPE_ code and number of
+   elements; an array is followed by the one node of its element type.
+   A record is used for a cif whose types have the same codes and shape,
+   and whatever sizes and alignments are already known agree; the
+   others are filled in from the record, in place of
+   initialize_aggregate.  The hash covers the abi, the number of
+   arguments and the codes and shape of the types.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+static pthread_mutex_t ffi_cif_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ffi_cif_cache_lock() pthread_mutex_lock (&ffi_cif_cache_lock)
+#define ffi_cif_cache_unlock() pthread_mutex_unlock (&ffi_cif_cache_lock)
+#else
+#define ffi_cif_cache_lock() ((void) 0)
+#define ffi_cif_cache_unlock() ((void) 0)
+#endif
+
+#define FFI_CIF_CACHE_MAGIC "FFICIFS\0"
+#define FFI_CIF_CACHE_VERSION 1
+
+/* The deepest nesting of types and the most types in one record.  */
+#define FFI_CIF_CACHE_DEPTH 32
+#define FFI_CIF_CACHE_TYPES 65536
+
+struct ffi_cif_cache_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t cif_size;
+  uint32_t pointer_size;
+  uint32_t default_abi;
+  uint32_t count;
+  char package[32];
+};
+
+struct ffi_cif_cache_record
+{
+  uint32_t size;
+  uint32_t hash;
+  uint32_t ntypes;
+  uint32_t unused;
+  ffi_cif cif;
+};
+
+struct ffi_cif_cache_node
+{
+  uint64_t size;
+  uint16_t alignment;
+  uint16_t type;
+  uint32_t nelements;
+};
+
+struct ffi_cif_cache
+{
+  void *map;			/* The file that was opened, or NULL.  */
+  size_t map_size;
+  int mapped;			/* Whether MAP was mmapped or malloced.  */
+
+  /* Records from the file and records added since, indexed by hash
+     with linear probing.  */
+  const struct ffi_cif_cache_record **index;
+  size_t index_size;
+  size_t count;
+
+  struct ffi_cif_cache_record **added;
+  size_t nadded;
+  size_t added_size;
+
+  size_t hits;
+  size_t misses;
+};
+
+static void
+ffi_cif_cache_init_header (struct ffi_cif_cache_header *h, uint32_t count)
+{
+  memset (h, 0, sizeof (*h));
+  memcpy (h->magic, FFI_CIF_CACHE_MAGIC, 8);
+  h->version = FFI_CIF_CACHE_VERSION;
+  h->byte_order = 0x01020304;
+  h->cif_size = sizeof (ffi_cif);
+  h->pointer_size = sizeof (void *);
+  h->default_abi = FFI_DEFAULT_ABI;
+  h->count = count;
+  strncpy (h->package, PACKAGE_VERSION, sizeof (h->package) - 1);
+}
+
+static size_t
+ffi_cif_cache_nelements (const ffi_type *t)
+{
+  size_t n = 0;
+
+  if (t->type == FFI_TYPE_ARRAY)
+    return FFI_ARRAY_COUNT (t);
+  if (t->type == FFI_TYPE_COMPLEX)
+    return 1;
+  if (t->type == FFI_TYPE_STRUCT)
+    while (t->elements[n])
+      n++;
+  return n;
+}
+
+/* The number of nodes that follow the node of T.  */
+static size_t
+ffi_cif_cache_nchildren (const ffi_type *t)
+{
+  return t->type == FFI_TYPE_ARRAY ? 1 : ffi_cif_cache_nelements (t);
+}
+
+/* Add the code and shape of T to *HASH and its number of nodes to
+   *NTYPES.  Return zero if T is too deep or too large to cache.  */
+static int
+ffi_cif_cache_walk (const ffi_type *t, uint32_t *hash, size_t *ntypes,
+		    int depth)
+{
+  size_t i, n = ffi_cif_cache_nelements (t);
+
+  if (depth > FFI_CIF_CACHE_DEPTH || ++*ntypes > FFI_CIF_CACHE_TYPES
+      || n > UINT32_MAX)
+    return 0;
+  *hash = (*hash ^ t->type) * 16777619u;
+  *hash = (*hash ^ (uint32_t) n) * 16777619u;
+  for (i = 0, n = ffi_cif_cache_nchildren (t); i < n; i++)
+    if (!ffi_cif_cache_walk (t->elements[i], hash, ntypes, depth + 1))
+      return 0;
+  return 1;
+}
+
+/* Return nonzero if the nodes at *NODE describe T.  */
+static int
+ffi_cif_cache_match (const struct ffi_cif_cache_node **node,
+		     const ffi_type *t)
+{
+  const struct ffi_cif_cache_node *n = (*node)++;
+  size_t i;
+
+  if (n->type != t->type || n->nelements != ffi_cif_cache_nelements (t))
+    return 0;
+  if (t->size != 0 && (n->size != t->size || n->alignment != t->alignment))
+    return 0;
+  for (i = 0; i < ffi_cif_cache_nchildren (t); i++)
+    if (!ffi_cif_cache_match (node, t->elements[i]))
+      return 0;
+  return 1;
+}
+
+/* Give T and its elements the sizes and alignments at *NODE.  */
+static void
+ffi_cif_cache_apply (const struct ffi_cif_cache_node **node, ffi_type *t)
+{
+  const struct ffi_cif_cache_node *n = (*node)++;
+  size_t i;
+
+  for (i = 0; i < ffi_cif_cache_nchildren (t); i++)
+    ffi_cif_cache_apply (node, t->elements[i]);
+  if (t->size == 0)
+    {
+      t->size = n->size;
+      t->alignment = n->alignment;
+    }
+}
+
+static void
+ffi_cif_cache_encode (struct ffi_cif_cache_node **node, const ffi_type *t)
+{
+  struct ffi_cif_cache_node *n = (*node)++;
+  size_t i;
+
+  n->size = t->size;
+  n->alignment = t->alignment;
+  n->type = t->type;
+  n->nelements = ffi_cif_cache_nelements (t);
+  for (i = 0; i < ffi_cif_cache_nchildren (t); i++)
+    ffi_cif_cache_encode (node, t->elements[i]);
+}
+
+static const struct ffi_cif_cache_node *
+ffi_cif_cache_nodes (const struct ffi_cif_cache_record *r)
+{
+  return (const struct ffi_cif_cache_node *) (r + 1);
+}
+
+/* Return nonzero if record R describes the signature.  */
+static int
+ffi_cif_cache_matches (const struct ffi_cif_cache_record *r, uint32_t hash,
+		       size_t ntypes, ffi_abi abi, unsigned nargs,
+		       ffi_type *rtype, ffi_type **atypes)
+{
+  const struct ffi_cif_cache_node *node = ffi_cif_cache_nodes (r);
+  unsigned i;
+
+  if (r->hash != hash || r->ntypes != ntypes || r->cif.abi != abi
+      || r->cif.nargs != nargs || !ffi_cif_cache_match (&node, rtype))
+    return 0;
+  for (i = 0; i < nargs; i++)
+    if (!ffi_cif_cache_match (&node, atypes[i]))
+      return 0;
+  return 1;
+}
+
+/* Add R to the index of CACHE.  */
+static int
+ffi_cif_cache_insert (ffi_cif_cache *cache,
+		      const struct ffi_cif_cache_record *r)
+{
+  size_t i;
+
+  if (2 * (cache->count + 1) > cache->index_size)
+    {
+      const struct ffi_cif_cache_record **old = cache->index;
+      size_t old_size = cache->index_size;
+      size_t size = old_size ? 2 * old_size : 64;
+
+      cache->index = calloc (size, sizeof (*cache->index));
+      if (cache->index == NULL)
+	{
+	  cache->index = old;
+	  return 0;
+	}
+      cache->index_size = size;
+      cache->count = 0;
+      for (i = 0; i < old_size; i++)
+	if (old[i] != NULL)
+	  ffi_cif_cache_insert (cache, old[i]);
+      free (old);
+    }
+
+  for (i = r->hash & (cache->index_size - 1); cache->index[i] != NULL;
+       i = (i + 1) & (cache->index_size - 1))
+    ;
+  cache->index[i] = r;
+  cache->count++;
+  return 1;
+}
+
+/* Index the records in the file CACHE->MAP.  Return zero if it is not
+   a valid cache written by this build.  */
+static int
+ffi_cif_cache_parse (ffi_cif_cache *cache)
+{
+  const char *p = cache->map, *end = p + cache->map_size;
+  struct ffi_cif_cache_header h;
+  uint32_t i, count;
+
+  if (cache->map_size < sizeof (h))
+    return 0;
+  memcpy (&count, p + offsetof (struct ffi_cif_cache_header, count),
+	  sizeof (count));
+  ffi_cif_cache_init_header (&h, count);
+  if (memcmp (p, &h, sizeof (h)) != 0)
+    return 0;
+
+  for (p += sizeof (h), i = 0; i < count; i++)
+    {
+      const struct ffi_cif_cache_record *r
+	= (const struct ffi_cif_cache_record *) p;
+
+      if ((size_t) (end - p) < sizeof (*r)
+	  || r->ntypes > FFI_CIF_CACHE_TYPES
+	  || r->size != (sizeof (*r)
+			 + r->ntypes * sizeof (struct ffi_cif_cache_node))
+	  || (size_t) (end - p) < r->size
+	  || r->ntypes < 1 + r->cif.nargs)
+	return 0;
+      if (!ffi_cif_cache_insert (cache, r))
+	return 0;
+      p += r->size;
+    }
+  return p == end;
+}
+
+ffi_cif_cache *
+ffi_cif_cache_open (const char *path)
+{
+  ffi_cif_cache *cache = calloc (1, sizeof (*cache));
+  struct stat st;
+  int fd;
+
+  if (cache == NULL || path == NULL)
+    return cache;
+  if ((fd = open (path, O_RDONLY)) < 0)
+    return cache;
+
+  if (fstat (fd, &st) == 0 && st.st_size > 0)
+    {
+      cache->map_size = st.st_size;
+#ifdef HAVE_SYS_MMAN_H
+      cache->map = mmap (NULL, cache->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (cache->map == MAP_FAILED)
+	cache->map = NULL;
+      else
+	cache->mapped = 1;
+#endif
+      if (cache->map == NULL && (cache->map = malloc (cache->map_size)))
+	{
+	  size_t n = 0;
+	  ssize_t r;
+
+	  while (n < cache->map_size
+		 && (r = read (fd, (char *) cache->map + n,
+			       cache->map_size - n)) > 0)
+	    n += r;
+	  if (n < cache->map_size)
+	    {
+	      free (cache->map);
+	      cache->map = NULL;
+	    }
+	}
+    }
+  close (fd);
+
+  /* A file that does not belong to this build is ignored, and replaced
+     when the cache is saved.  */
+  if (cache->map != NULL && !ffi_cif_cache_parse (cache))
+    {
+      free (cache->index);
+      cache->index = NULL;
+      cache->index_size = cache->count = 0;
+    }
+  return cache;
+}
+
+/* Record the prepared CIF in CACHE.  Called with the lock held.  */
+static void
+ffi_cif_cache_add (ffi_cif_cache *cache, const ffi_cif *cif, uint32_t hash,
+		   size_t ntypes)
+{
+  struct ffi_cif_cache_record *r;
+  struct ffi_cif_cache_node *node;
+  size_t size = sizeof (*r) + ntypes * sizeof (struct ffi_cif_cache_node);
+  unsigned i;
+
+  if (cache->nadded == cache->added_size)
+    {
+      size_t n = cache->added_size ? 2 * cache->added_size : 64;
+      struct ffi_cif_cache_record **a
+	= realloc (cache->added, n * sizeof (*a));
+
+      if (a == NULL)
+	return;
+      cache->added = a;
+      cache->added_size = n;
+    }
+  if ((r = calloc (1, size)) == NULL)
+    return;
+
+  r->size = size;
+  r->hash = hash;
+  r->ntypes = ntypes;
+  r->cif = *cif;
+  r->cif.arg_types = NULL;
+  r->cif.rtype = NULL;
+  node = (struct ffi_cif_cache_node *) (r + 1);
+  ffi_cif_cache_encode (&node, cif->rtype);
+  for (i = 0; i < cif->nargs; i++)
+    ffi_cif_cache_encode (&node, cif->arg_types[i]);
+
+  if (!ffi_cif_cache_insert (cache, r))
+    {
+      free (r);
+      return;
+    }
+  cache->added[cache->nadded++] = r;
+}
+
+ffi_status
+ffi_prep_cif_cached (ffi_cif_cache *cache, ffi_cif *cif, ffi_abi abi,
+		     unsigned int nargs, ffi_type *rtype, ffi_type **atypes)
+{
+  const struct ffi_cif_cache_record *r = NULL;
+  const struct ffi_cif_cache_node *node;
+  uint32_t hash = (2166136261u ^ abi) * 16777619u;
+  size_t ntypes = 0, i;
+  unsigned j;
+  ffi_status status;
+
+  if (cache == NULL)
+    return ffi_prep_cif (cif, abi, nargs, rtype, atypes);
+  if (! (abi > FFI_FIRST_ABI && abi < FFI_LAST_ABI))
+    return FFI_BAD_ABI;
+
+#if HAVE_LONG_DOUBLE_VARIANT
+  ffi_prep_types (abi);
+#endif
+
+  hash = (hash ^ nargs) * 16777619u;
+  if (!ffi_cif_cache_walk (rtype, &hash, &ntypes, 0))
+    return ffi_prep_cif (cif, abi, nargs, rtype, atypes);
+  for (j = 0; j < nargs; j++)
+    if (!ffi_cif_cache_walk (atypes[j], &hash, &ntypes, 0))
+      return ffi_prep_cif (cif, abi, nargs, rtype, atypes);
+
+  ffi_cif_cache_lock ();
+  if (cache->index_size)
+    for (i = hash & (cache->index_size - 1); cache->index[i] != NULL;
+	 i = (i + 1) & (cache->index_size - 1))
+      if (ffi_cif_cache_matches (cache->index[i], hash, ntypes, abi, nargs,
+				 rtype, atypes))
+	{
+	  r = cache->index[i];
+	  break;
+	}
+
+  if (r != NULL)
+    {
+      cache->hits++;
+      node = ffi_cif_cache_nodes (r);
+      ffi_cif_cache_apply (&node, rtype);
+      for (j = 0; j < nargs; j++)
+	ffi_cif_cache_apply (&node, atypes[j]);
+      ffi_cif_cache_unlock ();
+
+      *cif = r->cif;
+      cif->arg_types = atypes;
+      cif->rtype = rtype;
+      if (UNLIKELY (__atomic_load_n (&ffi_aot_active, __ATOMIC_RELAXED)))
+	ffi_aot_bind (cif, 0);
+      return FFI_OK;
+    }
+
+  cache->misses++;
+  ffi_cif_cache_unlock ();
+
+  status = ffi_prep_cif (cif, abi, nargs, rtype, atypes);
+  if (status == FFI_OK)
+    {
+      ffi_cif_cache_lock ();
+      ffi_cif_cache_add (cache, cif, hash, ntypes);
+      ffi_cif_cache_unlock ();
+    }
+  return status;
+}
+
+ffi_status
+ffi_cif_cache_save (ffi_cif_cache *cache, const char *path)
+{
+  struct ffi_cif_cache_header h;
+  char *tmp;
+  FILE *f;
+  size_t i;
+  int ok;
+
+  if (cache == NULL || path == NULL
+      || (tmp = malloc (strlen (path) + 5)) == NULL)
+    return FFI_BAD_TYPEDEF;
+  strcpy (tmp, path);
+  strcat (tmp, ".tmp");
+  if ((f = fopen (tmp, "wb")) == NULL)
+    {
+      free (tmp);
+      return FFI_BAD_TYPEDEF;
+    }
+
+  /* Write the index rather than the file and the added records, so
+     that a file that was ignored is left out.  */
+  ffi_cif_cache_lock ();
+  ffi_cif_cache_init_header (&h, cache->count);
+  ok = fwrite (&h, sizeof (h), 1, f) == 1;
+  for (i = 0; ok && i < cache->index_size; i++)
+    if (cache->index[i] != NULL)
+      ok = fwrite (cache->index[i], cache->index[i]->size, 1, f) == 1;
+  ffi_cif_cache_unlock ();
+
+  ok = fclose (f) == 0 && ok;
+  ok = ok && rename (tmp, path) == 0;
+  if (!ok)
+    remove (tmp);
+  free (tmp);
+  return ok ? FFI_OK : FFI_BAD_TYPEDEF;
+}
+
+void
+ffi_cif_cache_stats (ffi_cif_cache *cache, size_t *hits, size_t *misses)
+{
+  ffi_cif_cache_lock ();
+  *hits = cache->hits;
+  *misses = cache->misses;
+  ffi_cif_cache_unlock ();
+}
+
+void
+ffi_cif_cache_free (ffi_cif_cache *cache)
+{
+  size_t i;
+
+  if (cache == NULL)
+    return;
+  for (i = 0; i < cache->nadded; i++)
+    free (cache->added[i]);
+  free (cache->added);
+  free (cache->index);
+#ifdef HAVE_SYS_MMAN_H
+  if (cache->mapped)
+    munmap (cache->map, cache->map_size);
+  else
+#endif
+    free (cache->map);
+  free (cache);
+}
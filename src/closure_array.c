@@ -0,0 +1,165 @@
+/* -----------------------------------------------------------------------
+   closure_array.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines dense closure arrays: COUNT entry points sharing
+   one cif and handler, which differ only in the user_data they pass.
+   Ports that define FFI_TARGET_HAS_CLOSURE_ARRAY lay out tiny entry
+   stubs that encode their index and branch to a shared dispatcher;
+   elsewhere, every entry is a whole closure.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+
+#if FFI_CLOSURES
+
+/* A whole closure standing in for one entry.  */
+typedef struct
+{
+  ffi_closure closure;
+  ffi_closure_array *array;
+  size_t index;
+} ffi_closure_array_slot;
+
+static void
+ffi_closure_array_generic (ffi_cif *cif, void *rvalue, void **avalue,
+			   void *user_data)
+{
+  ffi_closure_array_slot *slot = user_data;
+  ffi_closure_array *array = slot->array;
+
+  array->fun (cif, rvalue, avalue, array->user_data[slot->index]);
+}
+
+static ffi_status
+ffi_prep_closure_array_generic (ffi_closure_array *array)
+{
+  size_t i, count = array->count;
+
+  array->closures = malloc (2 * count * sizeof (void *) + 1);
+  if (array->closures == NULL)
+    return FFI_BAD_TYPEDEF;
+
+  if (count > 0
+      && ffi_closure_alloc_many (count, sizeof (ffi_closure_array_slot),
+				 array->closures,
+				 array->closures + count) == 0)
+    return FFI_BAD_TYPEDEF;
+
+  for (i = 0; i < count; i++)
+    {
+      ffi_closure_array_slot *slot = array->closures[i];
+
+      slot->array = array;
+      slot->index = i;
+      if (ffi_prep_closure_loc (&slot->closure, array->cif,
+				ffi_closure_array_generic, slot,
+				array->closures[count + i]) != FFI_OK)
+	{
+	  ffi_closure_free_many (count, array->closures);
+	  return FFI_BAD_ABI;
+	}
+    }
+
+  return FFI_OK;
+}
+
+ffi_closure_array *
+ffi_closure_array_alloc (ffi_cif *cif,
+			 void (*fun)(ffi_cif*,void*,void**,void*),
+			 size_t count)
+{
+  ffi_closure_array *array;
+
+  if (count > ((size_t) -1 - sizeof (ffi_closure_array))
+	      / (2 * sizeof (void *)))
+    return NULL;
+
+  /* The user_data table follows the array.  */
+  array = calloc (1, sizeof (ffi_closure_array) + count * sizeof (void *));
+  if (array == NULL)
+    return NULL;
+  array->cif = cif;
+  array->fun = fun;
+  array->user_data = (void **) (array + 1);
+  array->count = count;
+
+#ifdef FFI_TARGET_HAS_CLOSURE_ARRAY
+  array->writable
+    = ffi_closure_code_alloc (ffi_closure_array_size_machdep (count),
+			      &array->code);
+  if (array->writable != NULL)
+    {
+      if (ffi_prep_closure_array_machdep (array) == FFI_OK)
+	return array;
+      ffi_closure_code_free (array->writable);
+      array->writable = NULL;
+    }
+#endif
+
+  if (ffi_prep_closure_array_generic (array) != FFI_OK)
+    {
+      free (array->closures);
+      free (array);
+      return NULL;
+    }
+
+  return array;
+}
+
+void **
+ffi_closure_array_user_data (ffi_closure_array *array)
+{
+  return array->user_data;
+}
+
+void *
+ffi_closure_array_entry (ffi_closure_array *array, size_t index)
+{
+#ifdef FFI_TARGET_HAS_CLOSURE_ARRAY
+  if (array->closures == NULL)
+    return ffi_closure_array_entry_machdep (array, index);
+#endif
+
+  return array->closures[array->count + index];
+}
+
+void
+ffi_closure_array_free (ffi_closure_array *array)
+{
+  if (array == NULL)
+    return;
+
+  if (array->writable != NULL)
+    ffi_closure_code_free (array->writable);
+  if (array->closures != NULL)
+    {
+      ffi_closure_free_many (array->count, array->closures);
+      free (array->closures);
+    }
+  free (array);
+}
+
+#endif /* FFI_CLOSURES */
@@ -236,6 +236,7 @@ ffi_closure_alloc (size_t size, void **code)
   closure->trampoline_table = table;
   closure->trampoline_table_entry = entry;
 
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_ALLOCS, 1);
   return closure;
 }
 
@@ -244,6 +245,7 @@ ffi_closure_free (void *ptr)
 {
   ffi_closure *closure = ptr;
 
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_FREES, 1);
   pthread_mutex_lock (&ffi_trampoline_lock);
 
   /* Fetch the table and entry references */
@@ -492,6 +494,57 @@ static int execfd = -1;
 /* The amount of space already allocated from the temporary file.  */
 static size_t execsize = 0;
 
+/* The size of the temporary file.  The file is only ever grown, since
+   memfd backings are sealed against shrinking; space past execsize is
+   simply reused by the next mapping.  */
+static size_t execfilesize = 0;
+
+/* A range of the temporary file.  Live mappings are recorded so that
+   dlmunmap can tell which part of the file it releases; the released
+   parts below execsize are kept, sorted by offset, for reuse.  Both
+   lists are protected by the dlmalloc lock, which is held around every
+   call to dlmmap and dlmunmap.  */
+struct exec_extent
+{
+  char *start;			/* The writable address, if mapped.  */
+  size_t length;
+  off_t offset;
+  struct exec_extent *next;
+};
+
+static struct exec_extent *exec_mappings = NULL;
+static struct exec_extent *exec_free_extents = NULL;
+
+#ifdef HAVE_MEMFD_CREATE
+/* Create an anonymous file with memfd_create.  It needs no writable
+   directory and is never linked into a filesystem, so it is tried
+   before searching for one.  */
+static int
+open_temp_exec_file_memfd (const char *name)
+{
+  int fd;
+
+#ifdef MFD_EXEC
+  /* Kernels that make memfds non-executable by default need to be
+     told otherwise; older ones reject the flag.  */
+  fd = memfd_create (name, MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_EXEC);
+  if (fd == -1 && errno == EINVAL)
+#endif
+    fd = memfd_create (name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+  if (fd == -1)
+    return -1;
+
+#ifdef F_SEAL_SHRINK
+  /* The file only ever grows; make sure nobody can truncate it under
+     the mappings.  */
+  fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+#endif
+
+  return fd;
+}
+#endif /* HAVE_MEMFD_CREATE */
+
 /* Open a temporary file name, and immediately unlink it.  */
 static int
 open_temp_exec_file_name (char *name, int flags)
@@ -619,6 +672,9 @@ static struct
   const char *arg;
   int repeat;
 } open_temp_exec_file_opts[] = {
+#ifdef HAVE_MEMFD_CREATE
+  { open_temp_exec_file_memfd, "libffi", 0 },
+#endif
   { open_temp_exec_file_env, "TMPDIR", 0 },
   { open_temp_exec_file_dir, "/tmp", 0 },
   { open_temp_exec_file_dir, "/var/tmp", 0 },
@@ -678,6 +734,143 @@ open_temp_exec_file (void)
   return fd;
 }
 
+/* Take LENGTH bytes from the free parts of the temporary file, and
+   return their offset, or -1 if no free part is large enough.  */
+static off_t
+exec_extent_alloc (size_t length)
+{
+  struct exec_extent **pe, *e;
+  off_t offset;
+
+  for (pe = &exec_free_extents; (e = *pe) != NULL; pe = &e->next)
+    if (e->length >= length)
+      {
+	offset = e->offset;
+	e->offset += length;
+	e->length -= length;
+	if (e->length == 0)
+	  {
+	    *pe = e->next;
+	    free (e);
+	  }
+	return offset;
+      }
+
+  return -1;
+}
+
+/* Return LENGTH bytes at OFFSET in the temporary file to the system,
+   and keep the range for reuse.  */
+static void
+exec_extent_free (off_t offset, size_t length)
+{
+  struct exec_extent **pe, *e, *prev = NULL, *next = exec_free_extents;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+  fallocate (execfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+	     offset, length);
+#endif
+
+  while (next && next->offset < offset)
+    {
+      prev = next;
+      next = next->next;
+    }
+
+  if (prev && prev->offset + prev->length == (size_t) offset)
+    {
+      prev->length += length;
+      e = prev;
+    }
+  else
+    {
+      /* If this fails, the range is never reused, but its memory has
+	 been released all the same.  */
+      e = malloc (sizeof (struct exec_extent));
+      if (!e)
+	return;
+      e->start = NULL;
+      e->offset = offset;
+      e->length = length;
+      e->next = next;
+      if (prev)
+	prev->next = e;
+      else
+	exec_free_extents = e;
+    }
+
+  if (next && e->offset + e->length == (size_t) next->offset)
+    {
+      e->length += next->length;
+      e->next = next->next;
+      free (next);
+    }
+
+  /* Free space at the end of the file lowers execsize again.  The file
+     keeps its size, see execfilesize.  */
+  for (pe = &exec_free_extents; (e = *pe) != NULL; pe = &e->next)
+    if (e->next == NULL && e->offset + e->length == execsize)
+      {
+	execsize = e->offset;
+	*pe = NULL;
+	free (e);
+	break;
+      }
+}
+
+/* Forget the mappings of the temporary file between START and
+   START + LENGTH, and free the corresponding parts of the file.  */
+static void
+exec_mappings_release (char *start, size_t length)
+{
+  struct exec_extent **pm = &exec_mappings, *m, *r;
+  char *end = start + length;
+
+  while ((m = *pm) != NULL)
+    {
+      char *mend = m->start + m->length;
+      char *lo = m->start > start ? m->start : start;
+      char *hi = mend < end ? mend : end;
+
+      if (lo >= hi)
+	{
+	  pm = &m->next;
+	  continue;
+	}
+
+      exec_extent_free (m->offset + (lo - m->start), hi - lo);
+
+      if (lo == m->start && hi == mend)
+	{
+	  *pm = m->next;
+	  free (m);
+	  continue;
+	}
+
+      if (lo == m->start)
+	{
+	  m->offset += hi - m->start;
+	  m->length = mend - hi;
+	  m->start = hi;
+	}
+      else
+	{
+	  /* Without memory to split the record, the upper part is simply
+	     never reclaimed.  */
+	  if (hi != mend && (r = malloc (sizeof (struct exec_extent))))
+	    {
+	      r->start = hi;
+	      r->offset = m->offset + (hi - m->start);
+	      r->length = mend - hi;
+	      r->next = m->next;
+	      m->next = r;
+	    }
+	  m->length = lo - m->start;
+	}
+      pm = &m->next;
+    }
+}
+
 /* Map in a chunk of memory from the temporary exec file into separate
    locations in the virtual memory address space, one writable and one
    executable.  Returns the address of the writable portion, after
@@ -686,7 +879,9 @@ open_temp_exec_file (void)
 static void *
 dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
 {
+  struct exec_extent *m;
   void *ptr;
+  int fresh;
 
   if (execfd == -1)
     {
@@ -697,10 +892,20 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
 	return MFAIL;
     }
 
-  offset = execsize;
-
-  if (ftruncate (execfd, offset + length))
-    return MFAIL;
+  /* Reuse a released part of the file if there is one, otherwise grow
+     the file.  */
+  fresh = execsize == 0;
+  offset = exec_extent_alloc (length);
+  if (offset == -1)
+    {
+      offset = execsize;
+      if (offset + length > execfilesize)
+	{
+	  if (ftruncate (execfd, offset + length))
+	    return MFAIL;
+	  execfilesize = offset + length;
+	}
+    }
 
   flags &= ~(MAP_PRIVATE | MAP_ANONYMOUS);
   flags |= MAP_SHARED;
@@ -709,15 +914,17 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
 	      flags, execfd, offset);
   if (ptr == MFAIL)
     {
-      if (!offset)
+      if (fresh)
 	{
 	  close (execfd);
+	  execfilesize = 0;
 	  goto retry_open;
 	}
-      ftruncate (execfd, offset);
+      if ((size_t) offset < execsize)
+	exec_extent_free (offset, length);
       return MFAIL;
     }
-  else if (!offset
+  else if (fresh
 	   && open_temp_exec_file_opts[open_temp_exec_file_opts_idx].repeat)
     open_temp_exec_file_opts_next ();
 
@@ -726,13 +933,26 @@ dlmmap_locked (void *start, size_t length, int prot, int flags, off_t offset)
   if (start == MFAIL)
     {
       munmap (ptr, length);
-      ftruncate (execfd, offset);
+      if ((size_t) offset < execsize)
+	exec_extent_free (offset, length);
       return start;
     }
 
   mmap_exec_offset ((char *)start, length) = (char*)ptr - (char*)start;
 
-  execsize += length;
+  if ((size_t) offset == execsize)
+    execsize += length;
+
+  /* If this fails, the mapping is simply never reclaimed.  */
+  m = malloc (sizeof (struct exec_extent));
+  if (m)
+    {
+      m->start = start;
+      m->length = length;
+      m->offset = offset;
+      m->next = exec_mappings;
+      exec_mappings = m;
+    }
 
   return start;
 }
@@ -760,6 +980,11 @@ dlmmap (void *start, size_t length, int prot,
     {
       ptr = mmap (start, length, prot | PROT_EXEC, flags, fd, offset);
 
+      if (ptr != MFAIL)
+	{
+	  FFI_STATS_ADD (FFI_STATS_EXEC_MAPPED, length);
+	  ffi_code_map_add (ptr, length, "ffi_closure_code");
+	}
       if (ptr != MFAIL || (errno != EPERM && errno != EACCES))
 	/* Cool, no need to mess with separate segments.  */
 	return ptr;
@@ -774,11 +999,17 @@ dlmmap (void *start, size_t length, int prot,
       pthread_mutex_lock (&open_temp_exec_file_mutex);
       ptr = dlmmap_locked (start, length, prot, flags, offset);
       pthread_mutex_unlock (&open_temp_exec_file_mutex);
-
-      return ptr;
     }
+  else
+    ptr = dlmmap_locked (start, length, prot, flags, offset);
 
-  return dlmmap_locked (start, length, prot, flags, offset);
+  if (ptr != MFAIL)
+    {
+      FFI_STATS_ADD (FFI_STATS_EXEC_MAPPED, length);
+      ffi_code_map_add ((char *) ptr + mmap_exec_offset ((char *) ptr, length),
+			length, "ffi_closure_code");
+    }
+  return ptr;
 }
 
 /* Release memory at the given address, as well as the corresponding
@@ -786,23 +1017,31 @@ dlmmap (void *start, size_t length, int prot,
 static int
 dlmunmap (void *start, size_t length)
 {
-  /* We don't bother decreasing execsize or truncating the file, since
-     we can't quite tell whether we're unmapping the end of the file.
-     We don't expect frequent deallocation anyway.  If we did, we
-     could locate pages in the file by writing to the pages being
-     deallocated and checking that the file contents change.
-     Yuck.  */
   msegmentptr seg = segment_holding (gm, start);
-  void *code;
+  void *code = seg ? add_segment_exec_offset (start, seg) : start;
+  int ret;
+
+  ffi_code_map_remove (code, length);
 
-  if (seg && (code = add_segment_exec_offset (start, seg)) != start)
+  if (code != start)
     {
-      int ret = munmap (code, length);
+      ret = munmap (code, length);
       if (ret)
 	return ret;
     }
 
-  return munmap (start, length);
+  ret = munmap (start, length);
+#ifdef FFI_STATS
+  if (ret == 0 && !(execfd == -1 && is_emutramp_enabled ()))
+    FFI_STATS_ADD (FFI_STATS_EXEC_UNMAPPED, length);
+#endif
+
+  /* Hand the pages of the temporary file back to the system, and let
+     later mappings reuse that part of the file.  */
+  if (ret == 0 && execfd != -1)
+    exec_mappings_release (start, length);
+
+  return ret;
 }
 
 #if FFI_CLOSURE_FREE_CODE
@@ -823,6 +1062,473 @@ segment_holding_code (mstate m, char* addr)
 
 #endif /* !(defined(X86_WIN32) || defined(X86_WIN64) || defined(__OS2__)) || defined (__CYGWIN__) || defined(__INTERIX) */
 
+#if FFI_EXEC_STATIC_TRAMP
+
+/* Static trampolines.  Instead of writing a trampoline into memory
+   that is both writable and executable, each closure is given a slot
+   in a copy of ffi_tramp_code_page, a page of identical trampolines in
+   libffi's own text.  The copy is mapped from the file holding libffi,
+   right in front of an anonymous data page, and each trampoline loads
+   the closure and the entry point from the pair at its own offset in
+   the data page.  Nothing is ever written to executable memory, so no
+   temporary file, double mapping or cache flush is needed.
+
+   Tables are carved out of one reserved region, so that code addresses
+   can be recognized with a single comparison, and are never unmapped.
+   Free trampolines are chained through the closure word of their data
+   pair.  */
+
+#define FFI_TRAMP_PAGE_SIZE 4096
+#define FFI_TRAMP_SIZE 16
+#define FFI_TRAMP_COUNT (FFI_TRAMP_PAGE_SIZE / FFI_TRAMP_SIZE)
+
+/* Address space reserved for tables; room for two million closures.
+   Once it is used up, closures come from dlmalloc again.  */
+#define FFI_TRAMP_REGION_SIZE ((size_t) 64 << 20)
+
+struct ffi_tramp_parms
+{
+  void *closure;
+  void *entry;
+};
+
+#define FFI_TRAMP_PARMS(code) \
+  ((struct ffi_tramp_parms *) ((char *) (code) + FFI_TRAMP_PAGE_SIZE))
+
+extern char ffi_tramp_code_page[] FFI_HIDDEN;
+
+/* A mutex used to synchronize access to the ffi_tramp variables.  */
+static pthread_mutex_t ffi_tramp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Positive once the region is set up, negative if static trampolines
+   cannot be used.  */
+static int ffi_tramp_state = 0;
+
+/* The file holding ffi_tramp_code_page, and the page's offset in it.  */
+static int ffi_tramp_fd = -1;
+static off_t ffi_tramp_offset;
+
+/* The reserved region, and the amount of it holding tables.  */
+static char *ffi_tramp_region = NULL;
+static size_t ffi_tramp_used = 0;
+
+/* The first free trampoline.  */
+static char *ffi_tramp_free_list = NULL;
+
+/* Open the file mapped at ffi_tramp_code_page, as listed in
+   /proc/self/maps, and set ffi_tramp_offset.  */
+static int
+ffi_tramp_open_text (void)
+{
+  unsigned long page = (unsigned long) ffi_tramp_code_page;
+  char line[MAXPATHLEN + 128];
+  FILE *maps;
+  int fd = -1;
+
+  maps = fopen ("/proc/self/maps", "re");
+  if (!maps)
+    return -1;
+
+  while (fgets (line, sizeof (line), maps))
+    {
+      unsigned long start, end, offset;
+      char *path;
+      int n = 0;
+
+      if (sscanf (line, "%lx-%lx %*s %lx %*s %*s %n",
+		  &start, &end, &offset, &n) < 3
+	  || page < start || page >= end)
+	continue;
+
+      path = line + n;
+      path[strcspn (path, "\n")] = '\0';
+      if (path[0] == '/')
+	{
+	  fd = open (path, O_RDONLY | O_CLOEXEC);
+	  ffi_tramp_offset = offset + (page - start);
+	}
+      break;
+    }
+
+  fclose (maps);
+  return fd;
+}
+
+/* Find the trampoline page and reserve the region.  */
+static int
+ffi_tramp_init (void)
+{
+  void *region;
+
+  if (sysconf (_SC_PAGESIZE) != FFI_TRAMP_PAGE_SIZE)
+    return -1;
+
+  ffi_tramp_fd = ffi_tramp_open_text ();
+  if (ffi_tramp_fd == -1)
+    return -1;
+
+  region = mmap (NULL, FFI_TRAMP_REGION_SIZE, PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED)
+    {
+      close (ffi_tramp_fd);
+      ffi_tramp_fd = -1;
+      return -1;
+    }
+
+  ffi_tramp_region = region;
+  return 1;
+}
+
+/* Map in a new table and add its trampolines to the free list.  */
+static int
+ffi_tramp_table_alloc (void)
+{
+  char *code, *data;
+  int i;
+
+  if (ffi_tramp_used + 2 * FFI_TRAMP_PAGE_SIZE > FFI_TRAMP_REGION_SIZE)
+    return 0;
+
+  code = ffi_tramp_region + ffi_tramp_used;
+  data = code + FFI_TRAMP_PAGE_SIZE;
+
+  if (mmap (data, FFI_TRAMP_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED
+      || mmap (code, FFI_TRAMP_PAGE_SIZE, PROT_READ | PROT_EXEC,
+	       MAP_PRIVATE | MAP_FIXED, ffi_tramp_fd,
+	       ffi_tramp_offset) == MAP_FAILED)
+    return 0;
+  FFI_STATS_ADD (FFI_STATS_EXEC_MAPPED, FFI_TRAMP_PAGE_SIZE);
+
+  /* The file may have been replaced since it was loaded.  */
+  if (memcmp (code, ffi_tramp_code_page, FFI_TRAMP_PAGE_SIZE) != 0)
+    {
+      ffi_tramp_state = -1;
+      return 0;
+    }
+  ffi_code_map_add (code, FFI_TRAMP_PAGE_SIZE, "ffi_closure_trampolines");
+
+  for (i = 0; i < FFI_TRAMP_COUNT; i++)
+    FFI_TRAMP_PARMS (code + i * FFI_TRAMP_SIZE)->closure
+      = (i + 1 < FFI_TRAMP_COUNT
+	 ? code + (i + 1) * FFI_TRAMP_SIZE : ffi_tramp_free_list);
+
+  ffi_tramp_free_list = code;
+  ffi_tramp_used += 2 * FFI_TRAMP_PAGE_SIZE;
+  return 1;
+}
+
+/* Take up to N free trampolines into CODES, and return how many were
+   available.  */
+static size_t
+ffi_tramp_alloc (void **codes, size_t n)
+{
+  size_t i = 0;
+
+  pthread_mutex_lock (&ffi_tramp_mutex);
+
+  if (ffi_tramp_state == 0)
+    ffi_tramp_state = ffi_tramp_init ();
+
+  if (ffi_tramp_state > 0)
+    while (i < n
+	   && (ffi_tramp_free_list != NULL || ffi_tramp_table_alloc ()))
+      {
+	codes[i++] = ffi_tramp_free_list;
+	ffi_tramp_free_list = FFI_TRAMP_PARMS (ffi_tramp_free_list)->closure;
+      }
+
+  pthread_mutex_unlock (&ffi_tramp_mutex);
+
+  return i;
+}
+
+static void
+ffi_tramp_free (void **codes, size_t n)
+{
+  size_t i;
+
+  pthread_mutex_lock (&ffi_tramp_mutex);
+  for (i = 0; i < n; i++)
+    {
+      FFI_TRAMP_PARMS (codes[i])->closure = ffi_tramp_free_list;
+      ffi_tramp_free_list = codes[i];
+    }
+  pthread_mutex_unlock (&ffi_tramp_mutex);
+}
+
+/* Return nonzero if PTR is the writable address of a closure that was
+   given a static trampoline.  Such closures remember the trampoline
+   and their size in the first two words of their own, unused,
+   trampoline; the trampoline's data pair points back at them.  */
+static int
+ffi_tramp_closure_p (void *ptr, void **code)
+{
+  char *c;
+
+  memcpy (&c, ((ffi_closure *) ptr)->tramp, sizeof (void *));
+  if ((size_t) (c - ffi_tramp_region) >= ffi_tramp_used
+      || FFI_TRAMP_PARMS (c)->closure != ptr)
+    return 0;
+
+  *code = c;
+  return 1;
+}
+
+/* Return nonzero if CODE is a static trampoline.  Ports call this from
+   ffi_prep_closure_loc, and use ffi_tramp_set_parms instead of writing
+   a trampoline when it is.  */
+int FFI_HIDDEN
+ffi_tramp_is_present (void *code)
+{
+  return (ffi_tramp_region != NULL
+	  && (size_t) ((char *) code - ffi_tramp_region) < FFI_TRAMP_REGION_SIZE);
+}
+
+/* Make the trampoline CODE jump to ENTRY with CLOSURE.  */
+void FFI_HIDDEN
+ffi_tramp_set_parms (void *code, void *entry, void *closure)
+{
+  struct ffi_tramp_parms *parms = FFI_TRAMP_PARMS (code);
+
+  parms->closure = closure;
+  parms->entry = entry;
+}
+
+#endif /* FFI_EXEC_STATIC_TRAMP */
+
+/* How many calls to ffi_closure_free go by between attempts to release
+   unused segments.  */
+#define FFI_CLOSURE_RELEASE_RATE 4096
+
+static unsigned int ffi_closure_release_count;
+
+/* Closures allocated from dlmalloc keep their executable address in
+   the last word of their chunk, so that freeing them needs no segment
+   lookup.  */
+#define ffi_closure_code_word(ptr) \
+  (((void **) ((char *) (ptr) + dlmalloc_usable_size (ptr)))[-1])
+
+/* Allocate N chunks of SIZE bytes of executable memory from the
+   shared arena, storing their writable and executable addresses in
+   PTRS and CODES.  Return N, or 0 on failure.  */
+static size_t
+ffi_closure_alloc_exec (size_t n, size_t size, void **ptrs, void **codes)
+{
+  msegmentptr seg;
+  size_t i;
+
+  size += sizeof (void *);
+  if (n == 1)
+    {
+      ptrs[0] = dlmalloc (size);
+      if (!ptrs[0])
+	return 0;
+    }
+  else if (!dlindependent_calloc (n, size, ptrs))
+    return 0;
+
+  /* The chunks of a batch are carved from a single chunk, so they all
+     live in the same segment.  */
+  seg = segment_holding (gm, ptrs[0]);
+  for (i = 0; i < n; i++)
+    {
+      codes[i] = add_segment_exec_offset (ptrs[i], seg);
+      ffi_closure_code_word (ptrs[i]) = codes[i];
+    }
+
+  return n;
+}
+
+/* Allocate N closures of SIZE bytes from the shared arena, storing
+   their writable and executable addresses in PTRS and CODES.  Return
+   how many were allocated; the shared locks are taken once for the
+   whole batch.  */
+static size_t
+ffi_closure_alloc_shared (size_t n, size_t size, void **ptrs, void **codes)
+{
+#if FFI_EXEC_STATIC_TRAMP
+  size_t i, k = ffi_tramp_alloc (codes, n);
+
+  for (i = 0; i < k; i++)
+    {
+      ptrs[i] = malloc (size);
+      if (!ptrs[i])
+	{
+	  ffi_tramp_free (codes + i, k - i);
+	  return i;
+	}
+      memcpy (((ffi_closure *) ptrs[i])->tramp, &codes[i], sizeof (void *));
+      memcpy (((ffi_closure *) ptrs[i])->tramp + sizeof (void *), &size,
+	      sizeof (size_t));
+      ffi_tramp_set_parms (codes[i], NULL, ptrs[i]);
+    }
+  if (k > 0)
+    return k;
+#endif
+
+  return ffi_closure_alloc_exec (n, size, ptrs, codes);
+}
+
+/* Return N closures to the shared arena.  CODES is clobbered.  */
+static void
+ffi_closure_free_shared (size_t n, void **ptrs, void **codes)
+{
+  unsigned int before;
+  size_t i;
+#if FFI_EXEC_STATIC_TRAMP
+  size_t k = 0;
+#endif
+
+  for (i = 0; i < n; i++)
+    {
+#if FFI_EXEC_STATIC_TRAMP
+      if (ffi_tramp_is_present (codes[i]))
+	{
+	  free (ptrs[i]);
+	  codes[k++] = codes[i];
+	  continue;
+	}
+#endif
+      dlfree (ptrs[i]);
+    }
+
+#if FFI_EXEC_STATIC_TRAMP
+  if (k > 0)
+    ffi_tramp_free (codes, k);
+  if (k == n)
+    return;
+#endif
+
+  /* dlmalloc only gives segments back while trimming a top chunk past
+     the trim threshold, which page sized segments never reach.  Every
+     so often, release the segments that are entirely free.  The count
+     only runs up, and the free that carries it over a multiple of the
+     rate does the trimming; as the rate divides 2^32, wrapping around
+     keeps the spacing.  */
+  before = __atomic_fetch_add (&ffi_closure_release_count, (unsigned int) n,
+			       __ATOMIC_RELAXED);
+  if (before / FFI_CLOSURE_RELEASE_RATE
+      != (before + (unsigned int) n) / FFI_CLOSURE_RELEASE_RATE)
+    dlmalloc_trim (0);
+}
+
+#if !(defined(X86_WIN32) || defined(X86_WIN64) || defined(__OS2__)) || defined (__CYGWIN__) || defined(__INTERIX)
+
+/* Per-thread closure caches.  Closures small enough for the common
+   closure types are kept in a per-thread magazine of preallocated
+   (writable, executable) pairs, refilled from and flushed to the
+   shared arena in batches, so that most allocations and frees take no
+   lock at all.  */
+
+#define FFI_CLOSURE_CACHE 1
+
+/* The size of cached closures.  */
+#define FFI_CLOSURE_CACHE_SIZE ALIGN (sizeof (ffi_closure), 16)
+
+/* How many closures move between a magazine and the shared arena at
+   once, and the capacity of a magazine.  Two batches of 64 byte
+   chunks fit in one page sized dlmalloc segment.  */
+#define FFI_CLOSURE_CACHE_BATCH 30
+#define FFI_CLOSURE_CACHE_MAX (2 * FFI_CLOSURE_CACHE_BATCH)
+
+struct ffi_closure_cache
+{
+  size_t count;
+  void *ptrs[FFI_CLOSURE_CACHE_MAX];
+  void *codes[FFI_CLOSURE_CACHE_MAX];
+};
+
+static pthread_once_t ffi_closure_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ffi_closure_cache_key;
+static int ffi_closure_cache_ok;
+
+/* Flush the magazine of an exiting thread.  */
+static void
+ffi_closure_cache_destroy (void *arg)
+{
+  struct ffi_closure_cache *cache = arg;
+
+  if (cache->count)
+    ffi_closure_free_shared (cache->count, cache->ptrs, cache->codes);
+  free (cache);
+}
+
+static void
+ffi_closure_cache_init (void)
+{
+  __atomic_store_n (&ffi_closure_cache_ok,
+		    pthread_key_create (&ffi_closure_cache_key,
+					ffi_closure_cache_destroy) == 0,
+		    __ATOMIC_RELEASE);
+}
+
+#ifdef __GNUC__
+/* When libffi is unloaded, delete the key, so that threads exiting
+   afterwards do not run ffi_closure_cache_destroy from unmapped code.
+   This also runs from exit while other threads may still be using
+   their magazines, so those are left alone: later allocations bypass
+   them, and what they hold is only reclaimed with the process.  */
+static void __attribute__ ((destructor))
+ffi_closure_cache_fini (void)
+{
+  if (__atomic_exchange_n (&ffi_closure_cache_ok, 0, __ATOMIC_ACQ_REL))
+    pthread_key_delete (ffi_closure_cache_key);
+}
+#endif
+
+/* Return the magazine of the calling thread, creating it if need be,
+   or NULL if there is none.  */
+static struct ffi_closure_cache *
+ffi_closure_cache_get (void)
+{
+  struct ffi_closure_cache *cache;
+
+  pthread_once (&ffi_closure_cache_once, ffi_closure_cache_init);
+  if (!__atomic_load_n (&ffi_closure_cache_ok, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  cache = pthread_getspecific (ffi_closure_cache_key);
+  if (!cache)
+    {
+      cache = malloc (sizeof (struct ffi_closure_cache));
+      if (!cache)
+	return NULL;
+      cache->count = 0;
+      if (pthread_setspecific (ffi_closure_cache_key, cache))
+	{
+	  free (cache);
+	  return NULL;
+	}
+    }
+
+  return cache;
+}
+
+/* Return nonzero if the closure at PTR was allocated with
+   FFI_CLOSURE_CACHE_SIZE bytes.  */
+static int
+ffi_closure_cache_size_p (void *ptr, void *code)
+{
+  size_t size;
+
+#if FFI_EXEC_STATIC_TRAMP
+  if (ffi_tramp_is_present (code))
+    {
+      memcpy (&size, ((ffi_closure *) ptr)->tramp + sizeof (void *),
+	      sizeof (size_t));
+      return size == FFI_CLOSURE_CACHE_SIZE;
+    }
+#endif
+
+  size = dlmalloc_usable_size (ptr) - sizeof (void *);
+  return (size >= FFI_CLOSURE_CACHE_SIZE
+	  && size < FFI_CLOSURE_CACHE_SIZE + 2 * MALLOC_ALIGNMENT);
+}
+
+#endif /* per-thread caches */
+
 /* Allocate a chunk of memory with the given size.  Returns a pointer
    to the writable address, and sets *CODE to the executable
    corresponding virtual address.  */
@@ -830,22 +1536,72 @@ void *
 ffi_closure_alloc (size_t size, void **code)
 {
   void *ptr;
+#if FFI_CLOSURE_CACHE
+  struct ffi_closure_cache *cache;
+#endif
 
   if (!code)
     return NULL;
 
-  ptr = dlmalloc (size);
+#if FFI_CLOSURE_CACHE
+  /* Small closures always get the cached size, so that they can go to
+     a magazine when they are freed.  */
+  if (size <= FFI_CLOSURE_CACHE_SIZE)
+    size = FFI_CLOSURE_CACHE_SIZE;
 
-  if (ptr)
+  if (size == FFI_CLOSURE_CACHE_SIZE && (cache = ffi_closure_cache_get ()))
     {
-      msegmentptr seg = segment_holding (gm, ptr);
-
-      *code = add_segment_exec_offset (ptr, seg);
+      if (cache->count == 0)
+	cache->count = ffi_closure_alloc_shared (FFI_CLOSURE_CACHE_BATCH,
+						 FFI_CLOSURE_CACHE_SIZE,
+						 cache->ptrs, cache->codes);
+      if (cache->count == 0)
+	return NULL;
+
+      cache->count--;
+      *code = cache->codes[cache->count];
+      FFI_STATS_ADD (FFI_STATS_CLOSURE_ALLOCS, 1);
+      return cache->ptrs[cache->count];
     }
+#endif
 
+  if (ffi_closure_alloc_shared (1, size, &ptr, code) == 0)
+    return NULL;
+
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_ALLOCS, 1);
   return ptr;
 }
 
+/* Given PTR as accepted by ffi_closure_free, store the writable
+   address of the closure back in *PTR and return its executable
+   address.  */
+static void *
+ffi_closure_lookup (void **ptr)
+{
+  void *code;
+
+#if FFI_EXEC_STATIC_TRAMP
+  if (ffi_tramp_is_present (*ptr))
+    {
+      code = *ptr;
+      *ptr = FFI_TRAMP_PARMS (code)->closure;
+      return code;
+    }
+  if (ffi_tramp_region != NULL && ffi_tramp_closure_p (*ptr, &code))
+    return code;
+#endif
+
+#if FFI_CLOSURE_FREE_CODE
+  {
+    msegmentptr seg = segment_holding_code (gm, *ptr);
+
+    if (seg)
+      *ptr = sub_segment_exec_offset (*ptr, seg);
+  }
+#endif
+  return ffi_closure_code_word (*ptr);
+}
+
 /* Release a chunk of memory allocated with ffi_closure_alloc.  If
    FFI_CLOSURE_FREE_CODE is nonzero, the given address can be the
    writable or the executable address given.  Otherwise, only the
@@ -853,14 +1609,115 @@ ffi_closure_alloc (size_t size, void **code)
 void
 ffi_closure_free (void *ptr)
 {
-#if FFI_CLOSURE_FREE_CODE
-  msegmentptr seg = segment_holding_code (gm, ptr);
+  void *code;
+#if FFI_CLOSURE_CACHE
+  struct ffi_closure_cache *cache;
+#endif
+
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_FREES, 1);
+  code = ffi_closure_lookup (&ptr);
 
-  if (seg)
-    ptr = sub_segment_exec_offset (ptr, seg);
+#if FFI_CLOSURE_CACHE
+  if (ffi_closure_cache_size_p (ptr, code)
+      && (cache = ffi_closure_cache_get ()))
+    {
+      if (cache->count == FFI_CLOSURE_CACHE_MAX)
+	{
+	  cache->count -= FFI_CLOSURE_CACHE_BATCH;
+	  ffi_closure_free_shared (FFI_CLOSURE_CACHE_BATCH,
+				   cache->ptrs + cache->count,
+				   cache->codes + cache->count);
+	}
+      cache->ptrs[cache->count] = ptr;
+      cache->codes[cache->count] = code;
+      cache->count++;
+      return;
+    }
 #endif
 
-  dlfree (ptr);
+  ffi_closure_free_shared (1, &ptr, &code);
+}
+
+/* Allocate N chunks of memory with the given size at once, storing
+   their writable addresses in WRITABLE and their executable addresses
+   in CODE.  The chunks are carved from as few regions as possible and
+   bypass the per-thread caches.  Returns N, or 0 if they could not
+   all be allocated.  */
+size_t
+ffi_closure_alloc_many (size_t n, size_t size, void **writable, void **code)
+{
+  size_t done, k;
+
+  if (!writable || !code)
+    return 0;
+
+#if FFI_CLOSURE_CACHE
+  if (size <= FFI_CLOSURE_CACHE_SIZE)
+    size = FFI_CLOSURE_CACHE_SIZE;
+#endif
+
+  for (done = 0; done < n; done += k)
+    {
+      k = ffi_closure_alloc_shared (n - done, size,
+				    writable + done, code + done);
+      if (k == 0)
+	{
+	  ffi_closure_free_shared (done, writable, code);
+	  return 0;
+	}
+    }
+
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_ALLOCS, n);
+  return n;
+}
+
+/* Allocate SIZE bytes for code generated at run time.  Unlike
+   closures, this memory is executable even where closures use static
+   trampolines.  */
+void *
+ffi_closure_code_alloc (size_t size, void **code)
+{
+  void *ptr;
+
+  if (ffi_closure_alloc_exec (1, size, &ptr, code) == 0)
+    return NULL;
+
+  return ptr;
+}
+
+void
+ffi_closure_code_free (void *ptr)
+{
+  void *code = ffi_closure_code_word (ptr);
+
+  ffi_closure_free_shared (1, &ptr, &code);
+}
+
+/* How many closures ffi_closure_free_many looks up at once.  */
+#define FFI_CLOSURE_FREE_BATCH 64
+
+/* Release N chunks of memory allocated with ffi_closure_alloc or
+   ffi_closure_alloc_many.  The addresses in WRITABLE are accepted as
+   by ffi_closure_free.  */
+void
+ffi_closure_free_many (size_t n, void **writable)
+{
+  void *ptrs[FFI_CLOSURE_FREE_BATCH], *codes[FFI_CLOSURE_FREE_BATCH];
+  size_t i, k;
+
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_FREES, n);
+  while (n > 0)
+    {
+      k = n < FFI_CLOSURE_FREE_BATCH ? n : FFI_CLOSURE_FREE_BATCH;
+      for (i = 0; i < k; i++)
+	{
+	  ptrs[i] = writable[i];
+	  codes[i] = ffi_closure_lookup (&ptrs[i]);
+	}
+      ffi_closure_free_shared (k, ptrs, codes);
+      writable += k;
+      n -= k;
+    }
 }
 
 # else /* ! FFI_MMAP_EXEC_WRIT */
@@ -876,14 +1733,79 @@ ffi_closure_alloc (size_t size, void **code)
   if (!code)
     return NULL;
 
-  return *code = malloc (size);
+  if ((*code = malloc (size)))
+    FFI_STATS_ADD (FFI_STATS_CLOSURE_ALLOCS, 1);
+  return *code;
 }
 
 void
 ffi_closure_free (void *ptr)
+{
+  FFI_STATS_ADD (FFI_STATS_CLOSURE_FREES, 1);
+  free (ptr);
+}
+
+void *
+ffi_closure_code_alloc (size_t size, void **code)
+{
+  return *code = malloc (size);
+}
+
+void
+ffi_closure_code_free (void *ptr)
 {
   free (ptr);
 }
 
 # endif /* ! FFI_MMAP_EXEC_WRIT */
+
+#if FFI_EXEC_TRAMPOLINE_TABLE || !FFI_MMAP_EXEC_WRIT
+
+/* Without a shared arena, bulk allocation is one chunk at a time.  */
+
+size_t
+ffi_closure_alloc_many (size_t n, size_t size, void **writable, void **code)
+{
+  size_t i;
+
+  if (!writable || !code)
+    return 0;
+
+  for (i = 0; i < n; i++)
+    if (!(writable[i] = ffi_closure_alloc (size, &code[i])))
+      {
+	ffi_closure_free_many (i, writable);
+	return 0;
+      }
+
+  return n;
+}
+
+void
+ffi_closure_free_many (size_t n, void **writable)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    ffi_closure_free (writable[i]);
+}
+
+#endif
+
+#if FFI_EXEC_TRAMPOLINE_TABLE
+
+/* Code cannot be generated at run time here.  */
+
+void *
+ffi_closure_code_alloc (size_t size, void **code)
+{
+  return NULL;
+}
+
+void
+ffi_closure_code_free (void *ptr)
+{
+}
+
+#endif
 #endif /* FFI_CLOSURES */
@@ -0,0 +1,294 @@
+/* -----------------------------------------------------------------------
+   code_map.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file describes the executable memory that closures.c maps to
+   tools outside libffi.  Profilers that read /tmp/perf-PID.map, such
+   as perf, are given a name for each region when FFI_PERF_MAP is set
+   in the environment.  Unwinders that use the frames registered with
+   __register_frame are given one FDE per region.  Every trampoline and
+   generated stub only moves registers and jumps, so the same rule
+   holds anywhere in a region: the caller's frame is untouched, and
+   the return address is where the call left it.
+
+   dlmalloc may give back only part of a region, such as the tail of a
+   segment it trims, so removal works on address ranges: what is left
+   of a region keeps its FDE, re-registered to cover just that.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if FFI_CLOSURES && !FFI_EXEC_TRAMPOLINE_TABLE && defined (__linux__)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if defined (__GNUC__) && (defined (__x86_64__) \
+			   || (defined (__riscv) && __riscv_xlen == 64))
+# define FFI_CODE_MAP_UNWIND 1
+
+extern void __register_frame (void *) __attribute__ ((weak));
+extern void __deregister_frame (void *) __attribute__ ((weak));
+
+# ifdef __x86_64__
+/* The return address is at the top of the stack.  */
+#  define FFI_CODE_MAP_RA 16
+#  define FFI_CODE_MAP_SP 7
+#  define FFI_CODE_MAP_CFA_OFFSET 8
+# else
+/* The return address is still in ra.  */
+#  define FFI_CODE_MAP_RA 1
+#  define FFI_CODE_MAP_SP 2
+#  define FFI_CODE_MAP_CFA_OFFSET 0
+# endif
+
+/* A CIE and a single FDE covering one region, followed by the zero
+   word that ends an .eh_frame section.  */
+struct ffi_code_map_eh_frame
+{
+  unsigned int cie_length;
+  unsigned int cie_id;
+  unsigned char version;
+  unsigned char augmentation;
+  unsigned char code_align;
+  unsigned char data_align;
+  unsigned char ra;
+  unsigned char insns[11];	/* Padded with DW_CFA_nop.  */
+
+  unsigned int fde_length;
+  unsigned int cie_pointer;
+  void *pc_begin;
+  size_t pc_range;
+
+  unsigned int end;
+} __attribute__ ((packed));
+#endif
+
+struct ffi_code_map_region
+{
+  char *code;
+  size_t size;
+#ifdef FFI_CODE_MAP_UNWIND
+  struct ffi_code_map_eh_frame *eh_frame;
+#endif
+  struct ffi_code_map_region *next;
+};
+
+static pthread_mutex_t ffi_code_map_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ffi_code_map_region *ffi_code_map_regions;
+
+/* The perf map, -1 if not wanted, -2 until the environment is read.  */
+static int ffi_code_map_fd = -2;
+
+static void
+ffi_code_map_perf (void *code, size_t size, const char *name)
+{
+  char line[128];
+  int n;
+
+  if (ffi_code_map_fd == -2)
+    {
+      const char *env = getenv ("FFI_PERF_MAP");
+
+      ffi_code_map_fd = -1;
+      if (env != NULL && *env && strcmp (env, "0") != 0)
+	{
+	  snprintf (line, sizeof (line), "/tmp/perf-%d.map", (int) getpid ());
+	  ffi_code_map_fd = open (line, O_WRONLY | O_CREAT | O_APPEND
+				  | O_CLOEXEC, 0644);
+	}
+    }
+
+  if (ffi_code_map_fd < 0)
+    return;
+
+  n = snprintf (line, sizeof (line), "%lx %lx %s\n",
+		(unsigned long) (uintptr_t) code, (unsigned long) size, name);
+  if (write (ffi_code_map_fd, line, n) != n)
+    {
+      /* Give up on a perf map that cannot be written.  */
+      close (ffi_code_map_fd);
+      ffi_code_map_fd = -1;
+    }
+}
+
+#ifdef FFI_CODE_MAP_UNWIND
+static struct ffi_code_map_eh_frame *
+ffi_code_map_unwind (void *code, size_t size)
+{
+  struct ffi_code_map_eh_frame *f;
+
+  if (!__register_frame || !__deregister_frame)
+    return NULL;
+
+  f = calloc (1, sizeof (*f));
+  if (f == NULL)
+    return NULL;
+
+  f->cie_length = offsetof (struct ffi_code_map_eh_frame, fde_length)
+    - sizeof (f->cie_length);
+  f->cie_id = 0;
+  f->version = 1;
+  f->augmentation = 0;
+  f->code_align = 1;
+  f->data_align = 0x78;		/* -8 */
+  f->ra = FFI_CODE_MAP_RA;
+  f->insns[0] = 0x0c;		/* DW_CFA_def_cfa */
+  f->insns[1] = FFI_CODE_MAP_SP;
+  f->insns[2] = FFI_CODE_MAP_CFA_OFFSET;
+#ifdef __x86_64__
+  f->insns[3] = 0x80 | FFI_CODE_MAP_RA;	/* DW_CFA_offset ra, cfa-8 */
+  f->insns[4] = 1;
+#endif
+
+  f->fde_length = offsetof (struct ffi_code_map_eh_frame, end)
+    - offsetof (struct ffi_code_map_eh_frame, cie_pointer);
+  f->cie_pointer = offsetof (struct ffi_code_map_eh_frame, cie_pointer);
+  f->pc_begin = code;
+  f->pc_range = size;
+  f->end = 0;
+
+  __register_frame (f);
+  return f;
+}
+#endif
+
+/* Make R cover SIZE bytes from CODE.  */
+static void
+ffi_code_map_move (struct ffi_code_map_region *r, char *code, size_t size)
+{
+  r->code = code;
+  r->size = size;
+#ifdef FFI_CODE_MAP_UNWIND
+  if (r->eh_frame)
+    {
+      __deregister_frame (r->eh_frame);
+      r->eh_frame->pc_begin = code;
+      r->eh_frame->pc_range = size;
+      __register_frame (r->eh_frame);
+    }
+#endif
+}
+
+static void
+ffi_code_map_free (struct ffi_code_map_region *r)
+{
+#ifdef FFI_CODE_MAP_UNWIND
+  if (r->eh_frame)
+    {
+      __deregister_frame (r->eh_frame);
+      free (r->eh_frame);
+    }
+#endif
+  free (r);
+}
+
+void
+ffi_code_map_add (void *code, size_t size, const char *name)
+{
+  struct ffi_code_map_region *r;
+
+  pthread_mutex_lock (&ffi_code_map_lock);
+  ffi_code_map_perf (code, size, name);
+
+  /* If this fails, the region is simply not known to unwinders.  */
+  r = malloc (sizeof (*r));
+  if (r)
+    {
+      r->code = code;
+      r->size = size;
+#ifdef FFI_CODE_MAP_UNWIND
+      r->eh_frame = ffi_code_map_unwind (code, size);
+#endif
+      r->next = ffi_code_map_regions;
+      ffi_code_map_regions = r;
+    }
+  pthread_mutex_unlock (&ffi_code_map_lock);
+}
+
+void
+ffi_code_map_remove (void *code, size_t size)
+{
+  struct ffi_code_map_region *r, *tail, **pr;
+  char *start = code, *end = start + size;
+
+  pthread_mutex_lock (&ffi_code_map_lock);
+  pr = &ffi_code_map_regions;
+  while ((r = *pr) != NULL)
+    {
+      char *rend = r->code + r->size;
+
+      if (rend <= start || r->code >= end)
+	{
+	  pr = &r->next;
+	  continue;
+	}
+
+      /* Keep what lies past the range as a region of its own.  If
+	 that fails, unwinders lose sight of it.  */
+      if (rend > end && r->code < start
+	  && (tail = malloc (sizeof (*tail))) != NULL)
+	{
+	  tail->code = end;
+	  tail->size = rend - end;
+#ifdef FFI_CODE_MAP_UNWIND
+	  tail->eh_frame = ffi_code_map_unwind (end, rend - end);
+#endif
+	  tail->next = r->next;
+	  r->next = tail;
+	}
+
+      if (r->code < start)
+	ffi_code_map_move (r, r->code, start - r->code);
+      else if (rend > end)
+	ffi_code_map_move (r, end, rend - end);
+      else
+	{
+	  *pr = r->next;
+	  ffi_code_map_free (r);
+	  continue;
+	}
+      pr = &r->next;
+    }
+  pthread_mutex_unlock (&ffi_code_map_lock);
+}
+
+#else
+
+void
+ffi_code_map_add (void *code, size_t size, const char *name)
+{
+}
+
+void
+ffi_code_map_remove (void *code, size_t size)
+{
+}
+
+#endif
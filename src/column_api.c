@@ -0,0 +1,132 @@
+/* -----------------------------------------------------------------------
+   column_api.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines the generic columnar (struct-of-arrays) call
+   interface.  Ports that can load registers straight from the columns
+   provide ffi_call_columns_machdep and define
+   FFI_TARGET_HAS_COLUMN_CALL in ffitarget.h.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+/* Return non-zero if a value of type RTYPE is returned by ffi_call
+   widened to a full ffi_arg.  Such values are narrowed back to their
+   natural size before being stored into a result column, so that
+   adjacent rows are not clobbered.  */
+
+int FFI_HIDDEN
+ffi_column_rvalue_is_widened (ffi_type *rtype)
+{
+  switch (rtype->type)
+    {
+    case FFI_TYPE_INT:
+    case FFI_TYPE_UINT8:
+    case FFI_TYPE_SINT8:
+    case FFI_TYPE_UINT16:
+    case FFI_TYPE_SINT16:
+    case FFI_TYPE_UINT32:
+    case FFI_TYPE_SINT32:
+    case FFI_TYPE_POINTER:
+      return rtype->size < sizeof (ffi_arg);
+    default:
+      return 0;
+    }
+}
+
+/* Store the widened return value SRC into the result column slot DST.  */
+
+void FFI_HIDDEN
+ffi_column_store_rvalue (ffi_type *rtype, void *dst, const ffi_arg *src)
+{
+  switch (rtype->type)
+    {
+    case FFI_TYPE_UINT8:
+    case FFI_TYPE_SINT8:
+      *(UINT8 *) dst = (UINT8) *src;
+      break;
+    case FFI_TYPE_UINT16:
+    case FFI_TYPE_SINT16:
+      *(UINT16 *) dst = (UINT16) *src;
+      break;
+    case FFI_TYPE_POINTER:
+      *(void **) dst = (void *) (size_t) *src;
+      break;
+    default:
+      *(UINT32 *) dst = (UINT32) *src;
+      break;
+    }
+}
+
+void
+ffi_call_columns (ffi_cif *cif, void (*fn)(void), size_t nrows,
+		  void *rvalue, size_t rstride,
+		  void **columns, const size_t *strides)
+{
+  void **avalue;
+  char **cur;
+  char *rcur = rvalue;
+  ffi_arg tmp;
+  int widened;
+  unsigned i;
+
+  if (nrows == 0)
+    return;
+
+#ifdef FFI_TARGET_HAS_COLUMN_CALL
+  /* Observers want every row as an ffi_call.  */
+  if (!FFI_OBSERVING ()
+      && ffi_call_columns_machdep (cif, fn, nrows, rvalue, rstride,
+				   columns, strides) == FFI_OK)
+    return;
+#endif
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  cur = alloca (cif->nargs * sizeof (char *));
+  for (i = 0; i < cif->nargs; i++)
+    cur[i] = columns[i];
+
+  widened = rcur != NULL && ffi_column_rvalue_is_widened (cif->rtype);
+
+  while (nrows-- > 0)
+    {
+      /* Some ports rewrite avalue entries while marshalling, so the
+	 array is refreshed for every row.  */
+      for (i = 0; i < cif->nargs; i++)
+	{
+	  avalue[i] = cur[i];
+	  cur[i] += strides[i];
+	}
+
+      if (widened)
+	{
+	  ffi_call (cif, fn, &tmp, avalue);
+	  ffi_column_store_rvalue (cif->rtype, rcur, &tmp);
+	}
+      else
+	ffi_call (cif, fn, rcur, avalue);
+
+      if (rcur != NULL)
+	rcur += rstride;
+    }
+}
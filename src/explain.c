@@ -0,0 +1,260 @@
+/* -----------------------------------------------------------------------
+   explain.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file renders the decisions a port makes when it prepares a cif:
+   which registers or stack slots the return value and every argument
+   use, and which slow paths they take.  The placement itself comes
+   from ports that define FFI_TARGET_HAS_EXPLAIN and provide
+   ffi_explain_machdep; it follows the marshalling code of ffi_call,
+   not the ABI documents, where the two disagree.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *const ffi_type_names[] = {
+  "void", "int", "float", "double", "longdouble", "uint8", "sint8",
+  "uint16", "sint16", "uint32", "sint32", "uint64", "sint64", "struct",
+  "pointer", "complex"
+};
+
+/* Append S to the string at *POS in the SIZE bytes at BUF, cutting it
+   short if it does not fit.  */
+static void
+ffi_describe_append (char *buf, size_t size, size_t *pos, const char *s)
+{
+  size_t n = strlen (s);
+
+  if (*pos + n >= size)
+    n = *pos + 1 < size ? size - *pos - 1 : 0;
+  memcpy (buf + *pos, s, n);
+  *pos += n;
+  buf[*pos] = 0;
+}
+
+void
+ffi_describe_type (char *buf, size_t size, size_t *pos, ffi_type *t)
+{
+  ffi_type **e;
+
+  if (t->type == FFI_TYPE_STRUCT)
+    {
+      ffi_describe_append (buf, size, pos, "{");
+      for (e = t->elements; *e; e++)
+	{
+	  if (e != t->elements)
+	    ffi_describe_append (buf, size, pos, ", ");
+	  ffi_describe_type (buf, size, pos, *e);
+	}
+      ffi_describe_append (buf, size, pos, "}");
+    }
+  else if (t->type == FFI_TYPE_ARRAY)
+    {
+      char count[24];
+
+      ffi_describe_type (buf, size, pos, t->elements[0]);
+      snprintf (count, sizeof (count), "[%lu]",
+		(unsigned long) FFI_ARRAY_COUNT (t));
+      ffi_describe_append (buf, size, pos, count);
+    }
+  else if (t->type < sizeof (ffi_type_names) / sizeof (char *))
+    ffi_describe_append (buf, size, pos, ffi_type_names[t->type]);
+  else
+    ffi_describe_append (buf, size, pos, "?");
+}
+
+void
+ffi_describe_cif (char *buf, size_t size, ffi_cif *cif)
+{
+  size_t pos = 0;
+  unsigned i;
+
+  buf[0] = 0;
+  ffi_describe_type (buf, size, &pos, cif->rtype);
+  ffi_describe_append (buf, size, &pos, " (");
+  for (i = 0; i < cif->nargs; i++)
+    {
+      if (i)
+	ffi_describe_append (buf, size, &pos, ", ");
+      ffi_describe_type (buf, size, &pos, cif->arg_types[i]);
+    }
+  ffi_describe_append (buf, size, &pos, ")");
+}
+
+ffi_status
+ffi_explain (ffi_cif *cif, ffi_placement *rvalue, ffi_placement *args)
+{
+  if (cif == NULL || rvalue == NULL || (args == NULL && cif->nargs))
+    return FFI_BAD_TYPEDEF;
+
+  memset (rvalue, 0, sizeof (*rvalue));
+  if (cif->nargs)
+    memset (args, 0, cif->nargs * sizeof (*args));
+
+#ifdef FFI_TARGET_HAS_EXPLAIN
+  return ffi_explain_machdep (cif, rvalue, args);
+#else
+  return FFI_BAD_ABI;
+#endif
+}
+
+#ifdef FFI_TARGET_HAS_EXPLAIN
+
+/* Append the registers FIRST to FIRST + N - 1 to the string at *POS.  */
+static void
+ffi_explain_regs (char *buf, size_t size, size_t *pos, int fp, int ret,
+		  unsigned first, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; i++)
+    {
+      if (*pos)
+	ffi_describe_append (buf, size, pos, ",");
+      ffi_describe_append (buf, size, pos,
+			   ffi_explain_reg_machdep (fp, ret, first + i));
+    }
+}
+
+static void
+ffi_explain_line (void (*print) (const char *, void *), void *user_data,
+		  const char *what, ffi_type *type, const ffi_placement *p,
+		  int ret)
+{
+  static const char *const slow_paths[] = {
+    "by reference", "flattened", "fp in gpr", "variadic"
+  };
+  char desc[96], where[96], notes[64], line[320];
+  size_t pos = 0;
+  unsigned i;
+
+  ffi_describe_type (desc, sizeof (desc), &pos, type);
+
+  pos = 0;
+  where[0] = 0;
+  switch (p->kind)
+    {
+    case FFI_PLACE_NONE:
+      ffi_describe_append (where, sizeof (where), &pos,
+			   ret ? "-" : "not passed");
+      break;
+    case FFI_PLACE_MEMORY:
+      ffi_describe_append (where, sizeof (where), &pos, "memory at ");
+      ffi_describe_append (where, sizeof (where), &pos,
+			   ffi_explain_reg_machdep (0, 0, p->gpr));
+      break;
+    case FFI_PLACE_X87:
+      ffi_describe_append (where, sizeof (where), &pos, "st(0)");
+      break;
+    default:
+      /* Floating point registers first, as the ports fill them in.  */
+      ffi_explain_regs (where, sizeof (where), &pos, 1, ret, p->fpr,
+			p->nfpr);
+      ffi_explain_regs (where, sizeof (where), &pos, 0, ret, p->gpr,
+			p->ngpr);
+      if (p->stack_size)
+	{
+	  char slot[48];
+
+	  snprintf (slot, sizeof (slot), "%sstack+%lu:%lu", pos ? "," : "",
+		    (unsigned long) p->stack, (unsigned long) p->stack_size);
+	  ffi_describe_append (where, sizeof (where), &pos, slot);
+	}
+      break;
+    }
+
+  pos = 0;
+  notes[0] = 0;
+  for (i = 0; i < sizeof (slow_paths) / sizeof (char *); i++)
+    if (p->flags & (1u << i))
+      {
+	if (pos)
+	  ffi_describe_append (notes, sizeof (notes), &pos, ", ");
+	ffi_describe_append (notes, sizeof (notes), &pos, slow_paths[i]);
+      }
+
+  snprintf (line, sizeof (line), "%s\t%s\t%s\t%s\n", what, desc, where,
+	    pos ? notes : "-");
+  print (line, user_data);
+}
+
+static void
+ffi_explain_print_stderr (const char *line, void *user_data)
+{
+  fputs (line, stderr);
+}
+
+ffi_status
+ffi_explain_print (ffi_cif *cif,
+		   void (*print) (const char *line, void *user_data),
+		   void *user_data)
+{
+  ffi_placement rvalue, *args;
+  ffi_status status;
+  char line[160], what[16];
+  size_t stack = 0;
+  unsigned i;
+
+  args = alloca (cif->nargs * sizeof (ffi_placement));
+  status = ffi_explain (cif, &rvalue, args);
+  if (status != FFI_OK)
+    return status;
+  if (print == NULL)
+    print = ffi_explain_print_stderr;
+
+  ffi_describe_cif (line + 2, sizeof (line) - 3, cif);
+  line[0] = '#';
+  line[1] = ' ';
+  strcat (line, "\n");
+  print (line, user_data);
+  print ("# value\ttype\tlocation\tslow paths\n", user_data);
+
+  ffi_explain_line (print, user_data, "return", cif->rtype, &rvalue, 1);
+  for (i = 0; i < cif->nargs; i++)
+    {
+      snprintf (what, sizeof (what), "arg %u", i);
+      ffi_explain_line (print, user_data, what, cif->arg_types[i],
+			&args[i], 0);
+      if (args[i].stack_size && args[i].stack + args[i].stack_size > stack)
+	stack = args[i].stack + args[i].stack_size;
+    }
+
+  snprintf (line, sizeof (line), "stack\t%lu bytes\n", (unsigned long) stack);
+  print (line, user_data);
+  return FFI_OK;
+}
+
+#else /* !FFI_TARGET_HAS_EXPLAIN */
+
+ffi_status
+ffi_explain_print (ffi_cif *cif,
+		   void (*print) (const char *line, void *user_data),
+		   void *user_data)
+{
+  return FFI_BAD_ABI;
+}
+
+#endif /* FFI_TARGET_HAS_EXPLAIN */
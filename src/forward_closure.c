@@ -0,0 +1,128 @@
+/* -----------------------------------------------------------------------
+   forward_closure.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines forwarding closures, which prepend bound values to
+   the arguments they receive and call a native function with the
+   result.  Ports that define FFI_TARGET_HAS_FORWARD_CLOSURE write a
+   stub that rearranges the argument registers and jumps straight to
+   the target when the signature allows it; otherwise the closure
+   handler decodes the arguments and goes through ffi_call.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+
+#if FFI_CLOSURES
+
+static void
+ffi_forward_closure_generic (ffi_cif *cif, void *rvalue, void **args,
+			     void *user_data)
+{
+  ffi_forward_closure *fwd = user_data;
+  void **avalue;
+
+  avalue = alloca (fwd->target->nargs * sizeof (void *));
+  memcpy (avalue, fwd->bound, fwd->nbound * sizeof (void *));
+  memcpy (avalue + fwd->nbound, args, cif->nargs * sizeof (void *));
+
+  ffi_call (fwd->target, fwd->fn, rvalue, avalue);
+}
+
+ffi_forward_closure *
+ffi_forward_closure_alloc (ffi_cif *cif, void (*fn)(void),
+			   unsigned int nbound, void **bound, void **code)
+{
+  ffi_forward_closure *fwd;
+  size_t bytes;
+  char *values;
+  unsigned i;
+
+  if (code == NULL || nbound > cif->nargs)
+    return NULL;
+
+  /* One block holds the closure, the bound vector and the values.  */
+  bytes = ALIGN (sizeof (ffi_forward_closure) + nbound * sizeof (void *), 16);
+  for (i = 0; i < nbound; i++)
+    bytes = ALIGN (bytes, cif->arg_types[i]->alignment)
+	    + cif->arg_types[i]->size;
+
+  fwd = calloc (1, bytes);
+  if (fwd == NULL)
+    return NULL;
+  fwd->target = cif;
+  fwd->fn = fn;
+  fwd->nbound = nbound;
+  fwd->bound = (void **) (fwd + 1);
+
+  values = (char *) fwd;
+  bytes = ALIGN (sizeof (ffi_forward_closure) + nbound * sizeof (void *), 16);
+  for (i = 0; i < nbound; i++)
+    {
+      bytes = ALIGN (bytes, cif->arg_types[i]->alignment);
+      fwd->bound[i] = values + bytes;
+      memcpy (fwd->bound[i], bound[i], cif->arg_types[i]->size);
+      bytes += cif->arg_types[i]->size;
+    }
+
+  if (ffi_prep_cif (&fwd->cif, cif->abi, cif->nargs - nbound, cif->rtype,
+		    cif->arg_types + nbound) != FFI_OK)
+    goto fail;
+
+#ifdef FFI_TARGET_HAS_FORWARD_CLOSURE
+  if (ffi_prep_forward_closure_machdep (fwd, code) == FFI_OK)
+    return fwd;
+#endif
+
+  fwd->closure = ffi_closure_alloc (sizeof (ffi_closure), code);
+  if (fwd->closure == NULL)
+    goto fail;
+  if (ffi_prep_closure_loc (fwd->closure, &fwd->cif,
+			    ffi_forward_closure_generic, fwd, *code) != FFI_OK)
+    {
+      ffi_closure_free (fwd->closure);
+      goto fail;
+    }
+
+  return fwd;
+
+ fail:
+  free (fwd);
+  return NULL;
+}
+
+void
+ffi_forward_closure_free (ffi_forward_closure *fwd)
+{
+  if (fwd == NULL)
+    return;
+
+  if (fwd->stub != NULL)
+    ffi_closure_code_free (fwd->stub);
+  if (fwd->closure != NULL)
+    ffi_closure_free (fwd->closure);
+  free (fwd);
+}
+
+#endif /* FFI_CLOSURES */
@@ -0,0 +1,150 @@
+/* -----------------------------------------------------------------------
+   frame_api.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines reusable argument frames.  Ports that can keep the
+   marshalled argument area between calls define FFI_TARGET_HAS_FRAMES
+   in ffitarget.h and provide the ffi_*_frame_machdep routines; the
+   generic frames below keep a copy of every argument value and go
+   through ffi_call.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+
+ffi_frame *
+ffi_frame_alloc (ffi_cif *cif, void **avalue)
+{
+  ffi_frame *frame;
+  size_t bytes;
+  char *values;
+  unsigned i;
+
+  frame = calloc (1, sizeof (ffi_frame));
+  if (frame == NULL)
+    return NULL;
+  frame->cif = cif;
+
+#ifdef FFI_TARGET_HAS_FRAMES
+  if (ffi_prep_frame_machdep (frame, avalue) == FFI_OK)
+    return frame;
+#endif
+
+  /* One block holds the avalue vector followed by the values.  */
+  bytes = ALIGN (cif->nargs * sizeof (void *), 16);
+  for (i = 0; i < cif->nargs; i++)
+    bytes = ALIGN (bytes, cif->arg_types[i]->alignment)
+	    + cif->arg_types[i]->size;
+
+  frame->avalue = calloc (1, bytes + 1);
+  if (frame->avalue == NULL)
+    {
+      free (frame);
+      return NULL;
+    }
+
+  values = (char *) frame->avalue;
+  bytes = ALIGN (cif->nargs * sizeof (void *), 16);
+  for (i = 0; i < cif->nargs; i++)
+    {
+      bytes = ALIGN (bytes, cif->arg_types[i]->alignment);
+      frame->avalue[i] = values + bytes;
+      if (avalue != NULL)
+	memcpy (frame->avalue[i], avalue[i], cif->arg_types[i]->size);
+      bytes += cif->arg_types[i]->size;
+    }
+
+  return frame;
+}
+
+void
+ffi_frame_set_arg (ffi_frame *frame, unsigned int n, void *value)
+{
+  if (frame->avalue == NULL)
+    {
+#ifdef FFI_TARGET_HAS_FRAMES
+      ffi_frame_set_arg_machdep (frame, n, value);
+#endif
+      return;
+    }
+
+  memcpy (frame->avalue[n], value, frame->cif->arg_types[n]->size);
+}
+
+void
+ffi_frame_call (ffi_frame *frame, void (*fn)(void), void *rvalue)
+{
+  ffi_cif *cif = frame->cif;
+  void **avalue;
+
+  if (frame->avalue == NULL)
+    {
+#ifdef FFI_TARGET_HAS_FRAMES
+      char *values;
+      size_t bytes = 0;
+      unsigned i;
+
+      if (!FFI_OBSERVING ())
+	{
+	  ffi_frame_call_machdep (frame, fn, rvalue);
+	  return;
+	}
+
+      /* Observers want the argument values, so they are read back out
+	 of the frame and the call goes through ffi_call.  */
+      for (i = 0; i < cif->nargs; i++)
+	bytes = ALIGN (bytes, cif->arg_types[i]->alignment)
+		+ cif->arg_types[i]->size;
+      values = alloca (bytes + 1);
+      avalue = alloca (cif->nargs * sizeof (void *));
+      bytes = 0;
+      for (i = 0; i < cif->nargs; i++)
+	{
+	  bytes = ALIGN (bytes, cif->arg_types[i]->alignment);
+	  avalue[i] = values + bytes;
+	  ffi_frame_get_arg_machdep (frame, i, avalue[i]);
+	  bytes += cif->arg_types[i]->size;
+	}
+      ffi_call (cif, fn, rvalue, avalue);
+#endif
+      return;
+    }
+
+  /* Some ports rewrite avalue entries while marshalling, so they are
+     handed a scratch copy of the vector.  */
+  avalue = alloca (cif->nargs * sizeof (void *));
+  memcpy (avalue, frame->avalue, cif->nargs * sizeof (void *));
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+void
+ffi_frame_free (ffi_frame *frame)
+{
+  if (frame == NULL)
+    return;
+  free (frame->avalue);
+  free (frame->image);
+  free (frame->plan);
+  free (frame);
+}
@@ -0,0 +1,130 @@
+/* -----------------------------------------------------------------------
+   interposer.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines interposers: closures that run a hook before and
+   after passing the call they receive on, unchanged, to a native
+   function.  Ports that define FFI_TARGET_HAS_INTERPOSER replay the
+   incoming argument registers and stack arguments into the target
+   through their call routine, and let the hooks look at the arguments
+   where they are; elsewhere the closure decodes the arguments and
+   goes through ffi_call.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+
+#if FFI_CLOSURES
+
+static void
+ffi_interposer_generic (ffi_cif *cif, void *rvalue, void **avalue,
+			void *user_data)
+{
+  ffi_interposer *ip = user_data;
+  ffi_interposer_call call;
+
+  call.interposer = ip;
+  call.avalue = avalue;
+  if (ip->pre != NULL)
+    ip->pre (&call, ip->user_data);
+
+  ffi_call (cif, ip->fn, rvalue, avalue);
+
+  if (ip->post != NULL)
+    ip->post (&call, rvalue, ip->user_data);
+}
+
+ffi_interposer *
+ffi_interposer_alloc (ffi_cif *cif, void (*fn)(void),
+		      void (*pre)(ffi_interposer_call *call, void *user_data),
+		      void (*post)(ffi_interposer_call *call, void *rvalue,
+				   void *user_data),
+		      void *user_data, void **code)
+{
+  ffi_interposer *ip;
+
+  if (code == NULL)
+    return NULL;
+
+  ip = calloc (1, sizeof (ffi_interposer));
+  if (ip == NULL)
+    return NULL;
+  ip->cif = cif;
+  ip->fn = fn;
+  ip->pre = pre;
+  ip->post = post;
+  ip->user_data = user_data;
+
+#ifdef FFI_TARGET_HAS_INTERPOSER
+  if (ffi_prep_interposer_machdep (ip, code) == FFI_OK)
+    return ip;
+  free (ip->plan);
+  ip->plan = NULL;
+  if (ip->closure != NULL)
+    {
+      ffi_closure_free (ip->closure);
+      ip->closure = NULL;
+    }
+#endif
+
+  ip->closure = ffi_closure_alloc (sizeof (ffi_closure), code);
+  if (ip->closure == NULL)
+    {
+      free (ip);
+      return NULL;
+    }
+  if (ffi_prep_closure_loc (ip->closure, cif, ffi_interposer_generic, ip,
+			    *code) != FFI_OK)
+    {
+      ffi_interposer_free (ip);
+      return NULL;
+    }
+
+  return ip;
+}
+
+const void *
+ffi_interposer_arg (ffi_interposer_call *call, unsigned int n)
+{
+#ifdef FFI_TARGET_HAS_INTERPOSER
+  if (call->avalue == NULL)
+    return ffi_interposer_arg_machdep (call, n);
+#endif
+
+  return call->avalue[n];
+}
+
+void
+ffi_interposer_free (ffi_interposer *ip)
+{
+  if (ip == NULL)
+    return;
+
+  if (ip->closure != NULL)
+    ffi_closure_free (ip->closure);
+  free (ip->plan);
+  free (ip);
+}
+
+#endif /* FFI_CLOSURES */
@@ -319,6 +319,79 @@ void ffi_java_raw_call (ffi_cif *cif, void (*fn)(void), void *rvalue,
   ffi_java_rvalue_to_raw (cif, rvalue);
 }
 
+/* Plans keep the offset of every argument in the raw array, as found
+ * by ffi_java_raw_to_ptrarray, so that repeated calls of the same cif
+ * skip the per-type translation.  Ports that define
+ * FFI_TARGET_HAS_JAVA_RAW_PLAN load the raw array straight into the
+ * argument registers instead of building a pointer array. */
+
+ffi_java_raw_plan *
+ffi_java_raw_plan_alloc (ffi_cif *cif)
+{
+  ffi_java_raw_plan *plan;
+  ffi_java_raw *raw;
+  void **avalue;
+  unsigned i;
+
+  plan = malloc (sizeof (ffi_java_raw_plan)
+		 + cif->nargs * sizeof (size_t));
+  if (plan == NULL)
+    return NULL;
+  plan->cif = cif;
+  plan->offsets = (size_t *) (plan + 1);
+  plan->machdep = NULL;
+
+  raw = alloca (ffi_java_raw_size (cif) + 1);
+  avalue = alloca (cif->nargs * sizeof (void *));
+  ffi_java_raw_to_ptrarray (cif, raw, avalue);
+  for (i = 0; i < cif->nargs; i++)
+    plan->offsets[i] = (char *) avalue[i] - (char *) raw;
+
+#ifdef FFI_TARGET_HAS_JAVA_RAW_PLAN
+  if (ffi_prep_java_raw_plan_machdep (plan) != FFI_OK)
+    {
+      free (plan->machdep);
+      plan->machdep = NULL;
+    }
+#endif
+
+  return plan;
+}
+
+void
+ffi_java_raw_plan_call (ffi_java_raw_plan *plan, void (*fn)(void),
+			void *rvalue, ffi_java_raw *raw)
+{
+  ffi_cif *cif = plan->cif;
+  void **avalue;
+  unsigned i;
+
+#ifdef FFI_TARGET_HAS_JAVA_RAW_PLAN
+  if (plan->machdep != NULL && !FFI_OBSERVING ())
+    {
+      ffi_java_raw_plan_call_machdep (plan, fn, rvalue, raw);
+      ffi_java_rvalue_to_raw (cif, rvalue);
+      return;
+    }
+#endif
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  for (i = 0; i < cif->nargs; i++)
+    avalue[i] = (char *) raw + plan->offsets[i];
+  ffi_call (cif, fn, rvalue, avalue);
+  ffi_java_rvalue_to_raw (cif, rvalue);
+}
+
+void
+ffi_java_raw_plan_free (ffi_java_raw_plan *plan)
+{
+  if (plan == NULL)
+    return;
+
+  free (plan->machdep);
+  free (plan);
+}
+
 #if FFI_CLOSURES		/* base system provides closures */
 
 static void
@@ -342,10 +415,18 @@ ffi_prep_java_raw_closure_loc (ffi_java_raw_closure* cl,
 {
   ffi_status status;
 
+#ifdef FFI_TARGET_HAS_RAW_CALL
+  if (ffi_prep_java_raw_closure_machdep (cl, cif, fun, user_data,
+					 codeloc) == FFI_OK)
+    return FFI_OK;
+#endif
+
+  /* As in ffi_prep_raw_closure_loc, the handler needs the writable
+     address of the closure.  */
   status = ffi_prep_closure_loc ((ffi_closure*) cl,
 				 cif,
 				 &ffi_java_translate_args,
-				 codeloc,
+				 cl,
 				 codeloc);
   if (status == FFI_OK)
     {
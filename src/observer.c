@@ -0,0 +1,133 @@
+/* -----------------------------------------------------------------------
+   observer.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file keeps the observers notified around ffi_call and closure
+   invocations.  The hooks test ffi_observers_active, the number of
+   registered observers, so that with none registered they cost a load
+   and a branch that is always predicted right.  Observers live in a
+   few fixed slots; a slot is changed under a lock and bracketed by a
+   sequence count, so that a notification never pairs the function of
+   one observer with the data of another.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+static pthread_mutex_t ffi_observer_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ffi_observer_lock() pthread_mutex_lock (&ffi_observer_lock)
+#define ffi_observer_unlock() pthread_mutex_unlock (&ffi_observer_lock)
+#else
+#define ffi_observer_lock() ((void) 0)
+#define ffi_observer_unlock() ((void) 0)
+#endif
+
+/* How many observers can be registered at once.  */
+#define FFI_OBSERVER_MAX 8
+
+struct ffi_observer
+{
+  unsigned seq;			/* Odd while the slot is being changed.  */
+  ffi_observer_fn fn;		/* NULL if the slot is free.  */
+  void *user_data;
+};
+
+static struct ffi_observer ffi_observers[FFI_OBSERVER_MAX];
+
+int ffi_observers_active;
+
+/* Store FN and USER_DATA into slot O.  Called with the lock held.  */
+static void
+ffi_observer_set (struct ffi_observer *o, ffi_observer_fn fn,
+		  void *user_data)
+{
+  __atomic_store_n (&o->seq, o->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  __atomic_store_n (&o->fn, fn, __ATOMIC_RELAXED);
+  __atomic_store_n (&o->user_data, user_data, __ATOMIC_RELAXED);
+  __atomic_store_n (&o->seq, o->seq + 1, __ATOMIC_RELEASE);
+}
+
+ffi_observer *
+ffi_observer_add (ffi_observer_fn fn, void *user_data)
+{
+  ffi_observer *o = NULL;
+  unsigned i;
+
+  if (fn == NULL)
+    return NULL;
+
+  ffi_observer_lock ();
+  for (i = 0; i < FFI_OBSERVER_MAX; i++)
+    if (ffi_observers[i].fn == NULL)
+      {
+	o = &ffi_observers[i];
+	ffi_observer_set (o, fn, user_data);
+	__atomic_fetch_add (&ffi_observers_active, 1, __ATOMIC_RELEASE);
+	break;
+      }
+  ffi_observer_unlock ();
+
+  return o;
+}
+
+void
+ffi_observer_remove (ffi_observer *o)
+{
+  if (o == NULL)
+    return;
+
+  ffi_observer_lock ();
+  if (o->fn != NULL)
+    {
+      ffi_observer_set (o, NULL, NULL);
+      __atomic_fetch_sub (&ffi_observers_active, 1, __ATOMIC_RELEASE);
+    }
+  ffi_observer_unlock ();
+}
+
+void
+ffi_observe (ffi_observe_event event, ffi_cif *cif, void (*fn)(void),
+	     void *rvalue, void **avalue)
+{
+  unsigned i, seq;
+  ffi_observer_fn f;
+  void *user_data;
+
+  for (i = 0; i < FFI_OBSERVER_MAX; i++)
+    {
+      struct ffi_observer *o = &ffi_observers[i];
+
+      seq = __atomic_load_n (&o->seq, __ATOMIC_ACQUIRE);
+      f = __atomic_load_n (&o->fn, __ATOMIC_RELAXED);
+      user_data = __atomic_load_n (&o->user_data, __ATOMIC_RELAXED);
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (f == NULL || (seq & 1)
+	  || __atomic_load_n (&o->seq, __ATOMIC_RELAXED) != seq)
+	continue;
+
+      f (event, cif, fn, rvalue, avalue, user_data);
+    }
+}
@@ -0,0 +1,141 @@
+/* -----------------------------------------------------------------------
+   packed_api.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file defines the packed argument buffer interface.  The
+   arguments of a call are laid out one after the other, each at the
+   next offset suitably aligned for its type, exactly like the members
+   of a C structure.  A packed plan keeps the offsets, and on ports
+   that define FFI_TARGET_HAS_PACKED_CALL the place of every argument,
+   so that repeated calls load the buffer straight into the argument
+   registers without classifying the arguments again.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+#include <stdlib.h>
+
+size_t
+ffi_packed_size (ffi_cif *cif)
+{
+  size_t bytes = 0, align = 1;
+  unsigned i;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      ffi_type *t = cif->arg_types[i];
+
+      bytes = ALIGN (bytes, t->alignment) + t->size;
+      if (t->alignment > align)
+	align = t->alignment;
+    }
+
+  return ALIGN (bytes, align);
+}
+
+void
+ffi_packed_offsets (ffi_cif *cif, size_t *offsets)
+{
+  size_t bytes = 0;
+  unsigned i;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      bytes = ALIGN (bytes, cif->arg_types[i]->alignment);
+      offsets[i] = bytes;
+      bytes += cif->arg_types[i]->size;
+    }
+}
+
+void
+ffi_call_packed (ffi_cif *cif, void (*fn)(void), void *rvalue, void *args)
+{
+  void **avalue;
+  size_t bytes = 0;
+  unsigned i;
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  for (i = 0; i < cif->nargs; i++)
+    {
+      bytes = ALIGN (bytes, cif->arg_types[i]->alignment);
+      avalue[i] = (char *) args + bytes;
+      bytes += cif->arg_types[i]->size;
+    }
+
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+ffi_packed_plan *
+ffi_packed_plan_alloc (ffi_cif *cif)
+{
+  ffi_packed_plan *plan;
+
+  plan = malloc (sizeof (ffi_packed_plan) + cif->nargs * sizeof (size_t));
+  if (plan == NULL)
+    return NULL;
+  plan->cif = cif;
+  plan->offsets = (size_t *) (plan + 1);
+  plan->machdep = NULL;
+  ffi_packed_offsets (cif, plan->offsets);
+
+#ifdef FFI_TARGET_HAS_PACKED_CALL
+  if (ffi_prep_packed_plan_machdep (plan) != FFI_OK)
+    {
+      free (plan->machdep);
+      plan->machdep = NULL;
+    }
+#endif
+
+  return plan;
+}
+
+void
+ffi_packed_plan_call (ffi_packed_plan *plan, void (*fn)(void), void *rvalue,
+		      void *args)
+{
+  ffi_cif *cif = plan->cif;
+  void **avalue;
+  unsigned i;
+
+#ifdef FFI_TARGET_HAS_PACKED_CALL
+  if (plan->machdep != NULL && !FFI_OBSERVING ())
+    {
+      ffi_packed_plan_call_machdep (plan, fn, rvalue, args);
+      return;
+    }
+#endif
+
+  avalue = alloca (cif->nargs * sizeof (void *));
+  for (i = 0; i < cif->nargs; i++)
+    avalue[i] = (char *) args + plan->offsets[i];
+  ffi_call (cif, fn, rvalue, avalue);
+}
+
+void
+ffi_packed_plan_free (ffi_packed_plan *plan)
+{
+  if (plan == NULL)
+    return;
+
+  free (plan->machdep);
+  free (plan);
+}
@@ -0,0 +1,359 @@
+/* -----------------------------------------------------------------------
+   parallel.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file runs batches of independent foreign calls on a pool of
+   worker threads.  Every worker owns a contiguous range of the batch,
+   so that calls sharing a cif tend to run back to back on the same
+   CPU; a worker whose range is exhausted steals the upper half of
+   another worker's range.  A batch submitted from inside a batch of
+   the same pool, by a call or a done callback, runs inline on the
+   submitting thread, as the pool is busy with the outer one.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <unistd.h>
+
+struct ffi_pool_worker
+{
+  pthread_mutex_t lock;
+  size_t lo, hi;		/* The calls still owned by this worker.  */
+  pthread_t thread;
+  ffi_pool *pool;
+};
+
+struct ffi_pool
+{
+  /* NWORKERS threads, plus one slot for the submitting thread.  */
+  unsigned nworkers;
+  struct ffi_pool_worker *workers;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  unsigned long generation;
+  unsigned active;
+  int shutdown;
+
+  /* Serializes concurrent submissions to the same pool.  */
+  pthread_mutex_t submit_lock;
+  int submitting;		/* Under LOCK, set while SUBMITTER runs.  */
+  pthread_t submitter;
+
+  /* The batch being run.  */
+  ffi_call_desc *calls;
+  void (*done)(ffi_call_desc *, void *);
+  void *user_data;
+};
+
+/* Make the NCALLS calls of CALLS in order on the calling thread.  */
+
+static void
+ffi_call_serial (ffi_call_desc *calls, size_t ncalls,
+		 void (*done)(ffi_call_desc *, void *), void *user_data)
+{
+  size_t i;
+
+  for (i = 0; i < ncalls; i++)
+    {
+      ffi_call (calls[i].cif, calls[i].fn, calls[i].rvalue, calls[i].avalue);
+      if (done)
+	done (&calls[i], user_data);
+    }
+}
+
+/* Return nonzero if the calling thread is running a batch of POOL.  */
+
+static int
+ffi_pool_busy (ffi_pool *pool)
+{
+  pthread_t self = pthread_self ();
+  unsigned i;
+  int busy;
+
+  for (i = 0; i < pool->nworkers; i++)
+    if (pthread_equal (pool->workers[i].thread, self))
+      return 1;
+
+  pthread_mutex_lock (&pool->lock);
+  busy = pool->submitting && pthread_equal (pool->submitter, self);
+  pthread_mutex_unlock (&pool->lock);
+  return busy;
+}
+
+/* Take the next call from SELF's own range, or steal the upper half
+   of the range of another worker.  Return 0 when there is no work
+   left anywhere.  */
+
+static int
+ffi_pool_next (ffi_pool *pool, unsigned self, size_t *index)
+{
+  struct ffi_pool_worker *w = &pool->workers[self];
+  unsigned n = pool->nworkers + 1;
+  unsigned i;
+
+  pthread_mutex_lock (&w->lock);
+  if (w->lo < w->hi)
+    {
+      *index = w->lo++;
+      pthread_mutex_unlock (&w->lock);
+      return 1;
+    }
+  pthread_mutex_unlock (&w->lock);
+
+  for (i = 1; i < n; i++)
+    {
+      struct ffi_pool_worker *v = &pool->workers[(self + i) % n];
+      size_t lo, hi;
+
+      pthread_mutex_lock (&v->lock);
+      lo = v->lo;
+      hi = v->hi;
+      if (lo < hi)
+	{
+	  size_t mid = lo + (hi - lo) / 2;
+	  v->hi = mid;
+	  lo = mid;
+	}
+      pthread_mutex_unlock (&v->lock);
+
+      if (lo < hi)
+	{
+	  /* Run the first stolen call now and publish the rest, so that
+	     it can be stolen in turn.  */
+	  pthread_mutex_lock (&w->lock);
+	  w->lo = lo + 1;
+	  w->hi = hi;
+	  pthread_mutex_unlock (&w->lock);
+	  *index = lo;
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+
+static void
+ffi_pool_run (ffi_pool *pool, unsigned self)
+{
+  size_t i;
+
+  while (ffi_pool_next (pool, self, &i))
+    {
+      ffi_call_desc *c = &pool->calls[i];
+
+      ffi_call (c->cif, c->fn, c->rvalue, c->avalue);
+      if (pool->done)
+	pool->done (c, pool->user_data);
+    }
+}
+
+static void *
+ffi_pool_thread (void *arg)
+{
+  struct ffi_pool_worker *w = arg;
+  ffi_pool *pool = w->pool;
+  unsigned self = w - pool->workers;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock (&pool->lock);
+  for (;;)
+    {
+      while (!pool->shutdown && pool->generation == seen)
+	pthread_cond_wait (&pool->work_cond, &pool->lock);
+      if (pool->shutdown)
+	break;
+      seen = pool->generation;
+      pthread_mutex_unlock (&pool->lock);
+
+      ffi_pool_run (pool, self);
+
+      pthread_mutex_lock (&pool->lock);
+      if (--pool->active == 0)
+	pthread_cond_signal (&pool->done_cond);
+    }
+  pthread_mutex_unlock (&pool->lock);
+
+  return NULL;
+}
+
+ffi_pool *
+ffi_pool_create (unsigned int nthreads)
+{
+  ffi_pool *pool;
+  unsigned i;
+
+  if (nthreads == 0)
+    {
+      long ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+      nthreads = ncpus > 1 ? ncpus - 1 : 1;
+    }
+
+  pool = calloc (1, sizeof (ffi_pool));
+  if (pool == NULL)
+    return NULL;
+  pool->workers = calloc (nthreads + 1, sizeof (struct ffi_pool_worker));
+  if (pool->workers == NULL)
+    {
+      free (pool);
+      return NULL;
+    }
+
+  pthread_mutex_init (&pool->lock, NULL);
+  pthread_mutex_init (&pool->submit_lock, NULL);
+  pthread_cond_init (&pool->work_cond, NULL);
+  pthread_cond_init (&pool->done_cond, NULL);
+  for (i = 0; i <= nthreads; i++)
+    {
+      pthread_mutex_init (&pool->workers[i].lock, NULL);
+      pool->workers[i].pool = pool;
+    }
+
+  for (i = 0; i < nthreads; i++)
+    if (pthread_create (&pool->workers[i].thread, NULL,
+			ffi_pool_thread, &pool->workers[i]) != 0)
+      break;
+
+  /* The submitting thread always takes part, in the slot after the
+     last worker, so running with fewer threads than asked for is only
+     slower.  */
+  pool->nworkers = i;
+
+  return pool;
+}
+
+void
+ffi_pool_destroy (ffi_pool *pool)
+{
+  unsigned i;
+
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast (&pool->work_cond);
+  pthread_mutex_unlock (&pool->lock);
+
+  for (i = 0; i < pool->nworkers; i++)
+    pthread_join (pool->workers[i].thread, NULL);
+
+  for (i = 0; i <= pool->nworkers; i++)
+    pthread_mutex_destroy (&pool->workers[i].lock);
+  pthread_cond_destroy (&pool->done_cond);
+  pthread_cond_destroy (&pool->work_cond);
+  pthread_mutex_destroy (&pool->submit_lock);
+  pthread_mutex_destroy (&pool->lock);
+  free (pool->workers);
+  free (pool);
+}
+
+void
+ffi_call_parallel (ffi_pool *pool, ffi_call_desc *calls, size_t ncalls,
+		   void (*done)(ffi_call_desc *, void *), void *user_data)
+{
+  unsigned i, n;
+  size_t share, lo;
+
+  if (pool == NULL || pool->nworkers == 0 || ncalls < 2
+      || ffi_pool_busy (pool))
+    {
+      ffi_call_serial (calls, ncalls, done, user_data);
+      return;
+    }
+
+  pthread_mutex_lock (&pool->submit_lock);
+
+  pool->calls = calls;
+  pool->done = done;
+  pool->user_data = user_data;
+
+  /* Hand each worker, and the submitting thread, an equal slice.  */
+  n = pool->nworkers + 1;
+  share = ncalls / n;
+  for (i = 0, lo = 0; i < n; i++)
+    {
+      size_t hi = i == n - 1 ? ncalls : lo + share;
+
+      pthread_mutex_lock (&pool->workers[i].lock);
+      pool->workers[i].lo = lo;
+      pool->workers[i].hi = hi;
+      pthread_mutex_unlock (&pool->workers[i].lock);
+      lo = hi;
+    }
+
+  pthread_mutex_lock (&pool->lock);
+  pool->submitting = 1;
+  pool->submitter = pthread_self ();
+  pool->active = pool->nworkers;
+  pool->generation++;
+  pthread_cond_broadcast (&pool->work_cond);
+  pthread_mutex_unlock (&pool->lock);
+
+  ffi_pool_run (pool, pool->nworkers);
+
+  pthread_mutex_lock (&pool->lock);
+  while (pool->active != 0)
+    pthread_cond_wait (&pool->done_cond, &pool->lock);
+  pool->submitting = 0;
+  pthread_mutex_unlock (&pool->lock);
+
+  pthread_mutex_unlock (&pool->submit_lock);
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+/* Without threads, a pool is never created and every batch runs in
+   the calling thread.  */
+
+ffi_pool *
+ffi_pool_create (unsigned int nthreads)
+{
+  return NULL;
+}
+
+void
+ffi_pool_destroy (ffi_pool *pool)
+{
+}
+
+void
+ffi_call_parallel (ffi_pool *pool, ffi_call_desc *calls, size_t ncalls,
+		   void (*done)(ffi_call_desc *, void *), void *user_data)
+{
+  size_t i;
+
+  for (i = 0; i < ncalls; i++)
+    {
+      ffi_call (calls[i].cif, calls[i].fn, calls[i].rvalue, calls[i].avalue);
+      if (done)
+	done (&calls[i], user_data);
+    }
+}
+
+#endif /* HAVE_PTHREAD_H */
@@ -41,6 +41,29 @@ static ffi_status initialize_aggregate(ffi_type *arg, size_t *offsets)
   if (UNLIKELY(arg == NULL || arg->elements == NULL))
     return FFI_BAD_TYPEDEF;
 
+  /* An array is laid out from its element alone, however long it is.  */
+  if (arg->type == FFI_TYPE_ARRAY)
+    {
+#ifdef FFI_TARGET_HAS_ARRAY_TYPE
+      ffi_type *e = arg->elements[0];
+      size_t count = FFI_ARRAY_COUNT (arg);
+
+      if (UNLIKELY(e == NULL || e->type == FFI_TYPE_VOID || count == 0))
+	return FFI_BAD_TYPEDEF;
+      if (UNLIKELY((e->size == 0) && (initialize_aggregate(e, NULL) != FFI_OK)))
+	return FFI_BAD_TYPEDEF;
+      FFI_ASSERT_VALID_TYPE(e);
+      if (UNLIKELY(e->size > (size_t) -1 / count))
+	return FFI_BAD_TYPEDEF;
+
+      arg->size = e->size * count;
+      arg->alignment = e->alignment;
+      return FFI_OK;
+#else
+      return FFI_BAD_TYPEDEF;
+#endif
+    }
+
   arg->size = 0;
   arg->alignment = 0;
 
@@ -115,6 +138,7 @@ ffi_status FFI_HIDDEN ffi_prep_cif_core(ffi_cif *cif, ffi_abi abi,
   unsigned bytes = 0;
   unsigned int i;
   ffi_type **ptr;
+  ffi_status status;
 
   FFI_ASSERT(cif != NULL);
   FFI_ASSERT((!isvariadic) || (nfixedargs >= 1));
@@ -143,6 +167,9 @@ ffi_status FFI_HIDDEN ffi_prep_cif_core(ffi_cif *cif, ffi_abi abi,
   if (rtype->type == FFI_TYPE_COMPLEX)
     abort();
 #endif
+  /* C passes and returns arrays only inside structures.  */
+  if (rtype->type == FFI_TYPE_ARRAY)
+    return FFI_BAD_TYPEDEF;
   /* Perform a sanity check on the return type */
   FFI_ASSERT_VALID_TYPE(cif->rtype);
 
@@ -175,6 +202,8 @@ ffi_status FFI_HIDDEN ffi_prep_cif_core(ffi_cif *cif, ffi_abi abi,
       if ((*ptr)->type == FFI_TYPE_COMPLEX)
 	abort();
 #endif
+      if ((*ptr)->type == FFI_TYPE_ARRAY)
+	return FFI_BAD_TYPEDEF;
       /* Perform a sanity check on the argument type, do this
 	 check after the initialization.  */
       FFI_ASSERT_VALID_TYPE(*ptr);
@@ -209,10 +238,16 @@ ffi_status FFI_HIDDEN ffi_prep_cif_core(ffi_cif *cif, ffi_abi abi,
   /* Perform machine dependent cif processing */
 #ifdef FFI_TARGET_SPECIFIC_VARIADIC
   if (isvariadic)
-	return ffi_prep_cif_machdep_var(cif, nfixedargs, ntotalargs);
+	status = ffi_prep_cif_machdep_var(cif, nfixedargs, ntotalargs);
+  else
 #endif
+  status = ffi_prep_cif_machdep(cif);
 
-  return ffi_prep_cif_machdep(cif);
+  /* Bind the cif to a precompiled thunk, if there is one.  */
+  if (status == FFI_OK
+      && UNLIKELY (__atomic_load_n (&ffi_aot_active, __ATOMIC_RELAXED)))
+    ffi_aot_bind (cif, isvariadic);
+  return status;
 }
 #endif /* not __CRIS__ */
 
@@ -259,3 +294,23 @@ ffi_get_struct_offsets (ffi_abi abi, ffi_type *struct_type, size_t *offsets)
 
   return initialize_aggregate(struct_type, offsets);
 }
+
+ffi_status
+ffi_prep_array_type (ffi_array_type *array, ffi_type *element, size_t count)
+{
+#ifdef FFI_TARGET_HAS_ARRAY_TYPE
+  if (element == NULL || element->type == FFI_TYPE_VOID || count == 0)
+    return FFI_BAD_TYPEDEF;
+
+  array->type.size = 0;
+  array->type.alignment = 0;
+  array->type.type = FFI_TYPE_ARRAY;
+  array->type.elements = array->elements;
+  array->count = count;
+  array->elements[0] = element;
+  array->elements[1] = NULL;
+  return FFI_OK;
+#else
+  return FFI_BAD_TYPEDEF;
+#endif
+}
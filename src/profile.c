@@ -0,0 +1,299 @@
+/* -----------------------------------------------------------------------
+   profile.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file attributes the time spent in calls and closures to their
+   cif, when configured with --enable-profile.  Each cif, once as a
+   call and once as a closure, gets an entry in a fixed hash table
+   that is claimed with a compare and swap and updated with atomic
+   adds, so recording takes no lock.  Every entry keeps the ticks spent
+   marshalling arguments and in the callee, and log2 histograms of the
+   total time and of the marshalling time.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FFI_PROFILE
+
+/* The number of entries, a power of two, and how far a lookup probes
+   before giving up and counting into ffi_profile_other.  */
+#define FFI_PROFILE_SLOTS 1024
+#define FFI_PROFILE_PROBES 32
+
+/* Bucket B of a histogram counts times below 2^B and, except for the
+   first, not below 2^(B-1); the last bucket counts the rest.  */
+#define FFI_PROFILE_BUCKETS 40
+
+#define FFI_PROFILE_SIG 96
+
+struct ffi_profile_entry
+{
+  uintptr_t key;		/* The cif and the kind, 0 while free.  */
+  int ready;			/* Nonzero once SIG is filled in.  */
+  char sig[FFI_PROFILE_SIG];
+  size_t count;
+  UINT64 marshal, callee;	/* Ticks spent in each phase.  */
+  size_t total_hist[FFI_PROFILE_BUCKETS];
+  size_t marshal_hist[FFI_PROFILE_BUCKETS];
+};
+
+static struct ffi_profile_entry *ffi_profile_table;
+
+/* Counts for cifs that found no room in the table.  */
+static struct ffi_profile_entry ffi_profile_other;
+
+/* Return the entry of CIF as KIND, claiming one if need be.  */
+static struct ffi_profile_entry *
+ffi_profile_lookup (ffi_cif *cif, int kind)
+{
+  struct ffi_profile_entry *table, *e;
+  uintptr_t key = (uintptr_t) cif | kind, expected;
+  size_t h, i;
+
+  table = __atomic_load_n (&ffi_profile_table, __ATOMIC_ACQUIRE);
+  if (UNLIKELY (table == NULL))
+    {
+      struct ffi_profile_entry *fresh
+	= calloc (FFI_PROFILE_SLOTS, sizeof (struct ffi_profile_entry));
+
+      if (fresh == NULL)
+	return &ffi_profile_other;
+      if (__atomic_compare_exchange_n (&ffi_profile_table, &table, fresh, 0,
+				       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	table = fresh;
+      else
+	free (fresh);
+    }
+
+  h = (size_t) (((UINT64) key >> 3) * 0x9e3779b97f4a7c15ULL >> 32);
+  for (i = 0; i < FFI_PROFILE_PROBES; i++)
+    {
+      e = &table[(h + i) & (FFI_PROFILE_SLOTS - 1)];
+      expected = __atomic_load_n (&e->key, __ATOMIC_RELAXED);
+      if (expected == key)
+	return e;
+      if (expected == 0)
+	{
+	  if (__atomic_compare_exchange_n (&e->key, &expected, key, 0,
+					   __ATOMIC_RELAXED,
+					   __ATOMIC_RELAXED))
+	    {
+	      ffi_describe_cif (e->sig, sizeof (e->sig), cif);
+	      __atomic_store_n (&e->ready, 1, __ATOMIC_RELEASE);
+	      return e;
+	    }
+	  if (expected == key)
+	    return e;
+	}
+    }
+
+  return &ffi_profile_other;
+}
+
+static unsigned
+ffi_profile_bucket (UINT64 t)
+{
+  unsigned b = 0;
+
+  while (t && b < FFI_PROFILE_BUCKETS - 1)
+    {
+      t >>= 1;
+      b++;
+    }
+  return b;
+}
+
+void
+ffi_profile_record (ffi_cif *cif, int kind, const UINT64 *t)
+{
+  struct ffi_profile_entry *e = ffi_profile_lookup (cif, kind);
+  UINT64 marshal = t[1] - t[0];
+  UINT64 callee = t[2] - t[1];
+
+  __atomic_fetch_add (&e->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&e->marshal, marshal, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&e->callee, callee, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&e->total_hist[ffi_profile_bucket (marshal + callee)],
+		      1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&e->marshal_hist[ffi_profile_bucket (marshal)], 1,
+		      __ATOMIC_RELAXED);
+}
+
+/* A copy of an entry, as reported.  */
+struct ffi_profile_row
+{
+  const struct ffi_profile_entry *e;
+  int kind;
+  size_t count;
+  UINT64 marshal, total;
+};
+
+static int
+ffi_profile_by_total (const void *a, const void *b)
+{
+  const struct ffi_profile_row *x = a, *y = b;
+
+  return x->total < y->total ? 1 : x->total > y->total ? -1 : 0;
+}
+
+static int
+ffi_profile_by_marshal (const void *a, const void *b)
+{
+  const struct ffi_profile_row *x = a, *y = b;
+
+  return x->marshal < y->marshal ? 1 : x->marshal > y->marshal ? -1 : 0;
+}
+
+/* Return the upper bound of the bucket of HIST holding quantile Q.  */
+static UINT64
+ffi_profile_quantile (const size_t *hist, size_t count, double q)
+{
+  size_t seen = 0, want = (size_t) (count * q);
+  unsigned b;
+
+  for (b = 0; b < FFI_PROFILE_BUCKETS - 1; b++)
+    {
+      seen += __atomic_load_n (&hist[b], __ATOMIC_RELAXED);
+      if (seen > want)
+	break;
+    }
+  return (UINT64) 1 << b;
+}
+
+static void
+ffi_profile_print (void (*print) (const char *, void *), void *user_data,
+		   const struct ffi_profile_row *r)
+{
+  char line[256];
+  double total = r->total ? (double) r->total : 1;
+
+  snprintf (line, sizeof (line),
+	    "%s\t%lu\t%llu\t%.1f\t%llu\t%llu\t%llu\t%.1f\t%s\n",
+	    r->e == &ffi_profile_other ? "other"
+	    : r->kind == FFI_PROFILE_CALL ? "call" : "closure",
+	    (unsigned long) r->count, (unsigned long long) r->total,
+	    (double) r->total / r->count,
+	    (unsigned long long) ffi_profile_quantile (r->e->total_hist,
+						       r->count, 0.5),
+	    (unsigned long long) ffi_profile_quantile (r->e->total_hist,
+						       r->count, 0.99),
+	    (unsigned long long) ffi_profile_quantile (r->e->marshal_hist,
+						       r->count, 0.5),
+	    100 * r->marshal / total,
+	    r->e == &ffi_profile_other ? "-" : r->e->sig);
+  print (line, user_data);
+}
+
+static void
+ffi_profile_print_stderr (const char *line, void *user_data)
+{
+  fputs (line, stderr);
+}
+
+static void
+ffi_profile_table_out (void (*print) (const char *, void *), void *user_data,
+		       struct ffi_profile_row *rows, size_t n, unsigned top,
+		       const char *title)
+{
+  size_t i;
+
+  print (title, user_data);
+  print ("# kind\tcount\tticks\tmean\tp50\tp99\tmarshal p50"
+	 "\tmarshal%\tsignature\n", user_data);
+  for (i = 0; i < n && (top == 0 || i < top); i++)
+    ffi_profile_print (print, user_data, &rows[i]);
+}
+
+ffi_status
+ffi_profile_report (void (*print) (const char *line, void *user_data),
+		    void *user_data, unsigned int top)
+{
+  struct ffi_profile_entry *table;
+  struct ffi_profile_row *rows;
+  size_t i, n = 0;
+
+  if (print == NULL)
+    print = ffi_profile_print_stderr;
+
+  rows = malloc ((FFI_PROFILE_SLOTS + 1) * sizeof (struct ffi_profile_row));
+  if (rows == NULL)
+    return FFI_BAD_TYPEDEF;
+
+  table = __atomic_load_n (&ffi_profile_table, __ATOMIC_ACQUIRE);
+  for (i = 0; i <= FFI_PROFILE_SLOTS; i++)
+    {
+      const struct ffi_profile_entry *e;
+      struct ffi_profile_row *r = &rows[n];
+
+      if (i < FFI_PROFILE_SLOTS)
+	{
+	  if (table == NULL)
+	    continue;
+	  e = &table[i];
+	  if (!__atomic_load_n (&e->ready, __ATOMIC_ACQUIRE))
+	    continue;
+	  r->kind = e->key & 1;
+	}
+      else
+	{
+	  e = &ffi_profile_other;
+	  r->kind = FFI_PROFILE_CALL;
+	}
+
+      r->e = e;
+      r->count = __atomic_load_n (&e->count, __ATOMIC_RELAXED);
+      if (r->count == 0)
+	continue;
+      r->marshal = __atomic_load_n (&e->marshal, __ATOMIC_RELAXED);
+      r->total = r->marshal + __atomic_load_n (&e->callee, __ATOMIC_RELAXED);
+      n++;
+    }
+
+  qsort (rows, n, sizeof (*rows), ffi_profile_by_total);
+  ffi_profile_table_out (print, user_data, rows, n, top,
+			 "# libffi profile: by total ticks\n");
+  qsort (rows, n, sizeof (*rows), ffi_profile_by_marshal);
+  ffi_profile_table_out (print, user_data, rows, n, top,
+			 "# libffi profile: by marshalling ticks\n");
+
+  free (rows);
+  return FFI_OK;
+}
+
+#else /* !FFI_PROFILE */
+
+/* Profiling was not configured in.  */
+
+ffi_status
+ffi_profile_report (void (*print) (const char *line, void *user_data),
+		    void *user_data, unsigned int top)
+{
+  return FFI_BAD_ABI;
+}
+
+#endif /* FFI_PROFILE */
@@ -203,7 +203,15 @@ ffi_ptrarray_to_raw (ffi_cif *cif, void **args, ffi_raw *raw)
 
 void ffi_raw_call (ffi_cif *cif, void (*fn)(void), void *rvalue, ffi_raw *raw)
 {
-  void **avalue = (void**) alloca (cif->nargs * sizeof (void*));
+  void **avalue;
+
+#ifdef FFI_TARGET_HAS_RAW_CALL
+  if (!FFI_OBSERVING ()
+      && ffi_raw_call_machdep (cif, fn, rvalue, raw) == FFI_OK)
+    return;
+#endif
+
+  avalue = (void**) alloca (cif->nargs * sizeof (void*));
   ffi_raw_to_ptrarray (cif, raw, avalue);
   ffi_call (cif, fn, rvalue, avalue);
 }
@@ -230,10 +238,19 @@ ffi_prep_raw_closure_loc (ffi_raw_closure* cl,
 {
   ffi_status status;
 
+#ifdef FFI_TARGET_HAS_RAW_CALL
+  if (ffi_prep_raw_closure_machdep (cl, cif, fun, user_data,
+				    codeloc) == FFI_OK)
+    return FFI_OK;
+#endif
+
+  /* The handler finds the raw closure through its user_data, which
+     must be the writable address: CODELOC may be another mapping or a
+     separate trampoline.  */
   status = ffi_prep_closure_loc ((ffi_closure*) cl,
 				 cif,
 				 &ffi_translate_args,
-				 codeloc,
+				 cl,
 				 codeloc);
   if (status == FFI_OK)
     {
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""Generate precompiled libffi call thunks and closure entry stubs.
+
+Reads a manifest of signatures and writes C source holding, for each
+signature, a thunk that calls a function of that type with the
+arguments of ffi_call, entry stubs for a fixed number of closures, and
+a table of ffi_aot_signature for ffi_aot_register.  Once the table is
+registered, ffi_prep_cif binds matching cifs to their thunk, and
+ffi_aot_closure_alloc hands out the stubs, so no code is generated at
+run time.
+
+The manifest has one declaration per line; '#' starts a comment.
+
+    struct point { double, double }
+    sint32 (pointer, sint32)
+    double (point, double) closures=4
+
+Types are void, uint8, sint8, uint16, sint16, uint32, sint32, uint64,
+sint64, float, double, longdouble, pointer and the structures declared
+above.  Every signature uses FFI_DEFAULT_ABI.
+
+The output registers its table from a constructor, unless compiled
+with FFI_AOT_NO_CONSTRUCTOR; NAME_register does it by hand.
+
+usage: aot.py [-o OUTPUT] [--name NAME] MANIFEST
+"""
+
+import argparse
+import re
+import sys
+
+# Name: (C type, ffi_type, how ffi_call stores it in a return value).
+SCALARS = {
+    'void': ('void', 'ffi_type_void', None),
+    'uint8': ('uint8_t', 'ffi_type_uint8', 'ffi_arg'),
+    'sint8': ('int8_t', 'ffi_type_sint8', 'ffi_sarg'),
+    'uint16': ('uint16_t', 'ffi_type_uint16', 'ffi_arg'),
+    'sint16': ('int16_t', 'ffi_type_sint16', 'ffi_sarg'),
+    'uint32': ('uint32_t', 'ffi_type_uint32', 'ffi_arg'),
+    'sint32': ('int32_t', 'ffi_type_sint32', 'ffi_sarg'),
+    'uint64': ('uint64_t', 'ffi_type_uint64', None),
+    'sint64': ('int64_t', 'ffi_type_sint64', None),
+    'float': ('float', 'ffi_type_float', None),
+    'double': ('double', 'ffi_type_double', None),
+    'longdouble': ('long double', 'ffi_type_longdouble', None),
+    'pointer': ('void *', 'ffi_type_pointer', None),
+}
+
+STRUCT_RE = re.compile(r'^struct\s+(\w+)\s*\{(.*)\}$')
+SIG_RE = re.compile(r'^(\w+)\s*\((.*)\)\s*(?:closures\s*=\s*(\d+))?$')
+
+
+class Error(Exception):
+    pass
+
+
+class Generator:
+    def __init__(self, name):
+        self.name = name
+        self.structs = {}
+        self.sigs = []
+        self.out = []
+
+    def ctype(self, t):
+        if t in SCALARS:
+            return SCALARS[t][0]
+        return 'struct %s_%s' % (self.name, t)
+
+    def cpointer(self, t):
+        c = self.ctype(t)
+        return c + '*' if c.endswith('*') else c + ' *'
+
+    def ffi_type(self, t):
+        if t in SCALARS:
+            return '&' + SCALARS[t][1]
+        return '&%s_%s_type' % (self.name, t)
+
+    def check_type(self, t, lineno, void_ok=False):
+        if t == 'void' and not void_ok:
+            raise Error('%d: void is not an argument type' % lineno)
+        if t not in SCALARS and t not in self.structs:
+            raise Error('%d: unknown type %s' % (lineno, t))
+
+    def parse(self, lines):
+        for lineno, line in enumerate(lines, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            m = STRUCT_RE.match(line)
+            if m:
+                fields = [f.strip() for f in m.group(2).split(',')]
+                if m.group(1) in SCALARS or m.group(1) in self.structs:
+                    raise Error('%d: %s is already a type' % (lineno, m.group(1)))
+                if fields == ['']:
+                    raise Error('%d: empty structure' % lineno)
+                for f in fields:
+                    self.check_type(f, lineno)
+                self.structs[m.group(1)] = fields
+                continue
+            m = SIG_RE.match(line)
+            if not m:
+                raise Error('%d: cannot parse "%s"' % (lineno, line))
+            args = [a.strip() for a in m.group(2).split(',')]
+            if args in ([''], ['void']):
+                args = []
+            self.check_type(m.group(1), lineno, void_ok=True)
+            for a in args:
+                self.check_type(a, lineno)
+            self.sigs.append((m.group(1), args, int(m.group(3) or 0), line))
+
+    def emit(self, s=''):
+        self.out.append(s)
+
+    def emit_struct(self, name, fields):
+        n = self.name
+        self.emit('struct %s_%s {' % (n, name))
+        for i, f in enumerate(fields):
+            self.emit('  %s f%d;' % (self.ctype(f), i))
+        self.emit('};')
+        self.emit('static ffi_type *%s_%s_elements[] = { %s, NULL };'
+                  % (n, name, ', '.join(self.ffi_type(f) for f in fields)))
+        self.emit('static ffi_type %s_%s_type = { 0, 0, FFI_TYPE_STRUCT, %s_%s_elements };'
+                  % (n, name, n, name))
+        self.emit()
+
+    def emit_sig(self, i, rtype, args, nclosures, text):
+        n = '%s_%d' % (self.name, i)
+        rc = self.ctype(rtype)
+        params = ', '.join(self.ctype(a) for a in args) or 'void'
+        self.emit('/* %s */' % text)
+        self.emit('static ffi_type *%s_args[] = { %s };'
+                  % (n, ', '.join([self.ffi_type(a) for a in args] + ['NULL'])))
+
+        # The call thunk.
+        call = '((%s (*) (%s)) fn) (%s)' % (
+            rc, params, ', '.join('*(%s) avalue[%d]' % (self.cpointer(a), j)
+                                  for j, a in enumerate(args)))
+        self.emit('static void')
+        self.emit('%s_call (void (*fn) (void), void *rvalue, void **avalue)' % n)
+        self.emit('{')
+        if rtype == 'void':
+            self.emit('  %s;' % call)
+        else:
+            store = SCALARS.get(rtype, (None, None, None))[2]
+            self.emit('  %s r = %s;' % (rc, call))
+            self.emit('  if (rvalue != NULL)')
+            self.emit('    *(%s) rvalue = r;'
+                      % (store + ' *' if store else self.cpointer(rtype)))
+        self.emit('}')
+        self.emit()
+
+        # The closure entry stubs.
+        if nclosures:
+            self.emit('static ffi_aot_closure %s_closures[%d];' % (n, nclosures))
+            self.emit()
+        for c in range(nclosures):
+            self.emit('static %s' % rc)
+            self.emit('%s_entry_%d (%s)' % (n, c, ', '.join(
+                '%s a%d' % (self.ctype(a), j) for j, a in enumerate(args)) or 'void'))
+            self.emit('{')
+            self.emit('  ffi_aot_closure *c = &%s_closures[%d];' % (n, c))
+            self.emit('  void *avalue[%d];' % max(len(args), 1))
+            if rtype == 'void':
+                self.emit('  ffi_arg r;')
+            else:
+                self.emit('  %s r;' % (SCALARS.get(rtype, (None, None, None))[2] or rc))
+            self.emit()
+            for j in range(len(args)):
+                self.emit('  avalue[%d] = &a%d;' % (j, j))
+            self.emit('  c->fun (c->cif, &r, avalue, c->user_data);')
+            if rtype != 'void':
+                self.emit('  return r;')
+            self.emit('}')
+            self.emit()
+        if nclosures:
+            self.emit('static void (*const %s_entries[]) (void) = {' % n)
+            for c in range(nclosures):
+                self.emit('  (void (*) (void)) %s_entry_%d,' % (n, c))
+            self.emit('};')
+            self.emit()
+
+    def generate(self, source):
+        n = self.name
+        self.emit('/* Generated by aot.py from %s.  Do not edit.  */' % source)
+        self.emit()
+        self.emit('#include <stddef.h>')
+        self.emit('#include <stdint.h>')
+        self.emit('#include <ffi.h>')
+        self.emit()
+        for name, fields in self.structs.items():
+            self.emit_struct(name, fields)
+        for i, (rtype, args, nclosures, text) in enumerate(self.sigs):
+            self.emit_sig(i, rtype, args, nclosures, text)
+
+        self.emit('const ffi_aot_signature %s_signatures[] = {' % n)
+        for i, (rtype, args, nclosures, text) in enumerate(self.sigs):
+            if nclosures:
+                closures = '%s_%d_closures, %s_%d_entries' % (n, i, n, i)
+            else:
+                closures = 'NULL, NULL'
+            self.emit('  { FFI_DEFAULT_ABI, %d, %s, %s_%d_args, %s_%d_call, %d, %s },'
+                      % (len(args), self.ffi_type(rtype), n, i, n, i,
+                         nclosures, closures))
+        self.emit('};')
+        self.emit()
+        self.emit('ffi_status')
+        self.emit('%s_register (void)' % n)
+        self.emit('{')
+        self.emit('  return ffi_aot_register (%s_signatures, %d);' % (n, len(self.sigs)))
+        self.emit('}')
+        self.emit()
+        self.emit('#if defined (__GNUC__) && !defined (FFI_AOT_NO_CONSTRUCTOR)')
+        self.emit('static void __attribute__ ((constructor))')
+        self.emit('%s_init (void)' % n)
+        self.emit('{')
+        self.emit('  %s_register ();' % n)
+        self.emit('}')
+        self.emit('#endif')
+        return '\n'.join(self.out) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Generate precompiled libffi call thunks and closure stubs.')
+    parser.add_argument('manifest')
+    parser.add_argument('-o', '--output', help='output file, default stdout')
+    parser.add_argument('--name', default='ffi_aot',
+                        help='prefix of the generated symbols')
+    opts = parser.parse_args()
+
+    gen = Generator(opts.name)
+    try:
+        with open(opts.manifest) as f:
+            gen.parse(f)
+    except Error as e:
+        sys.exit('%s:%s' % (opts.manifest, e))
+    text = gen.generate(opts.manifest.split('/')[-1])
+    if opts.output:
+        with open(opts.output, 'w') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == '__main__':
+    main()
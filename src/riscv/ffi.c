@@ -36,6 +36,30 @@
 #define STACK_ARG_SIZE(x) ALIGN(x, FFI_SIZEOF_ARG)
 
 
+/* Step through the fields of the struct S_ARG for the functions that
+   place it in registers, where an array stands for COUNT fields of its
+   element type.  Those only see structs of at most 2XLEN bytes, so this
+   is never many.  *INDEX and *K start at zero. */
+static ffi_type *riscv_next_field(ffi_type *s_arg, unsigned *index, size_t *k)
+{
+    ffi_type *e;
+    size_t count;
+
+    while ((e = s_arg->elements[*index]))
+    {
+        for (count = 1; e->type == FFI_TYPE_ARRAY; e = e->elements[0])
+            count *= FFI_ARRAY_COUNT(e);
+        if (*k < count)
+        {
+            (*k)++;
+            return e;
+        }
+        (*index)++;
+        *k = 0;
+    }
+    return NULL;
+}
+
 /* This function counts the number of floats and non-floats in a struct recursively.
    We need this recursive function since there may be nested structs, and the struct ABI
    is based on the assumption the structs are flatten to a flat hierarchy.
@@ -58,6 +82,19 @@ static void struct_float_counter(unsigned int* num_struct_floats, unsigned int*
         {
             struct_float_counter(num_struct_floats, num_struct_ints, e, max_fp_reg_size);
         }
+        else if (e->type == FFI_TYPE_ARRAY)
+        {
+            /* Count one element and scale. Past two fields a struct is
+               never flattened, so three copies are as good as any. */
+            unsigned int nf = 0, ni = 0;
+            size_t count = FFI_ARRAY_COUNT(e);
+
+            struct_float_counter(&nf, &ni, e, max_fp_reg_size);
+            if (count > 3)
+                count = 3;
+            *num_struct_floats += nf * count;
+            *num_struct_ints += ni * count;
+        }
         else
         {
             (*num_struct_ints)++;
@@ -74,7 +111,8 @@ static void struct_args_to_regs(ffi_type * p_arg, char** argp, char** fargp, voi
 {
     ffi_type *e;
     unsigned index = 0;
-    while ((e = (p_arg)->elements[index]))
+    size_t k = 0;
+    while ((e = riscv_next_field(p_arg, &index, &k)))
     {
         if (e->type == FFI_TYPE_DOUBLE || e->type == FFI_TYPE_FLOAT)
         {
@@ -149,13 +187,18 @@ static void struct_args_to_regs(ffi_type * p_arg, char** argp, char** fargp, voi
                 break;
 
             case FFI_TYPE_STRUCT:
-               struct_args_to_regs(p_arg, argp, fargp, p_argv, xreg, freg, a);
+            {
+               /* The fields move *p_argv; step over the whole struct below. */
+               void *start = *p_argv;
+
+               struct_args_to_regs(e, argp, fargp, p_argv, xreg, freg, a);
+               *p_argv = start;
                break;
+            }
 
             default:
                break; 
          }
-         index++;
          (*p_argv)+= e->size;
     }
 }
@@ -474,6 +517,15 @@ static void riscv_struct_bytes(unsigned int* fbytes, unsigned int* bytes, ffi_ty
         {
             riscv_struct_bytes(fbytes, bytes,e);
         }
+        else if (e->type == FFI_TYPE_ARRAY)
+        {
+            /* Lay out one element and scale it up for the rest. */
+            unsigned int f = *fbytes, b = *bytes;
+
+            riscv_struct_bytes(fbytes, bytes, e);
+            *fbytes += (*fbytes - f) * (FFI_ARRAY_COUNT(e) - 1);
+            *bytes += (*bytes - b) * (FFI_ARRAY_COUNT(e) - 1);
+        }
         else
         {
             /* Add any padding if necessary */
@@ -493,9 +545,10 @@ static void riscv_struct_bytes(unsigned int* fbytes, unsigned int* bytes, ffi_ty
    This is done recursively to handle the case of nested structs. */
 static void riscv_struct_flags(unsigned int* farg_reg, unsigned int* xarg_reg, unsigned int* temp_float_flags, unsigned int* temp_int_flags, ffi_type *s_arg, unsigned int max_fp_reg_size)
 {
-    int struct_index=0;
+    unsigned struct_index=0;
+    size_t k = 0;
     ffi_type *e;
-    while ((e = s_arg->elements[struct_index]))
+    while ((e = riscv_next_field(s_arg, &struct_index, &k)))
     {
         if (e->type == FFI_TYPE_DOUBLE && max_fp_reg_size >= 64)
         {
@@ -516,7 +569,6 @@ static void riscv_struct_flags(unsigned int* farg_reg, unsigned int* xarg_reg, u
             *temp_int_flags += 0 << (*xarg_reg);
             (*xarg_reg)++;
         }
-        struct_index++;
     }
 }
 
@@ -526,21 +578,22 @@ static void riscv_struct_flags(unsigned int* farg_reg, unsigned int* xarg_reg, u
    Requires recursive function since ABI assumes struct hierarchies are flattened */
 static unsigned riscv_return_struct_flags_rec(ffi_type *arg, unsigned flags)
 {
-    unsigned int index = 0;
+    unsigned int index = 0, pos = 0;
+    size_t k = 0;
     ffi_type *e;
     
 
-    while ((e = arg->elements[index]))
+    while ((e = riscv_next_field(arg, &index, &k)))
     {
         if (e->type == FFI_TYPE_DOUBLE)
-            flags += FFI_TYPE_DOUBLE << (index*FFI_FLAG_BITS);
+            flags += FFI_TYPE_DOUBLE << (pos*FFI_FLAG_BITS);
         else if (e->type == FFI_TYPE_FLOAT)
-            flags += FFI_TYPE_FLOAT << (index*FFI_FLAG_BITS);
+            flags += FFI_TYPE_FLOAT << (pos*FFI_FLAG_BITS);
         else if (e->type == FFI_TYPE_STRUCT)
-            flags += riscv_return_struct_flags_rec(e, flags) << (index*FFI_FLAG_BITS);
+            flags += riscv_return_struct_flags_rec(e, flags) << (pos*FFI_FLAG_BITS);
         else
-            flags += FFI_TYPE_INT << (index*FFI_FLAG_BITS);
-        index++;
+            flags += FFI_TYPE_INT << (pos*FFI_FLAG_BITS);
+        pos++;
     }
     return flags;
 }
@@ -865,13 +918,294 @@ ffi_status ffi_prep_cif_machdep_var(ffi_cif *cif, unsigned int nfixedargs, unsig
     return FFI_OK;
 }
 
+/* Argument placement.  riscv_explain_args walks the arguments the way
+   ffi_prep_args does, keeping only its offsets into the register image
+   and counters, and records where each argument is stored. */
+
+const char *ffi_explain_reg_machdep(int fp, int ret, unsigned n)
+{
+    static const char *const xregs[] = { "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7" };
+    static const char *const fregs[] = { "fa0", "fa1", "fa2", "fa3", "fa4", "fa5", "fa6", "fa7" };
+
+    if (n >= 8)
+        return "?";
+    return fp ? fregs[n] : xregs[n];
+}
+
+/* Count the floating point and integer fields that struct_args_to_regs
+   moves into registers. */
+static void riscv_flat_fields(ffi_type *s_arg, unsigned *nf, unsigned *ni)
+{
+    ffi_type *e;
+    unsigned index = 0;
+    size_t k = 0;
+
+    *nf = *ni = 0;
+    while ((e = riscv_next_field(s_arg, &index, &k)))
+    {
+        if (e->type == FFI_TYPE_FLOAT || e->type == FFI_TYPE_DOUBLE)
+            (*nf)++;
+        else if (e->type >= FFI_TYPE_UINT8 && e->type <= FFI_TYPE_SINT64)
+            (*ni)++;
+    }
+}
+
+/* Place Z bytes stored at OFFSET in the image, whose integer register
+   part starts at INT_BASE and whose stack part starts at CAP. */
+static void riscv_place_int(ffi_placement *p, unsigned offset, unsigned z, unsigned int_base, unsigned cap)
+{
+    if (offset >= cap)
+    {
+        p->kind = FFI_PLACE_STACK;
+        p->stack = offset - cap;
+        p->stack_size = z;
+    }
+    else
+    {
+        unsigned in_regs = (offset + z <= cap) ? z : cap - offset;
+
+        p->kind = (in_regs == z) ? FFI_PLACE_GPR : FFI_PLACE_GPR_STACK;
+        p->gpr = (offset - int_base) / FFI_SIZEOF_ARG;
+        p->ngpr = (in_regs + FFI_SIZEOF_ARG - 1) / FFI_SIZEOF_ARG;
+        p->stack_size = z - in_regs;
+    }
+}
+
+/* Place a structure flattened by struct_args_to_regs. */
+static void riscv_place_flat(ffi_placement *p, ffi_type *s_arg, unsigned *argp, int *xreg, int *freg, unsigned int_base)
+{
+    unsigned nf, ni;
+
+    riscv_flat_fields(s_arg, &nf, &ni);
+    p->kind = ni ? FFI_PLACE_GPR_FPR : FFI_PLACE_FPR;
+    p->flags |= FFI_PLACE_FLATTENED;
+    p->fpr = *freg;
+    p->nfpr = nf;
+    p->gpr = (*argp - int_base) / FFI_SIZEOF_ARG;
+    p->ngpr = ni;
+    *freg += nf;
+    *xreg += ni;
+    *argp += ni * FFI_SIZEOF_ARG;
+}
+
+static void riscv_explain_args(ffi_cif *cif, ffi_placement *args, int max_fp_reg_size)
+{
+    unsigned int_base = (max_fp_reg_size != 0) ? 8 * FFI_SIZEOF_ARG : 0;
+    unsigned cap = int_base + 8 * FFI_SIZEOF_ARG;
+    unsigned argp = int_base;
+    int xreg = 0, freg = 0;
+    unsigned int i;
+
+    if (cif->rstruct_flag != 0)
+    {
+        argp += FFI_SIZEOF_ARG;
+        xreg++;
+    }
+
+    for (i = 0; i < cif->nargs; i++)
+    {
+        ffi_type *t = cif->arg_types[i];
+        ffi_placement *p = &args[i];
+        int type = t->type;
+        int variadic = cif->isvariadic && i >= (unsigned) cif->nfixedargs;
+        unsigned a = t->alignment;
+        unsigned z = t->size;
+        unsigned int num_struct_floats = 0;
+        unsigned int num_struct_ints = 0;
+
+        if (a < sizeof(ffi_arg))
+            a = sizeof(ffi_arg);
+        if (variadic)
+            p->flags |= FFI_PLACE_VARIADIC;
+        if (type == FFI_TYPE_STRUCT)
+            struct_float_counter(&num_struct_floats, &num_struct_ints, t, max_fp_reg_size);
+
+        if (z <= sizeof(ffi_arg) && (freg < 8 || xreg < 8))
+        {
+            if (xreg < 8 && ((max_fp_reg_size < 32) || freg > 7 || variadic) && type == FFI_TYPE_FLOAT)
+                type = FFI_TYPE_UINT32;
+            if (xreg < 8 && ((max_fp_reg_size < 64) || freg > 7 || variadic) && type == FFI_TYPE_DOUBLE)
+                type = FFI_TYPE_UINT64;
+
+            if (freg < 8 && (type == FFI_TYPE_FLOAT || type == FFI_TYPE_DOUBLE || num_struct_floats > 0) && !variadic)
+            {
+                if (type == FFI_TYPE_FLOAT || type == FFI_TYPE_DOUBLE)
+                {
+                    p->kind = FFI_PLACE_FPR;
+                    p->fpr = freg++;
+                    p->nfpr = 1;
+                }
+                else if (num_struct_floats == 1
+                         || (num_struct_floats == 2 && max_fp_reg_size != 0 && freg < 7))
+                    riscv_place_flat(p, t, &argp, &xreg, &freg, int_base);
+                /* Otherwise ffi_prep_args stores nothing. */
+            }
+            else
+            {
+                argp = ALIGN(argp, a);
+                riscv_place_int(p, argp, sizeof(ffi_arg), int_base, cap);
+                if (t->type == FFI_TYPE_FLOAT || t->type == FFI_TYPE_DOUBLE)
+                    p->flags |= FFI_PLACE_FP_IN_GPR;
+                if (xreg < 8)
+                    xreg++;
+                argp += sizeof(ffi_arg);
+            }
+        }
+        else if (z <= 2 * sizeof(ffi_arg) && (freg < 8 || xreg < 8))
+        {
+            if (type == FFI_TYPE_STRUCT && max_fp_reg_size != 0
+                && ((num_struct_floats == 2 && num_struct_ints == 0 && freg < 7)
+                    || (num_struct_floats == 1 && num_struct_ints == 1 && freg < 8 && xreg < 8)))
+                riscv_place_flat(p, t, &argp, &xreg, &freg, int_base);
+            else
+            {
+                if (variadic && xreg < 8 && a == 2 * FFI_SIZEOF_ARG && (xreg % 2) == 1)
+                {
+                    xreg += 1;
+                    argp += FFI_SIZEOF_ARG;
+                }
+                if (argp + z <= cap)
+                {
+                    unsigned n = (z + FFI_SIZEOF_ARG - 1) / FFI_SIZEOF_ARG;
+
+                    riscv_place_int(p, argp, z, int_base, cap);
+                    xreg += n;
+                    argp += n * FFI_SIZEOF_ARG;
+                }
+                else if (argp > cap)
+                {
+                    argp = ALIGN(argp, a);
+                    riscv_place_int(p, argp, z, int_base, cap);
+                    argp += z;
+                }
+                else
+                {
+                    riscv_place_int(p, argp, z, int_base, cap);
+                    xreg += (cap - argp + FFI_SIZEOF_ARG - 1) / FFI_SIZEOF_ARG;
+                    argp += z;
+                }
+            }
+        }
+        else if (xreg < 8 && z > 2 * sizeof(ffi_arg))
+        {
+            riscv_place_int(p, argp, sizeof(ffi_arg), int_base, cap);
+            p->flags |= FFI_PLACE_BY_REFERENCE;
+            xreg++;
+            argp += FFI_SIZEOF_ARG;
+        }
+        else
+        {
+            argp = ALIGN(argp, a);
+            riscv_place_int(p, argp, z, int_base, cap);
+            argp += z;
+        }
+    }
+}
+
+ffi_status ffi_explain_machdep(ffi_cif *cif, ffi_placement *rvalue, ffi_placement *args)
+{
+    int max_fp_reg_size = (cif->abi == FFI_RV64_DOUBLE || cif->abi == FFI_RV32_DOUBLE) ? 64 :
+                             ((cif->abi == FFI_RV64_SOFT_FLOAT || cif->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 32);
+    ffi_type *rtype = cif->rtype;
+    unsigned nf, ni;
+
+    switch (rtype->type)
+    {
+        case FFI_TYPE_VOID:
+            break;
+        case FFI_TYPE_STRUCT:
+            if (cif->rstruct_flag != 0)
+            {
+                rvalue->kind = FFI_PLACE_MEMORY;
+                rvalue->ngpr = 1;
+                break;
+            }
+            nf = ni = 0;
+            struct_float_counter(&nf, &ni, rtype, max_fp_reg_size);
+            if (max_fp_reg_size != 0 && nf > 0 && nf + ni <= 2)
+            {
+                rvalue->kind = ni ? FFI_PLACE_GPR_FPR : FFI_PLACE_FPR;
+                rvalue->flags = FFI_PLACE_FLATTENED;
+                rvalue->nfpr = nf;
+                rvalue->ngpr = ni;
+            }
+            else
+            {
+                rvalue->kind = FFI_PLACE_GPR;
+                rvalue->ngpr = (rtype->size + FFI_SIZEOF_ARG - 1) / FFI_SIZEOF_ARG;
+            }
+            break;
+        case FFI_TYPE_FLOAT:
+        case FFI_TYPE_DOUBLE:
+            if (max_fp_reg_size >= (rtype->type == FFI_TYPE_FLOAT ? 32 : 64))
+            {
+                rvalue->kind = FFI_PLACE_FPR;
+                rvalue->nfpr = 1;
+            }
+            else
+            {
+                rvalue->kind = FFI_PLACE_GPR;
+                rvalue->ngpr = 1;
+                rvalue->flags = FFI_PLACE_FP_IN_GPR;
+            }
+            break;
+        case FFI_TYPE_LONGDOUBLE:
+            rvalue->kind = FFI_PLACE_GPR;
+            rvalue->ngpr = 2;
+            break;
+        default:
+            rvalue->kind = FFI_PLACE_GPR;
+            rvalue->ngpr = 1;
+            break;
+    }
+
+    riscv_explain_args(cif, args, max_fp_reg_size);
+    return FFI_OK;
+}
+
 /* Low level routine for calling RV64 functions */
 extern int ffi_call_asm(void (*)(char *, extended_cif *, int, int), 
                          extended_cif *, unsigned, unsigned, 
                          unsigned *, void (*)(void))
                          __attribute__((visibility("hidden")));
 
-void ffi_call(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+#ifdef FFI_PROFILE
+/* Profiled calls take the stamp that ends marshalling from inside
+   ffi_call_asm, once ffi_prep_args has filled in the arguments.  */
+struct profile_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    UINT64 *t;
+};
+
+static void ffi_prep_args_profile(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    ffi_prep_args(stack, ecif, bytes, flags);
+    ((struct profile_ecif *) ecif)->t[1] = ffi_profile_now();
+}
+
+static void ffi_call_profile(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+{
+    struct profile_ecif p;
+    UINT64 t[3];
+
+    t[0] = ffi_profile_now();
+    p.ecif.cif = cif;
+    p.ecif.avalue = avalue;
+    p.t = t;
+
+    if ((rvalue == NULL) && (cif->rtype->type == FFI_TYPE_STRUCT))
+        p.ecif.rvalue = alloca(cif->rtype->size);
+    else
+        p.ecif.rvalue = rvalue;
+
+    ffi_call_asm(ffi_prep_args_profile, &p.ecif, cif->bytes, cif->flags, p.ecif.rvalue, fn);
+    t[2] = ffi_profile_now();
+    ffi_profile_record(cif, FFI_PROFILE_CALL, t);
+}
+#endif
+
+static void ffi_call_int(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
 {
     extended_cif ecif;
 
@@ -889,24 +1223,428 @@ void ffi_call(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
     ffi_call_asm(ffi_prep_args, &ecif, cif->bytes, cif->flags, ecif.rvalue, fn);
 }
 
+void ffi_call(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
+{
+    FFI_STATS_CALL(cif);
+    FFI_OBSERVE(FFI_OBSERVE_CALL_ENTER, cif, fn, rvalue, avalue);
+    if (!FFI_AOT_CALL(cif, fn, rvalue, avalue))
+    {
+#ifdef FFI_PROFILE
+        ffi_call_profile(cif, fn, rvalue, avalue);
+#else
+        ffi_call_int(cif, fn, rvalue, avalue);
+#endif
+    }
+    FFI_OBSERVE(FFI_OBSERVE_CALL_EXIT, cif, fn, rvalue, avalue);
+}
+
+/* Signatures made only of scalars that fit in the argument registers
+   can be marshalled without going through ffi_prep_args: the slot of
+   every argument in the register image is worked out once, and the
+   values are then stored straight into those slots. */
+struct scalar_slot
+{
+    unsigned short type;
+    unsigned short offset;
+};
+
+/* Fill in SLOTS for every argument of CIF, with the same register
+   assignment as ffi_prep_args.  Return 0 if the signature is not
+   made only of register scalars.  On RV32 a 64-bit scalar would take
+   a register pair, which is left to ffi_prep_args. */
+static int riscv_scalar_slots(ffi_cif *cif, struct scalar_slot *slots)
+{
+    unsigned int i;
+    int xreg = 0, freg = 0;
+    int max_fp_reg_size = (cif->abi == FFI_RV64_DOUBLE || cif->abi == FFI_RV32_DOUBLE) ? 64 :
+                             ((cif->abi == FFI_RV64_SOFT_FLOAT || cif->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 32);
+    int int_base = (max_fp_reg_size != 0) ? 8 * FFI_SIZEOF_ARG : 0;
+
+    switch (cif->rtype->type)
+    {
+        case FFI_TYPE_STRUCT:
+        case FFI_TYPE_LONGDOUBLE:
+        case FFI_TYPE_COMPLEX:
+            return 0;
+        default:
+            break;
+    }
+    if (cif->isvariadic)
+        return 0;
+
+    /* The slots are laid out for this XLEN only. */
+#if __riscv_xlen == 64
+    if (cif->abi != FFI_RV64_SINGLE && cif->abi != FFI_RV64_DOUBLE && cif->abi != FFI_RV64_SOFT_FLOAT)
+        return 0;
+#else
+    if (cif->abi != FFI_RV32_SINGLE && cif->abi != FFI_RV32_DOUBLE && cif->abi != FFI_RV32_SOFT_FLOAT)
+        return 0;
+#endif
+
+    for (i = 0; i < cif->nargs; i++)
+    {
+        int type = cif->arg_types[i]->type;
+
+        switch (type)
+        {
+            case FFI_TYPE_FLOAT:
+            case FFI_TYPE_UINT8:
+            case FFI_TYPE_SINT8:
+            case FFI_TYPE_UINT16:
+            case FFI_TYPE_SINT16:
+            case FFI_TYPE_UINT32:
+            case FFI_TYPE_SINT32:
+                break;
+#if __riscv_xlen == 64
+            case FFI_TYPE_DOUBLE:
+            case FFI_TYPE_UINT64:
+            case FFI_TYPE_SINT64:
+                break;
+#endif
+            case FFI_TYPE_INT:
+                type = FFI_TYPE_SINT32;
+                break;
+            /* The size of a pointer depends on the ABI */
+            case FFI_TYPE_POINTER:
+#if __riscv_xlen == 64
+                type = FFI_TYPE_SINT64;
+#else
+                type = FFI_TYPE_SINT32;
+#endif
+                break;
+            default:
+                return 0;
+        }
+
+        if (freg < 8 && ((type == FFI_TYPE_FLOAT && max_fp_reg_size >= 32)
+                         || (type == FFI_TYPE_DOUBLE && max_fp_reg_size >= 64)))
+        {
+            slots[i].offset = freg++ * FFI_SIZEOF_ARG;
+        }
+        else if (xreg < 8)
+        {
+            if (type == FFI_TYPE_FLOAT)
+                type = FFI_TYPE_UINT32;
+            else if (type == FFI_TYPE_DOUBLE)
+                type = FFI_TYPE_UINT64;
+            slots[i].offset = int_base + xreg++ * FFI_SIZEOF_ARG;
+        }
+        else
+            return 0;
+
+        slots[i].type = type;
+    }
+
+    return 1;
+}
+
+/* Store the scalar at A into its slot of the register image STACK. */
+static void riscv_store_scalar(char *stack, const struct scalar_slot *s, const char *a)
+{
+    char *slot = stack + s->offset;
+
+    switch (s->type)
+    {
+        case FFI_TYPE_FLOAT:
+            *(float *) slot = *(float *) a;
+            break;
+        case FFI_TYPE_DOUBLE:
+            *(double *) slot = *(double *) a;
+            break;
+        case FFI_TYPE_SINT8:
+            *(ffi_arg *) slot = *(SINT8 *) a;
+            break;
+        case FFI_TYPE_UINT8:
+            *(ffi_arg *) slot = *(UINT8 *) a;
+            break;
+        case FFI_TYPE_SINT16:
+            *(ffi_arg *) slot = *(SINT16 *) a;
+            break;
+        case FFI_TYPE_UINT16:
+            *(ffi_arg *) slot = *(UINT16 *) a;
+            break;
+        case FFI_TYPE_SINT32:
+            *(ffi_arg *) slot = *(SINT32 *) a;
+            break;
+        case FFI_TYPE_UINT32:
+            *(ffi_arg *) slot = *(UINT32 *) a;
+            break;
+#if __riscv_xlen == 64
+        case FFI_TYPE_SINT64:
+        case FFI_TYPE_UINT64:
+            *(ffi_arg *) slot = *(UINT64 *) a;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/* Columnar calls.  A cut-down ffi_prep_args copies each row straight
+   from the columns into the precomputed slots. */
+struct column_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    struct scalar_slot *slots;
+    char **cur;
+};
+
+static void ffi_prep_column_args(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    struct column_ecif *c = (struct column_ecif *) ecif;
+    unsigned int i;
+
+    for (i = 0; i < ecif->cif->nargs; i++)
+        riscv_store_scalar(stack, &c->slots[i], c->cur[i]);
+}
+
+ffi_status ffi_call_columns_machdep(ffi_cif *cif, void (*fn)(void), size_t nrows, void *rvalue, size_t rstride, void **columns, const size_t *strides)
+{
+    struct column_ecif c;
+    char *rcur = rvalue;
+    ffi_arg tmp;
+    unsigned int i;
+    int widened;
+
+    c.slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    if (!riscv_scalar_slots(cif, c.slots))
+        return FFI_BAD_TYPEDEF;
+
+    c.cur = alloca(cif->nargs * sizeof(char *));
+    for (i = 0; i < cif->nargs; i++)
+        c.cur[i] = columns[i];
+
+    c.ecif.cif = cif;
+    c.ecif.avalue = NULL;
+    widened = rcur == NULL || ffi_column_rvalue_is_widened(cif->rtype);
+
+    while (nrows-- > 0)
+    {
+        /* The assembly stores the result unconditionally, so a scratch
+           word stands in when the caller wants no results. */
+        c.ecif.rvalue = widened ? (void *) &tmp : rcur;
+        ffi_call_asm(ffi_prep_column_args, &c.ecif, cif->bytes, cif->flags, c.ecif.rvalue, fn);
+        if (rcur != NULL)
+        {
+            if (widened)
+                ffi_column_store_rvalue(cif->rtype, rcur, &tmp);
+            rcur += rstride;
+        }
+
+        for (i = 0; i < cif->nargs; i++)
+            c.cur[i] += strides[i];
+    }
+
+    return FFI_OK;
+}
+
+/* Argument frames.  For register scalar signatures the frame keeps the
+   register image that ffi_prep_args would build, and a call only has
+   to copy it onto the stack. */
+struct frame_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    const char *image;
+};
+
+static void ffi_prep_frame_args(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    memcpy(stack, ((struct frame_ecif *) ecif)->image, bytes);
+}
+
+ffi_status ffi_prep_frame_machdep(ffi_frame *frame, void **avalue)
+{
+    ffi_cif *cif = frame->cif;
+    struct scalar_slot *slots;
+    char *image;
+    unsigned int i;
+
+    slots = malloc(cif->nargs * sizeof(struct scalar_slot) + 1);
+    if (slots == NULL)
+        return FFI_BAD_TYPEDEF;
+    if (!riscv_scalar_slots(cif, slots))
+    {
+        free(slots);
+        return FFI_BAD_TYPEDEF;
+    }
+
+    image = calloc(1, ALIGN(cif->bytes, 16));
+    if (image == NULL)
+    {
+        free(slots);
+        return FFI_BAD_TYPEDEF;
+    }
+
+    if (avalue != NULL)
+        for (i = 0; i < cif->nargs; i++)
+            riscv_store_scalar(image, &slots[i], avalue[i]);
+
+    frame->image = image;
+    frame->plan = slots;
+    return FFI_OK;
+}
+
+void ffi_frame_set_arg_machdep(ffi_frame *frame, unsigned n, void *value)
+{
+    riscv_store_scalar(frame->image, &((struct scalar_slot *) frame->plan)[n], value);
+}
+
+void ffi_frame_get_arg_machdep(ffi_frame *frame, unsigned n, void *value)
+{
+    const struct scalar_slot *s = &((struct scalar_slot *) frame->plan)[n];
+
+    /* Slots are little-endian, so the value is at the start. */
+    memcpy(value, (char *) frame->image + s->offset, frame->cif->arg_types[n]->size);
+}
+
+void ffi_frame_call_machdep(ffi_frame *frame, void (*fn)(void), void *rvalue)
+{
+    struct frame_ecif f;
+    ffi_arg tmp;
+
+    f.ecif.cif = frame->cif;
+    f.ecif.avalue = NULL;
+    /* The assembly stores the result unconditionally. */
+    f.ecif.rvalue = rvalue != NULL ? rvalue : (void *) &tmp;
+    f.image = frame->image;
+
+    ffi_call_asm(ffi_prep_frame_args, &f.ecif, frame->cif->bytes, frame->cif->flags, f.ecif.rvalue, fn);
+}
+
+/* Raw calls. In register scalar signatures every argument takes one
+   element of the raw array, and is stored straight into its slot. */
+struct raw_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    struct scalar_slot *slots;
+    ffi_raw *raw;
+};
+
+static void ffi_prep_raw_args(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    struct raw_ecif *p = (struct raw_ecif *) ecif;
+    unsigned int i;
+
+    for (i = 0; i < ecif->cif->nargs; i++)
+        riscv_store_scalar(stack, &p->slots[i], (const char *) &p->raw[i]);
+}
+
+ffi_status ffi_raw_call_machdep(ffi_cif *cif, void (*fn)(void), void *rvalue, ffi_raw *raw)
+{
+    struct raw_ecif p;
+    ffi_arg tmp;
+
+    p.slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    if (!riscv_scalar_slots(cif, p.slots))
+        return FFI_BAD_TYPEDEF;
+
+    p.ecif.cif = cif;
+    p.ecif.avalue = NULL;
+    /* The assembly stores the result unconditionally. */
+    p.ecif.rvalue = rvalue != NULL ? rvalue : (void *) &tmp;
+    p.raw = raw;
+
+    ffi_call_asm(ffi_prep_raw_args, &p.ecif, cif->bytes, cif->flags, p.ecif.rvalue, fn);
+    return FFI_OK;
+}
+
+/* Packed plans and Java raw plans keep the slots of register scalar
+   signatures; each argument is stored straight from its offset in the
+   caller's buffer into its slot. */
+struct plan_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    struct scalar_slot *slots;
+    const size_t *offsets;
+    const char *args;
+};
+
+static void ffi_prep_plan_args(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    struct plan_ecif *p = (struct plan_ecif *) ecif;
+    unsigned int i;
+
+    for (i = 0; i < ecif->cif->nargs; i++)
+        riscv_store_scalar(stack, &p->slots[i], p->args + p->offsets[i]);
+}
+
+static struct scalar_slot *riscv_prep_plan(ffi_cif *cif)
+{
+    struct scalar_slot *slots = malloc(cif->nargs * sizeof(struct scalar_slot) + 1);
+
+    if (slots != NULL && !riscv_scalar_slots(cif, slots))
+    {
+        free(slots);
+        return NULL;
+    }
+    return slots;
+}
+
+static void riscv_call_plan(ffi_cif *cif, struct scalar_slot *slots, const size_t *offsets, void (*fn)(void), void *rvalue, const char *args)
+{
+    struct plan_ecif p;
+    ffi_arg tmp;
+
+    p.ecif.cif = cif;
+    p.ecif.avalue = NULL;
+    /* The assembly stores the result unconditionally. */
+    p.ecif.rvalue = rvalue != NULL ? rvalue : (void *) &tmp;
+    p.slots = slots;
+    p.offsets = offsets;
+    p.args = args;
+
+    ffi_call_asm(ffi_prep_plan_args, &p.ecif, cif->bytes, cif->flags, p.ecif.rvalue, fn);
+}
+
+ffi_status ffi_prep_packed_plan_machdep(ffi_packed_plan *plan)
+{
+    plan->machdep = riscv_prep_plan(plan->cif);
+    return plan->machdep != NULL ? FFI_OK : FFI_BAD_TYPEDEF;
+}
+
+void ffi_packed_plan_call_machdep(ffi_packed_plan *plan, void (*fn)(void), void *rvalue, void *args)
+{
+    riscv_call_plan(plan->cif, plan->machdep, plan->offsets, fn, rvalue, args);
+}
+
+ffi_status ffi_prep_java_raw_plan_machdep(ffi_java_raw_plan *plan)
+{
+    plan->machdep = riscv_prep_plan(plan->cif);
+    return plan->machdep != NULL ? FFI_OK : FFI_BAD_TYPEDEF;
+}
+
+void ffi_java_raw_plan_call_machdep(ffi_java_raw_plan *plan, void (*fn)(void), void *rvalue, ffi_java_raw *raw)
+{
+    riscv_call_plan(plan->cif, plan->machdep, plan->offsets, fn, rvalue, (const char *) raw);
+}
+
 #if FFI_CLOSURES
 
 extern void ffi_closure_asm(void) __attribute__((visibility("hidden")));
 
-ffi_status ffi_prep_closure_loc(ffi_closure *closure, ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *codeloc)
+/* The assembly reaches these by address, see cls_entry in sysv.S. */
+int ffi_closure_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr) __attribute__((visibility("hidden")));
+int ffi_interpose_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr) __attribute__((visibility("hidden")));
+
+/* Point the trampoline of CLOSURE, at CODELOC, to ENTRY. */
+static void riscv_set_closure_entry(ffi_closure *closure, void *codeloc, void (*entry)(void))
 {
     unsigned int *tramp = (unsigned int *) &closure->tramp[0];
     
-    uintptr_t fn = (uintptr_t) ffi_closure_asm;
-    FFI_ASSERT(tramp == codeloc);
-    
-    /* Remove when more than just rv64 is supported */
-    if (!(cif->abi == FFI_RV64_SINGLE || cif->abi == FFI_RV64_DOUBLE))
+    uintptr_t fn = (uintptr_t) entry;
+
+#if FFI_EXEC_STATIC_TRAMP
+    /* Static trampolines load the closure into t0 themselves. */
+    if (ffi_tramp_is_present(codeloc))
     {
-       return FFI_BAD_ABI;
+        ffi_tramp_set_parms(codeloc, entry, closure);
+        return;
     }
+#endif
 
-    if (cif->abi == FFI_RV32_SINGLE || cif->abi == FFI_RV32_DOUBLE || cif->abi == FFI_RV32_SOFT_FLOAT || fn < 0x7ffff000U)
+    FFI_ASSERT(tramp == codeloc);
+
+    if (fn < 0x7ffff000U)
     {
         /* auipc t0, 0 (i.e. t0 <- codeloc) */
         tramp[0] = 0x00000297;
@@ -934,17 +1672,111 @@ ffi_status ffi_prep_closure_loc(ffi_closure *closure, ffi_cif *cif, void (*fun)(
         tramp[5] = fn >> 32;
     }
     
+    __builtin___clear_cache(codeloc, codeloc + FFI_TRAMPOLINE_SIZE);
+}
+
+ffi_status ffi_prep_closure_loc(ffi_closure *closure, ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *codeloc)
+{
+    /* Remove when more than just rv64 is supported */
+    if (!(cif->abi == FFI_RV64_SINGLE || cif->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
     closure->cif = cif;
     closure->fun = fun;
     closure->user_data = user_data;
-    __builtin___clear_cache(codeloc, codeloc + FFI_TRAMPOLINE_SIZE);
+
+    riscv_set_closure_entry(closure, codeloc, ffi_closure_asm);
     
     return FFI_OK;
 }
 
+/*
+* Dense closure arrays. The code is a sequence of blocks, each made of
+* a head followed by up to RISCV_ARRAY_BLOCK entries. An entry is a
+* single "jal t1, head", so that t1 tells ffi_closure_array_asm which
+* entry was taken. The head loads its own address into t0 and jumps to
+* ffi_closure_array_asm, which finds the array and the index of the
+* first entry of the block after the head. RISCV_ARRAY_HEAD must match
+* sysv.S.
+*/
+
+#define RISCV_ARRAY_HEAD 40
+#define RISCV_ARRAY_BLOCK 65536
+#define RISCV_ARRAY_BLOCK_SIZE (RISCV_ARRAY_HEAD + 4 * RISCV_ARRAY_BLOCK)
+
+extern void ffi_closure_array_asm(void) __attribute__((visibility("hidden")));
+
+/* Encode "jal RD, OFFSET". */
+static unsigned int riscv_jal(unsigned int rd, long offset)
+{
+    unsigned long imm = (unsigned long) offset;
+
+    return ((imm & 0x100000) << 11) | ((imm & 0x7fe) << 20)
+           | ((imm & 0x800) << 9) | (imm & 0xff000) | (rd << 7) | 0x6f;
+}
+
+size_t ffi_closure_array_size_machdep(size_t count)
+{
+    size_t blocks = (count + RISCV_ARRAY_BLOCK - 1) / RISCV_ARRAY_BLOCK;
+
+    return blocks * RISCV_ARRAY_HEAD + 4 * count;
+}
+
+void *ffi_closure_array_entry_machdep(ffi_closure_array *array, size_t index)
+{
+    return (char *) array->code + index / RISCV_ARRAY_BLOCK * RISCV_ARRAY_BLOCK_SIZE
+           + RISCV_ARRAY_HEAD + 4 * (index % RISCV_ARRAY_BLOCK);
+}
+
+ffi_status ffi_prep_closure_array_machdep(ffi_closure_array *array)
+{
+    char *code = array->writable;
+    unsigned int *head = NULL;
+    size_t i, j;
+
+    /* Remove when more than just rv64 is supported */
+    if (!(array->cif->abi == FFI_RV64_SINGLE || array->cif->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
+    for (i = 0; i < array->count; i++)
+    {
+        j = i % RISCV_ARRAY_BLOCK;
+        if (j == 0)
+        {
+            head = (unsigned int *) (code + i / RISCV_ARRAY_BLOCK * RISCV_ARRAY_BLOCK_SIZE);
+            /* auipc t0, 0 (i.e. t0 <- head) */
+            head[0] = 0x00000297;
+            /* ld t2, 16(t0) */
+            head[1] = 0x0102b383;
+            /* jalr x0, t2, 0 */
+            head[2] = 0x00038067;
+            /* nop */
+            head[3] = 0x00000013;
+            /* entry point, array and index of the first entry */
+            *(uintptr_t *) &head[4] = (uintptr_t) ffi_closure_array_asm;
+            *(uintptr_t *) &head[6] = (uintptr_t) array;
+            *(uintptr_t *) &head[8] = i;
+        }
+
+        /* jal t1, head */
+        head[RISCV_ARRAY_HEAD / 4 + j] = riscv_jal(6, -(long) (RISCV_ARRAY_HEAD + 4 * j));
+    }
+
+    __builtin___clear_cache(array->code, (char *) array->code
+                            + ffi_closure_array_size_machdep(array->count));
+
+    return FFI_OK;
+}
+
 static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *type, int* argn, int* fargn, unsigned arg_offset, ffi_arg *ar, ffi_arg *fpr, int max_fp_reg_size)
 {
-    ffi_type **elt_typep = type->elements;
+    ffi_type *elt_type;
+    unsigned index = 0;
+    size_t k = 0;
     unsigned o;
     char *tp;
     char *argp;
@@ -956,9 +1788,8 @@ static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *ty
             (num_struct_floats ==1 && num_struct_ints==1 && *argn<8 && *fargn<8) ||
             (num_struct_floats ==1 && num_struct_ints==0 && *fargn<8))
     {
-        while(*elt_typep)
+        while ((elt_type = riscv_next_field(type, &index, &k)))
         {
-            ffi_type *elt_type = *elt_typep;
             o = ALIGN(offset, elt_type->alignment);
             arg_offset += o - offset;
             offset = o;
@@ -989,15 +1820,13 @@ static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *ty
                 *argn += arg_offset / sizeof(ffi_arg);
                 arg_offset = arg_offset % sizeof(ffi_arg);
             }
-            elt_typep++;
         }
         *argn = arg_offset > 0 ? (*argn)+1 : *argn;
     }
     else
     {
-        while(*elt_typep)
+        while ((elt_type = riscv_next_field(type, &index, &k)))
         {
-            ffi_type *elt_type = *elt_typep;
             o = ALIGN(offset, elt_type->alignment);
             arg_offset += o - offset;
             offset = o;
@@ -1019,13 +1848,385 @@ static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *ty
                 *argn += arg_offset / sizeof(ffi_arg);
                 arg_offset = arg_offset % sizeof(ffi_arg);
             }
-            elt_typep++;
         }
         *argn = arg_offset > 0 ? (*argn)+1 : *argn;
     }
 }
 
 
+/*
+* Forwarding closures. When every argument of the target is a scalar
+* passed in a register and the bound ones are in integer registers,
+* the stub moves the integer registers of the incoming arguments up
+* past the bound ones, loads the bound values from the data that
+* follows it and jumps to the target.
+*/
+
+#define RISCV_FORWARD_DATA 80
+#define RISCV_FORWARD_STUB_SIZE (RISCV_FORWARD_DATA + 9 * FFI_SIZEOF_ARG)
+
+ffi_status ffi_prep_forward_closure_machdep(ffi_forward_closure *fwd, void **code)
+{
+    ffi_cif *target = fwd->target;
+    struct scalar_slot *slots, *inslots;
+    int int_base = (target->abi == FFI_RV64_SOFT_FLOAT || target->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 8 * FFI_SIZEOF_ARG;
+    char image[16 * FFI_SIZEOF_ARG];
+    unsigned int *insn, *auipc;
+    char *data;
+    unsigned int i, j, nbound = fwd->nbound;
+
+    /* Remove when more than just rv64 is supported */
+    if (!(target->abi == FFI_RV64_SINGLE || target->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
+    slots = alloca(target->nargs * sizeof(struct scalar_slot));
+    inslots = alloca(fwd->cif.nargs * sizeof(struct scalar_slot));
+    if (!riscv_scalar_slots(target, slots) || !riscv_scalar_slots(&fwd->cif, inslots))
+        return FFI_BAD_TYPEDEF;
+    for (i = 0; i < nbound; i++)
+        if (slots[i].offset < int_base)
+            return FFI_BAD_TYPEDEF;
+
+    insn = fwd->stub = ffi_closure_code_alloc(RISCV_FORWARD_STUB_SIZE, code);
+    if (insn == NULL)
+        return FFI_BAD_TYPEDEF;
+    data = (char *) fwd->stub + RISCV_FORWARD_DATA;
+
+    /* The incoming arguments only move up, so start from the last. */
+    for (i = fwd->cif.nargs; i-- > 0; )
+    {
+        unsigned int src = (inslots[i].offset - int_base) / FFI_SIZEOF_ARG;
+        unsigned int dst = (slots[nbound + i].offset - int_base) / FFI_SIZEOF_ARG;
+
+        /* Floating point registers stay where they are. */
+        if (inslots[i].offset < int_base)
+            continue;
+        /* mv a<dst>, a<src> */
+        *insn++ = ((10 + src) << 15) | ((10 + dst) << 7) | 0x13;
+    }
+
+    /* auipc t0, 0 */
+    auipc = insn;
+    *insn++ = 0x00000297;
+    for (i = 0; i < nbound; i++)
+    {
+        j = (slots[i].offset - int_base) / FFI_SIZEOF_ARG;
+        riscv_store_scalar(image, &slots[i], fwd->bound[i]);
+        memcpy(data + i * FFI_SIZEOF_ARG, image + slots[i].offset, FFI_SIZEOF_ARG);
+        /* ld a<j>, <offset>(t0) */
+        *insn++ = ((data + i * FFI_SIZEOF_ARG - (char *) auipc) << 20) | (5 << 15)
+                  | (3 << 12) | ((10 + j) << 7) | 0x03;
+    }
+    *(uintptr_t *) (data + nbound * FFI_SIZEOF_ARG) = (uintptr_t) fwd->fn;
+    /* ld t1, <offset>(t0) */
+    *insn++ = ((data + nbound * FFI_SIZEOF_ARG - (char *) auipc) << 20) | 0x0002b303;
+    /* jalr x0, t1, 0 */
+    *insn++ = 0x00030067;
+
+    __builtin___clear_cache(*code, (char *) *code + RISCV_FORWARD_STUB_SIZE);
+
+    return FFI_OK;
+}
+
+/*
+* Interposers. For register scalar signatures the closure entry saves
+* the argument registers as usual, and ffi_interpose_riscv_inner copies
+* them straight back into the register image of a call of the target.
+* The plan is the slot of every argument, for the hooks.
+*/
+
+extern void ffi_interpose_asm(void) __attribute__((visibility("hidden")));
+
+struct interpose_ecif
+{
+    extended_cif ecif;  /* must be first, ffi_call_asm hands it back */
+    ffi_arg *ar;
+    ffi_arg *fpr;
+};
+
+static void ffi_prep_interpose_args(char *stack, extended_cif *ecif, int bytes, int flags)
+{
+    struct interpose_ecif *p = (struct interpose_ecif *) ecif;
+    int int_base = (ecif->cif->abi == FFI_RV64_SOFT_FLOAT || ecif->cif->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 8 * FFI_SIZEOF_ARG;
+
+    memcpy(stack, p->fpr, int_base);
+    memcpy(stack + int_base, p->ar, 8 * FFI_SIZEOF_ARG);
+}
+
+ffi_status ffi_prep_interposer_machdep(ffi_interposer *ip, void **code)
+{
+    ffi_cif *cif = ip->cif;
+    struct scalar_slot *slots;
+    ffi_closure *closure;
+
+    /* Remove when more than just rv64 is supported */
+    if (!(cif->abi == FFI_RV64_SINGLE || cif->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
+    slots = ip->plan = malloc(cif->nargs * sizeof(struct scalar_slot) + 1);
+    if (slots == NULL || !riscv_scalar_slots(cif, slots))
+        return FFI_BAD_TYPEDEF;
+
+    closure = ip->closure = ffi_closure_alloc(sizeof(ffi_closure), code);
+    if (closure == NULL)
+        return FFI_BAD_TYPEDEF;
+
+    closure->cif = cif;
+    closure->fun = NULL;
+    closure->user_data = ip;
+    riscv_set_closure_entry(closure, *code, ffi_interpose_asm);
+
+    return FFI_OK;
+}
+
+const void *ffi_interposer_arg_machdep(ffi_interposer_call *call, unsigned n)
+{
+    ffi_cif *cif = call->interposer->cif;
+    const struct scalar_slot *s = &((struct scalar_slot *) call->interposer->plan)[n];
+    int int_base = (cif->abi == FFI_RV64_SOFT_FLOAT || cif->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 8 * FFI_SIZEOF_ARG;
+
+    if (s->offset < int_base)
+        return (char *) call->regs + s->offset;
+    return call->stack + (s->offset - int_base);
+}
+
+/*
+* Runs the hooks of the interposer in USER_DATA around a call of its
+* target with the incoming argument registers AR and FPR, leaving the
+* result in RVALUE. Called from ffi_interpose_asm like
+* ffi_closure_riscv_inner; FUN is unused.
+*/
+int ffi_interpose_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
+{
+    ffi_interposer *ip = user_data;
+    ffi_interposer_call call;
+    struct interpose_ecif p;
+    void **avalue = NULL;
+    unsigned int i;
+
+    call.interposer = ip;
+    call.avalue = NULL;
+    /* The saved integer registers are followed by the stack arguments. */
+    call.regs = fpr;
+    call.stack = (char *) ar;
+    call.scratch = NULL;
+
+    /* Observers see the invocation of the interposer and the call of
+       its target, as with the generic interposer. */
+    if (FFI_OBSERVING())
+    {
+        avalue = alloca(cif->nargs * sizeof(void *) + 1);
+        for (i = 0; i < cif->nargs; i++)
+            avalue[i] = (void *) ffi_interposer_arg_machdep(&call, i);
+        ffi_observe(FFI_OBSERVE_CLOSURE_ENTER, cif, ip->fn, rvalue, avalue);
+    }
+
+    if (ip->pre != NULL)
+        ip->pre(&call, ip->user_data);
+    if (avalue != NULL)
+        ffi_observe(FFI_OBSERVE_CALL_ENTER, cif, ip->fn, rvalue, avalue);
+
+    p.ecif.cif = cif;
+    p.ecif.avalue = NULL;
+    p.ecif.rvalue = rvalue;
+    p.ar = ar;
+    p.fpr = fpr;
+    ffi_call_asm(ffi_prep_interpose_args, &p.ecif, cif->bytes, cif->flags, rvalue, ip->fn);
+
+    if (avalue != NULL)
+        ffi_observe(FFI_OBSERVE_CALL_EXIT, cif, ip->fn, rvalue, avalue);
+    if (ip->post != NULL)
+        ip->post(&call, rvalue, ip->user_data);
+    if (avalue != NULL)
+        ffi_observe(FFI_OBSERVE_CLOSURE_EXIT, cif, ip->fn, rvalue, avalue);
+
+    return cif->flags >> (FFI_FLAG_BITS * 8);
+}
+
+/*
+* Raw closures. For register scalar signatures ffi_raw_closure_asm
+* calls the routine kept in the translate_args field of the closure,
+* which builds the raw array from the saved argument registers. When
+* the arguments are all in consecutive integer registers and need no
+* zero extension, the saved registers already are the raw array.
+*/
+
+extern void ffi_raw_closure_asm(void) __attribute__((visibility("hidden")));
+
+typedef int (*raw_closure_inner)(ffi_cif *, void (*)(ffi_cif*,void*,ffi_raw*,void*), void *, void *, ffi_arg *, ffi_arg *);
+
+/* Point AVALUE at the saved register of every argument, for observers. */
+static void riscv_raw_closure_values(ffi_cif *cif, ffi_arg *ar, ffi_arg *fpr, void **avalue)
+{
+    struct scalar_slot *slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    int int_base = 8 * FFI_SIZEOF_ARG;
+    unsigned int i;
+
+    riscv_scalar_slots(cif, slots);
+    for (i = 0; i < cif->nargs; i++)
+        avalue[i] = slots[i].offset < int_base
+                    ? (char *) fpr + slots[i].offset
+                    : (char *) ar + (slots[i].offset - int_base);
+}
+
+/* Call FUN with RAW, between the observer hooks when there are any. */
+static void riscv_raw_closure_call(ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_raw*,void*), void *user_data, void *rvalue, ffi_raw *raw, ffi_arg *ar, ffi_arg *fpr)
+{
+    void **avalue;
+
+    if (!FFI_OBSERVING())
+    {
+        fun(cif, rvalue, raw, user_data);
+        return;
+    }
+
+    avalue = alloca(cif->nargs * sizeof(void *) + 1);
+    riscv_raw_closure_values(cif, ar, fpr, avalue);
+    ffi_observe(FFI_OBSERVE_CLOSURE_ENTER, cif, FFI_FN(fun), rvalue, avalue);
+    fun(cif, rvalue, raw, user_data);
+    ffi_observe(FFI_OBSERVE_CLOSURE_EXIT, cif, FFI_FN(fun), rvalue, avalue);
+}
+
+static int ffi_raw_closure_riscv_direct(ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_raw*,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
+{
+    riscv_raw_closure_call(cif, fun, user_data, rvalue, (ffi_raw *) ar, ar, fpr);
+    return cif->flags >> (FFI_FLAG_BITS * 8);
+}
+
+static int ffi_raw_closure_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_raw*,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
+{
+    struct scalar_slot *slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    ffi_raw *raw = alloca(cif->nargs * sizeof(ffi_raw));
+    int int_base = 8 * FFI_SIZEOF_ARG;
+    unsigned int i;
+
+    riscv_scalar_slots(cif, slots);
+    for (i = 0; i < cif->nargs; i++)
+    {
+        const char *slot = slots[i].offset < int_base
+                           ? (const char *) fpr + slots[i].offset
+                           : (const char *) ar + (slots[i].offset - int_base);
+
+        /* Registers hold 32-bit values sign-extended. */
+        if (slots[i].type == FFI_TYPE_UINT32)
+            raw[i].uint = *(const UINT32 *) slot;
+        else
+            memcpy(&raw[i], slot, sizeof(ffi_raw));
+    }
+
+    riscv_raw_closure_call(cif, fun, user_data, rvalue, raw, ar, fpr);
+    return cif->flags >> (FFI_FLAG_BITS * 8);
+}
+
+ffi_status ffi_prep_raw_closure_machdep(ffi_raw_closure *cl, ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_raw*,void*), void *user_data, void *codeloc)
+{
+    struct scalar_slot *slots;
+    raw_closure_inner inner = ffi_raw_closure_riscv_direct;
+    int int_base = 8 * FFI_SIZEOF_ARG;
+    unsigned int i;
+
+    /* Remove when more than just rv64 is supported */
+    if (!(cif->abi == FFI_RV64_SINGLE || cif->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
+    slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    if (!riscv_scalar_slots(cif, slots))
+        return FFI_BAD_TYPEDEF;
+    for (i = 0; i < cif->nargs; i++)
+        if (slots[i].offset != int_base + i * FFI_SIZEOF_ARG
+            || slots[i].type == FFI_TYPE_UINT32)
+            inner = ffi_raw_closure_riscv_inner;
+
+    cl->cif = cif;
+    cl->translate_args = (void (*)(ffi_cif*,void*,void**,void*)) inner;
+    cl->this_closure = cl;
+    cl->fun = fun;
+    cl->user_data = user_data;
+
+    riscv_set_closure_entry((ffi_closure *) cl, codeloc, ffi_raw_closure_asm);
+
+    return FFI_OK;
+}
+
+/* Java raw closures work the same way; longs and doubles take a second,
+   unused element of the raw array. */
+
+static int ffi_java_raw_closure_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_raw*,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
+{
+    struct scalar_slot *slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    ffi_java_raw *raw = alloca(2 * cif->nargs * sizeof(ffi_java_raw) + 1);
+    int int_base = 8 * FFI_SIZEOF_ARG;
+    unsigned int i, j;
+
+    riscv_scalar_slots(cif, slots);
+    for (i = j = 0; i < cif->nargs; i++)
+    {
+        const char *slot = slots[i].offset < int_base
+                           ? (const char *) fpr + slots[i].offset
+                           : (const char *) ar + (slots[i].offset - int_base);
+
+        if (slots[i].type == FFI_TYPE_UINT32)
+            raw[j].uint = *(const UINT32 *) slot;
+        else
+            memcpy(&raw[j], slot, sizeof(ffi_java_raw));
+
+        switch (cif->arg_types[i]->type)
+        {
+            case FFI_TYPE_UINT64:
+            case FFI_TYPE_SINT64:
+            case FFI_TYPE_DOUBLE:
+                j += 2;
+                break;
+            default:
+                j++;
+                break;
+        }
+    }
+
+    riscv_raw_closure_call(cif, fun, user_data, rvalue, (ffi_raw *) raw, ar, fpr);
+    return cif->flags >> (FFI_FLAG_BITS * 8);
+}
+
+ffi_status ffi_prep_java_raw_closure_machdep(ffi_java_raw_closure *cl, ffi_cif *cif, void (*fun)(ffi_cif*,void*,ffi_java_raw*,void*), void *user_data, void *codeloc)
+{
+    struct scalar_slot *slots;
+    raw_closure_inner inner = ffi_raw_closure_riscv_direct;
+    int int_base = 8 * FFI_SIZEOF_ARG;
+    unsigned int i;
+
+    /* Remove when more than just rv64 is supported */
+    if (!(cif->abi == FFI_RV64_SINGLE || cif->abi == FFI_RV64_DOUBLE))
+    {
+       return FFI_BAD_ABI;
+    }
+
+    slots = alloca(cif->nargs * sizeof(struct scalar_slot));
+    if (!riscv_scalar_slots(cif, slots))
+        return FFI_BAD_TYPEDEF;
+    for (i = 0; i < cif->nargs; i++)
+        if (slots[i].offset != int_base + i * FFI_SIZEOF_ARG
+            || slots[i].type == FFI_TYPE_UINT32
+            || cif->arg_types[i]->type == FFI_TYPE_UINT64
+            || cif->arg_types[i]->type == FFI_TYPE_SINT64)
+            inner = ffi_java_raw_closure_riscv_inner;
+
+    cl->cif = cif;
+    cl->translate_args = (void (*)(ffi_cif*,void*,void**,void*)) inner;
+    cl->this_closure = cl;
+    cl->fun = fun;
+    cl->user_data = user_data;
+
+    riscv_set_closure_entry((ffi_closure *) cl, codeloc, ffi_raw_closure_asm);
+
+    return FFI_OK;
+}
+
 /*
 * Decodes the arguments to a function, which will be stored on the
 * stack. AR is the pointer to the beginning of the integer
@@ -1033,7 +2234,7 @@ static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *ty
 * registers have been saved.
 *
 * RVALUE is the location where the function return value will be
-* stored. CLOSURE is the prepared closure to invoke.
+* stored. CIF, FUN and USER_DATA are those of the closure to invoke.
 *
 * This function should only be called from assembly, which is in
 * turn called from a trampoline.
@@ -1041,9 +2242,8 @@ static void copy_struct(char *target, unsigned offset, ffi_abi abi, ffi_type *ty
 * Returns the function return flags.
 *
 */
-int ffi_closure_riscv_inner(ffi_closure *closure, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
+int ffi_closure_riscv_inner(ffi_cif *cif, void (*fun)(ffi_cif*,void*,void**,void*), void *user_data, void *rvalue, ffi_arg *ar, ffi_arg *fpr)
 {
-    ffi_cif *cif;
     void **avaluep;
     ffi_arg *avalue;
     ffi_type **arg_types;
@@ -1052,13 +2252,16 @@ int ffi_closure_riscv_inner(ffi_closure *closure, void *rvalue, ffi_arg *ar, ffi
     ffi_arg *argp;
     ffi_arg *fargp;
     size_t z;
+    FFI_PROFILE_DECL
     
-    cif = closure->cif;
     unsigned int max_fp_reg_size = (cif->abi == FFI_RV64_DOUBLE || cif->abi == FFI_RV32_DOUBLE) ? 64 : 
                              ((cif->abi == FFI_RV64_SOFT_FLOAT || cif->abi == FFI_RV32_SOFT_FLOAT) ? 0 : 32); 
     //this can be expanded to 128 for QUAD if needed
     
 
+    FFI_PROFILE_STAMP(0);
+    FFI_STATS_CLOSURE_CALL(cif);
+
     avalue = alloca(cif->nargs * sizeof (ffi_arg));
     avaluep = alloca(cif->nargs * sizeof (ffi_arg));
     argn = 0;
@@ -1210,7 +2413,12 @@ int ffi_closure_riscv_inner(ffi_closure *closure, void *rvalue, ffi_arg *ar, ffi
     }
    
     /* Invoke the closure. */
-    (closure->fun) (cif, rvalue, avaluep, closure->user_data);
+    FFI_OBSERVE(FFI_OBSERVE_CLOSURE_ENTER, cif, FFI_FN(fun), rvalue, avaluep);
+    FFI_PROFILE_STAMP(1);
+    fun (cif, rvalue, avaluep, user_data);
+    FFI_PROFILE_STAMP(2);
+    FFI_OBSERVE(FFI_OBSERVE_CLOSURE_EXIT, cif, FFI_FN(fun), rvalue, avaluep);
+    FFI_PROFILE_RECORD(cif, FFI_PROFILE_CLOSURE);
     return cif->flags >> (FFI_FLAG_BITS * 8);
 }
 
@@ -141,6 +141,22 @@ typedef enum ffi_abi {
 #define FFI_NATIVE_RAW_API 0
 #define FFI_EXTRA_CIF_FIELDS unsigned rstruct_flag; char isvariadic; int nfixedargs
 #define FFI_TARGET_SPECIFIC_VARIADIC 1
+#define FFI_TARGET_HAS_COLUMN_CALL
+#define FFI_TARGET_HAS_FRAMES
+#define FFI_TARGET_HAS_PACKED_CALL
+#define FFI_TARGET_HAS_CLOSURE_ARRAY
+#define FFI_TARGET_HAS_FORWARD_CLOSURE
+#define FFI_TARGET_HAS_INTERPOSER
+#define FFI_TARGET_HAS_RAW_CALL
+#define FFI_TARGET_HAS_JAVA_RAW_PLAN
+#define FFI_TARGET_HAS_EXPLAIN
+#define FFI_TARGET_HAS_ARRAY_TYPE
+
+/* On Linux, closure trampolines come from prebuilt pages in the text
+   segment; see closures.c. */
+#if defined(__linux__) && !defined(__ANDROID__)
+#define FFI_EXEC_STATIC_TRAMP 1
+#endif
 
 #endif
 
@@ -0,0 +1,269 @@
+/* -----------------------------------------------------------------------
+   stats.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file keeps the counters behind ffi_get_stats, compiled in with
+   --enable-stats.  Every thread counts into a block of its own, which
+   only that thread writes, so the hooks in the call and closure paths
+   take no lock and share no cache line.  The blocks are summed when
+   the statistics are read; a thread that exits first adds its block
+   to a common total.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FFI_STATS
+
+struct ffi_stats_block
+{
+  size_t counts[FFI_STATS_NCOUNTERS];
+  struct ffi_stats_block *next, **prevp;
+};
+
+/* Counts of exited threads, and counts made when a thread could not
+   get a block of its own.  */
+static struct ffi_stats_block ffi_stats_retired;
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+static pthread_mutex_t ffi_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ffi_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ffi_stats_key;
+static int ffi_stats_key_ok;
+
+/* The blocks of live threads.  */
+static struct ffi_stats_block *ffi_stats_blocks;
+
+/* Fold the block of an exiting thread into ffi_stats_retired.  */
+static void
+ffi_stats_block_destroy (void *arg)
+{
+  struct ffi_stats_block *b = arg;
+  unsigned i;
+
+  pthread_mutex_lock (&ffi_stats_lock);
+  for (i = 0; i < FFI_STATS_NCOUNTERS; i++)
+    __atomic_fetch_add (&ffi_stats_retired.counts[i], b->counts[i],
+			__ATOMIC_RELAXED);
+  *b->prevp = b->next;
+  if (b->next)
+    b->next->prevp = b->prevp;
+  pthread_mutex_unlock (&ffi_stats_lock);
+  free (b);
+}
+
+static void
+ffi_stats_init (void)
+{
+  __atomic_store_n (&ffi_stats_key_ok,
+		    pthread_key_create (&ffi_stats_key,
+					ffi_stats_block_destroy) == 0,
+		    __ATOMIC_RELEASE);
+}
+
+#ifdef __GNUC__
+/* When libffi is unloaded, delete the key, so that threads exiting
+   afterwards do not run ffi_stats_block_destroy from unmapped code.
+   This also runs from exit while other threads may still be counting
+   into their blocks, so the blocks are left where they are.  */
+static void __attribute__ ((destructor))
+ffi_stats_fini (void)
+{
+  if (__atomic_exchange_n (&ffi_stats_key_ok, 0, __ATOMIC_ACQ_REL))
+    pthread_key_delete (ffi_stats_key);
+}
+#endif
+
+/* Return the block of the calling thread, creating it if need be, or
+   NULL if there is none.  */
+static struct ffi_stats_block *
+ffi_stats_block_get (void)
+{
+  struct ffi_stats_block *b;
+
+  pthread_once (&ffi_stats_once, ffi_stats_init);
+  if (!__atomic_load_n (&ffi_stats_key_ok, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  b = pthread_getspecific (ffi_stats_key);
+  if (LIKELY (b != NULL))
+    return b;
+
+  b = calloc (1, sizeof (struct ffi_stats_block));
+  if (!b)
+    return NULL;
+  if (pthread_setspecific (ffi_stats_key, b))
+    {
+      free (b);
+      return NULL;
+    }
+
+  pthread_mutex_lock (&ffi_stats_lock);
+  b->next = ffi_stats_blocks;
+  if (b->next)
+    b->next->prevp = &b->next;
+  b->prevp = &ffi_stats_blocks;
+  ffi_stats_blocks = b;
+  pthread_mutex_unlock (&ffi_stats_lock);
+
+  return b;
+}
+
+#define ffi_stats_read_lock() pthread_mutex_lock (&ffi_stats_lock)
+#define ffi_stats_read_unlock() pthread_mutex_unlock (&ffi_stats_lock)
+
+#else /* !HAVE_PTHREAD_H */
+
+static struct ffi_stats_block *ffi_stats_blocks;
+
+static struct ffi_stats_block *
+ffi_stats_block_get (void)
+{
+  return NULL;
+}
+
+#define ffi_stats_read_lock() ((void) 0)
+#define ffi_stats_read_unlock() ((void) 0)
+
+#endif /* HAVE_PTHREAD_H */
+
+/* Add N to COUNTER in block B.  Only the owner of a block writes it,
+   so a plain load and store are enough; they are atomic so that
+   readers never see a torn value.  Counts without a block go to
+   ffi_stats_retired, which needs a real atomic add.  */
+static inline void
+ffi_stats_block_add (struct ffi_stats_block *b, int counter, size_t n)
+{
+  if (LIKELY (b != NULL))
+    __atomic_store_n (&b->counts[counter],
+		      __atomic_load_n (&b->counts[counter], __ATOMIC_RELAXED)
+		      + n, __ATOMIC_RELAXED);
+  else
+    __atomic_fetch_add (&ffi_stats_retired.counts[counter], n,
+			__ATOMIC_RELAXED);
+}
+
+void
+ffi_stats_add (int counter, size_t n)
+{
+  ffi_stats_block_add (ffi_stats_block_get (), counter, n);
+}
+
+/* Count the arguments and return value of CIF as marshalled.  */
+static void
+ffi_stats_marshal (struct ffi_stats_block *b, ffi_cif *cif)
+{
+  size_t bytes = 0, copies = 0;
+  unsigned i;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      bytes += cif->arg_types[i]->size;
+      copies += cif->arg_types[i]->type == FFI_TYPE_STRUCT;
+    }
+  if (cif->rtype->type != FFI_TYPE_VOID)
+    {
+      bytes += cif->rtype->size;
+      copies += cif->rtype->type == FFI_TYPE_STRUCT;
+    }
+
+  ffi_stats_block_add (b, FFI_STATS_BYTES_MARSHALLED, bytes);
+  if (copies)
+    ffi_stats_block_add (b, FFI_STATS_STRUCT_COPIES, copies);
+}
+
+void
+ffi_stats_call (ffi_cif *cif)
+{
+  struct ffi_stats_block *b = ffi_stats_block_get ();
+
+  ffi_stats_block_add (b, FFI_STATS_CALLS, 1);
+  ffi_stats_block_add (b, FFI_STATS_STACK_BYTES, cif->bytes);
+  ffi_stats_marshal (b, cif);
+}
+
+void
+ffi_stats_closure_call (ffi_cif *cif)
+{
+  struct ffi_stats_block *b = ffi_stats_block_get ();
+
+  ffi_stats_block_add (b, FFI_STATS_CLOSURE_CALLS, 1);
+  ffi_stats_marshal (b, cif);
+}
+
+/* The difference of two counters that only grow; while other threads
+   run, a read can see the decrement before the increment.  */
+static size_t
+ffi_stats_diff (const size_t *counts, int up, int down)
+{
+  return counts[up] > counts[down] ? counts[up] - counts[down] : 0;
+}
+
+ffi_status
+ffi_get_stats (ffi_stats *stats)
+{
+  size_t counts[FFI_STATS_NCOUNTERS];
+  struct ffi_stats_block *b;
+  unsigned i;
+
+  if (stats == NULL)
+    return FFI_BAD_TYPEDEF;
+
+  ffi_stats_read_lock ();
+  for (i = 0; i < FFI_STATS_NCOUNTERS; i++)
+    counts[i] = __atomic_load_n (&ffi_stats_retired.counts[i],
+				 __ATOMIC_RELAXED);
+  for (b = ffi_stats_blocks; b; b = b->next)
+    for (i = 0; i < FFI_STATS_NCOUNTERS; i++)
+      counts[i] += __atomic_load_n (&b->counts[i], __ATOMIC_RELAXED);
+  ffi_stats_read_unlock ();
+
+  stats->calls = counts[FFI_STATS_CALLS];
+  stats->closure_calls = counts[FFI_STATS_CLOSURE_CALLS];
+  stats->bytes_marshalled = counts[FFI_STATS_BYTES_MARSHALLED];
+  stats->struct_copies = counts[FFI_STATS_STRUCT_COPIES];
+  stats->stack_bytes = counts[FFI_STATS_STACK_BYTES];
+  stats->closures_live = ffi_stats_diff (counts, FFI_STATS_CLOSURE_ALLOCS,
+					 FFI_STATS_CLOSURE_FREES);
+  stats->exec_bytes = ffi_stats_diff (counts, FFI_STATS_EXEC_MAPPED,
+				      FFI_STATS_EXEC_UNMAPPED);
+  return FFI_OK;
+}
+
+#else /* !FFI_STATS */
+
+/* Statistics were not configured in.  */
+
+ffi_status
+ffi_get_stats (ffi_stats *stats)
+{
+  if (stats != NULL)
+    memset (stats, 0, sizeof (ffi_stats));
+  return FFI_BAD_ABI;
+}
+
+#endif /* FFI_STATS */
@@ -0,0 +1,727 @@
+/* -----------------------------------------------------------------------
+   trace.c - Copyright (c) 2019  The libffi-riscv authors
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   ``Software''), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED ``AS IS'', WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+   HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+   WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ----------------------------------------------------------------------- */
+
+/* This file records every call and closure invocation to a trace
+   file, and loads such a file to make the same calls again against
+   stub callees.  Recording is an observer, see observer.c.
+
+   A trace starts with the eight bytes "FFITRACE" and a version number,
+   followed by records that each start with a tag byte.  Integers are
+   stored little endian.
+
+     signature:  1, u32 hash, u8 abi, u16 nargs, rtype, arg types...
+     call:       2, u32 hash, u32 nbytes, argument bytes
+     closure:    3, u32 hash, u32 nbytes, argument bytes
+
+   A type is its FFI_TYPE_ code; a structure code is followed by a u16
+   count and the element types, a complex code by its element type.  An
+   array is 255, a u32 count and the element type.
+   The hash is the FNV-1a hash of the encoded abi, nargs and types, and
+   the signature record comes before the first event that uses it.  The
+   argument bytes, laid out as by ffi_packed_offsets, are only recorded
+   with FFI_TRACE_ARGS and for signatures without pointers.  */
+
+#include <ffi.h>
+#include <ffi_common.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+static pthread_mutex_t ffi_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+#define ffi_trace_lock() pthread_mutex_lock (&ffi_trace_lock)
+#define ffi_trace_unlock() pthread_mutex_unlock (&ffi_trace_lock)
+#else
+#define ffi_trace_lock() ((void) 0)
+#define ffi_trace_unlock() ((void) 0)
+#endif
+
+#define FFI_TRACE_MAGIC "FFITRACE"
+#define FFI_TRACE_VERSION 1
+
+enum
+{
+  FFI_TRACE_SIGNATURE = 1,
+  FFI_TRACE_CALL,
+  FFI_TRACE_CLOSURE
+};
+
+/* The code of an array, whose FFI_TYPE_ARRAY does not fit a byte.  */
+#define FFI_TRACE_ARRAY 0xff
+
+/* The largest encoded signature and the deepest nesting of types.  */
+#define FFI_TRACE_SIG_MAX 512
+#define FFI_TRACE_DEPTH 16
+
+/* How many signature hashes a recording remembers; past that,
+   signatures are written again before each of their events.  */
+#define FFI_TRACE_SEEN 4096
+
+static FILE *ffi_trace_file;
+static unsigned ffi_trace_flags;
+static ffi_observer *ffi_trace_observer;
+static uint32_t *ffi_trace_seen;
+
+static void
+ffi_trace_put32 (unsigned char *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t
+ffi_trace_get32 (const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16)
+    | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t
+ffi_trace_hash (const unsigned char *p, size_t n)
+{
+  uint32_t h = 2166136261u;
+
+  while (n--)
+    h = (h ^ *p++) * 16777619u;
+  return h ? h : 1;
+}
+
+/* Append the encoding of T at *POS in BUF.  Return zero if it does not
+   fit; clear *POINTER_FREE if T holds a pointer.  */
+static int
+ffi_trace_encode_type (unsigned char *buf, size_t *pos, ffi_type *t,
+		       int *pointer_free, int depth)
+{
+  ffi_type **e;
+  size_t n;
+
+  if (*pos + 5 > FFI_TRACE_SIG_MAX || depth > FFI_TRACE_DEPTH)
+    return 0;
+  buf[(*pos)++] = t->type == FFI_TYPE_ARRAY ? FFI_TRACE_ARRAY : t->type;
+  switch (t->type)
+    {
+    case FFI_TYPE_ARRAY:
+      if (FFI_ARRAY_COUNT (t) > 0xffffffff)
+	return 0;
+      ffi_trace_put32 (buf + *pos, FFI_ARRAY_COUNT (t));
+      *pos += 4;
+      return ffi_trace_encode_type (buf, pos, t->elements[0], pointer_free,
+				    depth + 1);
+    case FFI_TYPE_POINTER:
+      *pointer_free = 0;
+      break;
+    case FFI_TYPE_STRUCT:
+      for (n = 0; t->elements[n]; n++)
+	;
+      if (n > 0xffff)
+	return 0;
+      buf[(*pos)++] = n;
+      buf[(*pos)++] = n >> 8;
+      for (e = t->elements; *e; e++)
+	if (!ffi_trace_encode_type (buf, pos, *e, pointer_free, depth + 1))
+	  return 0;
+      break;
+    case FFI_TYPE_COMPLEX:
+      return ffi_trace_encode_type (buf, pos, t->elements[0], pointer_free,
+				    depth + 1);
+    }
+  return 1;
+}
+
+static int
+ffi_trace_encode (unsigned char *buf, size_t *pos, ffi_cif *cif,
+		  int *pointer_free)
+{
+  unsigned i;
+
+  buf[0] = cif->abi;
+  buf[1] = cif->nargs;
+  buf[2] = cif->nargs >> 8;
+  *pos = 3;
+  if (cif->nargs > 0xffff
+      || !ffi_trace_encode_type (buf, pos, cif->rtype, pointer_free, 0))
+    return 0;
+  for (i = 0; i < cif->nargs; i++)
+    if (!ffi_trace_encode_type (buf, pos, cif->arg_types[i], pointer_free,
+				0))
+      return 0;
+  return 1;
+}
+
+/* Return nonzero if HASH was already written, and remember it.  Called
+   with the lock held.  */
+static int
+ffi_trace_was_seen (uint32_t hash)
+{
+  unsigned i, slot;
+
+  for (i = 0; i < FFI_TRACE_SEEN; i++)
+    {
+      slot = (hash + i) & (FFI_TRACE_SEEN - 1);
+      if (ffi_trace_seen[slot] == hash)
+	return 1;
+      if (ffi_trace_seen[slot] == 0)
+	{
+	  ffi_trace_seen[slot] = hash;
+	  return 0;
+	}
+    }
+  return 0;
+}
+
+static void
+ffi_trace_observe (ffi_observe_event event, ffi_cif *cif,
+		   void (*fn)(void), void *rvalue, void **avalue,
+		   void *user_data)
+{
+  unsigned char sig[FFI_TRACE_SIG_MAX], head[9];
+  unsigned char *args = NULL;
+  size_t len, bytes = 0, *offsets;
+  int pointer_free = 1;
+  uint32_t hash;
+  unsigned i;
+
+  if (event != FFI_OBSERVE_CALL_ENTER && event != FFI_OBSERVE_CLOSURE_ENTER)
+    return;
+  if (!ffi_trace_encode (sig, &len, cif, &pointer_free))
+    return;
+  hash = ffi_trace_hash (sig, len);
+
+  if ((ffi_trace_flags & FFI_TRACE_ARGS) && pointer_free)
+    {
+      bytes = ffi_packed_size (cif);
+      args = alloca (bytes);
+      offsets = alloca (cif->nargs * sizeof (size_t));
+      ffi_packed_offsets (cif, offsets);
+      memset (args, 0, bytes);
+      for (i = 0; i < cif->nargs; i++)
+	memcpy (args + offsets[i], avalue[i], cif->arg_types[i]->size);
+    }
+
+  ffi_trace_lock ();
+  if (ffi_trace_file != NULL)
+    {
+      if (!ffi_trace_was_seen (hash))
+	{
+	  head[0] = FFI_TRACE_SIGNATURE;
+	  ffi_trace_put32 (head + 1, hash);
+	  fwrite (head, 1, 5, ffi_trace_file);
+	  fwrite (sig, 1, len, ffi_trace_file);
+	}
+      head[0] = (event == FFI_OBSERVE_CALL_ENTER
+		 ? FFI_TRACE_CALL : FFI_TRACE_CLOSURE);
+      ffi_trace_put32 (head + 1, hash);
+      ffi_trace_put32 (head + 5, bytes);
+      fwrite (head, 1, 9, ffi_trace_file);
+      if (bytes)
+	fwrite (args, 1, bytes, ffi_trace_file);
+    }
+  ffi_trace_unlock ();
+}
+
+ffi_status
+ffi_trace_start (const char *path, unsigned int flags)
+{
+  unsigned char head[12];
+  ffi_status status = FFI_OK;
+
+  ffi_trace_lock ();
+  if (ffi_trace_file != NULL)
+    status = FFI_BAD_ABI;
+  else if ((ffi_trace_seen = calloc (FFI_TRACE_SEEN, sizeof (uint32_t)))
+	   == NULL
+	   || (ffi_trace_file = fopen (path, "wb")) == NULL)
+    status = FFI_BAD_TYPEDEF;
+  else
+    {
+      memcpy (head, FFI_TRACE_MAGIC, 8);
+      ffi_trace_put32 (head + 8, FFI_TRACE_VERSION);
+      fwrite (head, 1, sizeof (head), ffi_trace_file);
+      ffi_trace_flags = flags;
+    }
+  if (status == FFI_BAD_TYPEDEF)
+    {
+      free (ffi_trace_seen);
+      ffi_trace_seen = NULL;
+    }
+  ffi_trace_unlock ();
+
+  if (status == FFI_OK)
+    {
+      ffi_trace_observer = ffi_observer_add (ffi_trace_observe, NULL);
+      if (ffi_trace_observer == NULL)
+	{
+	  ffi_trace_stop ();
+	  status = FFI_BAD_TYPEDEF;
+	}
+    }
+  return status;
+}
+
+ffi_status
+ffi_trace_stop (void)
+{
+  ffi_status status = FFI_OK;
+
+  if (ffi_trace_observer != NULL)
+    {
+      ffi_observer_remove (ffi_trace_observer);
+      ffi_trace_observer = NULL;
+    }
+
+  ffi_trace_lock ();
+  if (ffi_trace_file == NULL)
+    status = FFI_BAD_ABI;
+  else
+    {
+      if (ferror (ffi_trace_file) | fclose (ffi_trace_file))
+	status = FFI_BAD_TYPEDEF;
+      ffi_trace_file = NULL;
+      free (ffi_trace_seen);
+      ffi_trace_seen = NULL;
+    }
+  ffi_trace_unlock ();
+  return status;
+}
+
+/* Replaying.  Every signature gets a cif, zeroed arguments and a
+   closure made on first use; every event keeps its argument bytes, if
+   any, in one buffer aligned for any type.  */
+
+struct ffi_trace_sig
+{
+  uint32_t hash;
+  ffi_cif cif;
+  ffi_type **arg_types;
+  size_t *offsets;
+  void **avalue;		/* Pointers into the arguments of an event.  */
+  void **zero_avalue;		/* Pointers into ZEROS.  */
+  void *zeros;
+  void *rvalue;
+#if FFI_CLOSURES
+  ffi_closure *closure;
+#endif
+  void *code;			/* The closure, for closure events.  */
+};
+
+struct ffi_trace_event
+{
+  size_t sig;
+  int closure;
+  size_t args;			/* Offset in BYTES, or -1.  */
+};
+
+struct ffi_trace
+{
+  struct ffi_trace_sig *sigs;
+  size_t nsigs;
+  struct ffi_trace_event *events;
+  size_t nevents;
+  char *bytes;
+};
+
+#define FFI_TRACE_ALIGN 16
+
+static void
+ffi_trace_stub (void)
+{
+}
+
+#if FFI_CLOSURES
+static void
+ffi_trace_handler (ffi_cif *cif, void *rvalue, void **avalue,
+		   void *user_data)
+{
+  if (cif->rtype->type != FFI_TYPE_VOID)
+    memset (rvalue, 0, cif->rtype->size);
+}
+#endif
+
+static void
+ffi_trace_free_type (ffi_type *t)
+{
+  ffi_type **e;
+
+  if (t == NULL
+      || (t->type != FFI_TYPE_STRUCT && t->type != FFI_TYPE_ARRAY))
+    return;
+  for (e = t->elements; *e; e++)
+    ffi_trace_free_type (*e);
+  free (t);
+}
+
+static ffi_type *
+ffi_trace_decode_type (const unsigned char **p, const unsigned char *end,
+		       int depth)
+{
+  ffi_type *t, *e;
+  ffi_array_type *a;
+  unsigned n, i;
+
+  if (*p >= end || depth > FFI_TRACE_DEPTH)
+    return NULL;
+  switch (*(*p)++)
+    {
+    case FFI_TYPE_VOID:
+      return &ffi_type_void;
+    case FFI_TYPE_INT:
+      return &ffi_type_sint;
+    case FFI_TYPE_FLOAT:
+      return &ffi_type_float;
+    case FFI_TYPE_DOUBLE:
+      return &ffi_type_double;
+#if FFI_TYPE_LONGDOUBLE != FFI_TYPE_DOUBLE
+    case FFI_TYPE_LONGDOUBLE:
+      return &ffi_type_longdouble;
+#endif
+    case FFI_TYPE_UINT8:
+      return &ffi_type_uint8;
+    case FFI_TYPE_SINT8:
+      return &ffi_type_sint8;
+    case FFI_TYPE_UINT16:
+      return &ffi_type_uint16;
+    case FFI_TYPE_SINT16:
+      return &ffi_type_sint16;
+    case FFI_TYPE_UINT32:
+      return &ffi_type_uint32;
+    case FFI_TYPE_SINT32:
+      return &ffi_type_sint32;
+    case FFI_TYPE_UINT64:
+      return &ffi_type_uint64;
+    case FFI_TYPE_SINT64:
+      return &ffi_type_sint64;
+    case FFI_TYPE_POINTER:
+      return &ffi_type_pointer;
+    case FFI_TYPE_STRUCT:
+      if (end - *p < 2)
+	return NULL;
+      n = (*p)[0] | ((*p)[1] << 8);
+      *p += 2;
+      t = calloc (1, sizeof (ffi_type) + (n + 1) * sizeof (ffi_type *));
+      if (t == NULL)
+	return NULL;
+      t->type = FFI_TYPE_STRUCT;
+      t->elements = (ffi_type **) (t + 1);
+      for (i = 0; i < n; i++)
+	if ((t->elements[i] = ffi_trace_decode_type (p, end, depth + 1))
+	    == NULL)
+	  {
+	    ffi_trace_free_type (t);
+	    return NULL;
+	  }
+      return t;
+    case FFI_TRACE_ARRAY:
+      if (end - *p < 4)
+	return NULL;
+      n = ffi_trace_get32 (*p);
+      *p += 4;
+      e = ffi_trace_decode_type (p, end, depth + 1);
+      a = malloc (sizeof (*a));
+      if (e == NULL || a == NULL || ffi_prep_array_type (a, e, n) != FFI_OK)
+	{
+	  ffi_trace_free_type (e);
+	  free (a);
+	  return NULL;
+	}
+      return &a->type;
+#ifdef FFI_TARGET_HAS_COMPLEX_TYPE
+    case FFI_TYPE_COMPLEX:
+      e = ffi_trace_decode_type (p, end, depth + 1);
+      if (e == &ffi_type_float)
+	return &ffi_type_complex_float;
+      if (e == &ffi_type_double)
+	return &ffi_type_complex_double;
+#if FFI_TYPE_LONGDOUBLE != FFI_TYPE_DOUBLE
+      if (e == &ffi_type_longdouble)
+	return &ffi_type_complex_longdouble;
+#endif
+      ffi_trace_free_type (e);
+      return NULL;
+#endif
+    default:
+      return NULL;
+    }
+}
+
+static void
+ffi_trace_free_sig (struct ffi_trace_sig *s)
+{
+  unsigned i;
+
+#if FFI_CLOSURES
+  if (s->closure != NULL)
+    ffi_closure_free (s->closure);
+#endif
+  ffi_trace_free_type (s->cif.rtype);
+  if (s->arg_types != NULL)
+    for (i = 0; i < s->cif.nargs; i++)
+      ffi_trace_free_type (s->arg_types[i]);
+  free (s->arg_types);
+  free (s->offsets);
+  free (s->avalue);
+  free (s->zero_avalue);
+  free (s->zeros);
+  free (s->rvalue);
+}
+
+/* Decode the signature at *P into S.  Return zero if it is malformed
+   or cannot be prepared.  */
+static int
+ffi_trace_decode_sig (struct ffi_trace_sig *s, const unsigned char **p,
+		      const unsigned char *end)
+{
+  ffi_type *rtype;
+  unsigned abi, nargs, i;
+  size_t bytes;
+
+  memset (s, 0, sizeof (*s));
+  if (end - *p < 3)
+    return 0;
+  abi = (*p)[0];
+  nargs = (*p)[1] | ((*p)[2] << 8);
+  *p += 3;
+
+  rtype = ffi_trace_decode_type (p, end, 0);
+  s->arg_types = calloc (nargs + 1, sizeof (ffi_type *));
+  s->offsets = calloc (nargs + 1, sizeof (size_t));
+  s->avalue = calloc (nargs + 1, sizeof (void *));
+  s->zero_avalue = calloc (nargs + 1, sizeof (void *));
+  /* Keep S->cif describing what has to be freed.  */
+  s->cif.rtype = rtype;
+  if (rtype == NULL || s->arg_types == NULL || s->offsets == NULL
+      || s->avalue == NULL || s->zero_avalue == NULL)
+    return 0;
+  for (i = 0; i < nargs; i++)
+    {
+      s->cif.nargs = i;
+      if ((s->arg_types[i] = ffi_trace_decode_type (p, end, 0)) == NULL)
+	return 0;
+    }
+  s->cif.nargs = nargs;
+
+  if (ffi_prep_cif (&s->cif, abi, nargs, rtype, s->arg_types) != FFI_OK)
+    return 0;
+
+  bytes = ffi_packed_size (&s->cif);
+  s->zeros = calloc (1, bytes + FFI_TRACE_ALIGN);
+  s->rvalue = calloc (1, rtype->size + sizeof (ffi_arg) + FFI_TRACE_ALIGN);
+  if (s->zeros == NULL || s->rvalue == NULL)
+    return 0;
+  ffi_packed_offsets (&s->cif, s->offsets);
+  for (i = 0; i < nargs; i++)
+    s->zero_avalue[i] = (char *) s->zeros + s->offsets[i];
+  return 1;
+}
+
+void
+ffi_trace_free (ffi_trace *trace)
+{
+  size_t i;
+
+  if (trace == NULL)
+    return;
+  for (i = 0; i < trace->nsigs; i++)
+    ffi_trace_free_sig (&trace->sigs[i]);
+  free (trace->sigs);
+  free (trace->events);
+  free (trace->bytes);
+  free (trace);
+}
+
+/* Parse the N bytes of a trace at DATA into TRACE.  */
+static int
+ffi_trace_parse (ffi_trace *trace, const unsigned char *data, size_t n)
+{
+  const unsigned char *p = data + 12, *end = data + n;
+  size_t sigs_size = 0, events_size = 0, bytes_size = 0, bytes_used = 0;
+  size_t i, last = 0;
+
+  if (n < 12 || memcmp (data, FFI_TRACE_MAGIC, 8) != 0
+      || ffi_trace_get32 (data + 8) != FFI_TRACE_VERSION)
+    return 0;
+
+  while (p < end)
+    {
+      int tag = *p++;
+      uint32_t hash, nbytes;
+      struct ffi_trace_event *e;
+      struct ffi_trace_sig *s;
+
+      if (end - p < 4)
+	return 0;
+      hash = ffi_trace_get32 (p);
+      p += 4;
+
+      if (tag == FFI_TRACE_SIGNATURE)
+	{
+	  if (trace->nsigs == sigs_size)
+	    {
+	      sigs_size = sigs_size ? 2 * sigs_size : 16;
+	      s = realloc (trace->sigs, sigs_size * sizeof (*s));
+	      if (s == NULL)
+		return 0;
+	      trace->sigs = s;
+	    }
+	  s = &trace->sigs[trace->nsigs];
+	  if (!ffi_trace_decode_sig (s, &p, end))
+	    {
+	      ffi_trace_free_sig (s);
+	      return 0;
+	    }
+	  s->hash = hash;
+	  /* A recording that ran out of room for hashes repeats its
+	     signatures.  */
+	  for (i = 0; i < trace->nsigs && trace->sigs[i].hash != hash; i++)
+	    ;
+	  if (i < trace->nsigs)
+	    ffi_trace_free_sig (s);
+	  else
+	    trace->nsigs++;
+	  continue;
+	}
+      if (tag != FFI_TRACE_CALL && tag != FFI_TRACE_CLOSURE)
+	return 0;
+
+      if (end - p < 4)
+	return 0;
+      nbytes = ffi_trace_get32 (p);
+      p += 4;
+      if ((size_t) (end - p) < nbytes)
+	return 0;
+
+      /* The same signatures tend to follow each other.  */
+      if (last >= trace->nsigs || trace->sigs[last].hash != hash)
+	{
+	  for (i = 0; i < trace->nsigs && trace->sigs[i].hash != hash; i++)
+	    ;
+	  if (i == trace->nsigs)
+	    return 0;
+	  last = i;
+	}
+      s = &trace->sigs[last];
+
+      if (trace->nevents == events_size)
+	{
+	  events_size = events_size ? 2 * events_size : 256;
+	  e = realloc (trace->events, events_size * sizeof (*e));
+	  if (e == NULL)
+	    return 0;
+	  trace->events = e;
+	}
+      e = &trace->events[trace->nevents++];
+      e->sig = last;
+      e->closure = tag == FFI_TRACE_CLOSURE;
+      e->args = (size_t) -1;
+
+      if (e->closure && s->code == NULL)
+	{
+#if FFI_CLOSURES
+	  s->closure = ffi_closure_alloc (sizeof (ffi_closure), &s->code);
+	  if (s->closure == NULL
+	      || ffi_prep_closure_loc (s->closure, &s->cif, ffi_trace_handler,
+				       NULL, s->code) != FFI_OK)
+#endif
+	    return 0;
+	}
+
+      if (nbytes)
+	{
+	  char *b;
+
+	  if (nbytes != ffi_packed_size (&s->cif))
+	    return 0;
+	  while (bytes_used + nbytes > bytes_size)
+	    {
+	      bytes_size = bytes_size ? 2 * bytes_size : 4096;
+	      if ((b = realloc (trace->bytes, bytes_size)) == NULL)
+		return 0;
+	      trace->bytes = b;
+	    }
+	  memcpy (trace->bytes + bytes_used, p, nbytes);
+	  e->args = bytes_used;
+	  bytes_used = ALIGN (bytes_used + nbytes, FFI_TRACE_ALIGN);
+	  p += nbytes;
+	}
+    }
+
+  return 1;
+}
+
+ffi_trace *
+ffi_trace_load (const char *path)
+{
+  ffi_trace *trace;
+  unsigned char *data = NULL;
+  long n = 0;
+  FILE *f;
+  int ok;
+
+  if ((f = fopen (path, "rb")) == NULL)
+    return NULL;
+  ok = (fseek (f, 0, SEEK_END) == 0
+	&& (n = ftell (f)) >= 0
+	&& fseek (f, 0, SEEK_SET) == 0
+	&& (data = malloc (n + 1)) != NULL
+	&& fread (data, 1, n, f) == (size_t) n);
+  fclose (f);
+
+  trace = calloc (1, sizeof (*trace));
+  if (!ok || trace == NULL || !ffi_trace_parse (trace, data, n))
+    {
+      ffi_trace_free (trace);
+      trace = NULL;
+    }
+  free (data);
+  return trace;
+}
+
+size_t
+ffi_trace_replay (ffi_trace *trace)
+{
+  size_t i;
+  unsigned j;
+
+  for (i = 0; i < trace->nevents; i++)
+    {
+      struct ffi_trace_event *e = &trace->events[i];
+      struct ffi_trace_sig *s = &trace->sigs[e->sig];
+      void **avalue = s->zero_avalue;
+
+      if (e->args != (size_t) -1)
+	{
+	  avalue = s->avalue;
+	  for (j = 0; j < s->cif.nargs; j++)
+	    avalue[j] = trace->bytes + e->args + s->offsets[j];
+	}
+      ffi_call (&s->cif, e->closure ? FFI_FN (s->code)
+		: FFI_FN (ffi_trace_stub), s->rvalue, avalue);
+    }
+  return trace->nevents;
+}
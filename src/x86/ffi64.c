@@ -215,9 +215,11 @@ classify_argument (ffi_type *type, enum x86_64_reg_class classes[],
       return 2;
 #endif
     case FFI_TYPE_STRUCT:
+    case FFI_TYPE_ARRAY:
       {
 	const size_t UNITS_PER_WORD = 8;
 	size_t words = (type->size + UNITS_PER_WORD - 1) / UNITS_PER_WORD;
+	size_t count, n;
 	ffi_type **ptr;
 	unsigned int i;
 	enum x86_64_reg_class subclasses[MAX_CLASSES];
@@ -238,25 +240,28 @@ classify_argument (ffi_type *type, enum x86_64_reg_class classes[],
 	    return 1;
 	  }
 
-	/* Merge the fields of structure.  */
+	/* Merge the fields of structure.  An array has COUNT copies of
+	   its only element, at most 32 of them by now.  */
+	count = type->type == FFI_TYPE_ARRAY ? FFI_ARRAY_COUNT (type) : 1;
 	for (ptr = type->elements; *ptr != NULL; ptr++)
-	  {
-	    size_t num;
+	  for (n = 0; n < count; n++)
+	    {
+	      size_t num;
 
-	    byte_offset = ALIGN (byte_offset, (*ptr)->alignment);
+	      byte_offset = ALIGN (byte_offset, (*ptr)->alignment);
 
-	    num = classify_argument (*ptr, subclasses, byte_offset % 8);
-	    if (num == 0)
-	      return 0;
-	    for (i = 0; i < num; i++)
-	      {
-		size_t pos = byte_offset / 8;
-		classes[i + pos] =
-		  merge_classes (subclasses[i], classes[i + pos]);
-	      }
+	      num = classify_argument (*ptr, subclasses, byte_offset % 8);
+	      if (num == 0)
+		return 0;
+	      for (i = 0; i < num; i++)
+		{
+		  size_t pos = byte_offset / 8;
+		  classes[i + pos] =
+		    merge_classes (subclasses[i], classes[i + pos]);
+		}
 
-	    byte_offset += (*ptr)->size;
-	  }
+	      byte_offset += (*ptr)->size;
+	    }
 
 	if (words > 2)
 	  {
@@ -400,6 +405,7 @@ ffi_prep_cif_machdep (ffi_cif *cif)
   size_t bytes, n, rtype_size;
   ffi_type *rtype;
 
+  cif->nfixedargs = cif->nargs;
   if (cif->abi == FFI_EFI64)
     return ffi_prep_cif_machdep_efi64(cif);
   if (cif->abi != FFI_UNIX64)
@@ -547,6 +553,16 @@ ffi_prep_cif_machdep (ffi_cif *cif)
   return FFI_OK;
 }
 
+ffi_status
+ffi_prep_cif_machdep_var (ffi_cif *cif, unsigned int nfixedargs,
+			  unsigned int ntotalargs)
+{
+  ffi_status status = ffi_prep_cif_machdep (cif);
+
+  cif->nfixedargs = nfixedargs;
+  return status;
+}
+
 static void
 ffi_call_int (ffi_cif *cif, void (*fn)(void), void *rvalue,
 	      void **avalue, void *closure)
@@ -556,9 +572,13 @@ ffi_call_int (ffi_cif *cif, void (*fn)(void), void *rvalue,
   ffi_type **arg_types;
   int gprcount, ssecount, ngpr, nsse, i, avn, flags;
   struct register_args *reg_args;
+  FFI_PROFILE_DECL
+
+  FFI_PROFILE_STAMP (0);
 
   /* Can't call 32-bit mode from 64-bit mode.  */
   FFI_ASSERT (cif->abi == FFI_UNIX64);
+  FFI_STATS_CALL (cif);
 
   /* If the return value is a struct and we don't have a return value
      address then we need to make one.  Otherwise we can ignore it.  */
@@ -659,8 +679,11 @@ ffi_call_int (ffi_cif *cif, void (*fn)(void), void *rvalue,
     }
   reg_args->rax = ssecount;
 
+  FFI_PROFILE_STAMP (1);
   ffi_call_unix64 (stack, cif->bytes + sizeof (struct register_args),
 		   flags, rvalue, fn);
+  FFI_PROFILE_STAMP (2);
+  FFI_PROFILE_RECORD (cif, FFI_PROFILE_CALL);
 }
 
 extern void
@@ -669,9 +692,14 @@ ffi_call_efi64(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue);
 void
 ffi_call (ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue)
 {
-  if (cif->abi == FFI_EFI64)
-    return ffi_call_efi64(cif, fn, rvalue, avalue);
-  ffi_call_int (cif, fn, rvalue, avalue, NULL);
+  FFI_OBSERVE (FFI_OBSERVE_CALL_ENTER, cif, fn, rvalue, avalue);
+  if (FFI_AOT_CALL (cif, fn, rvalue, avalue))
+    FFI_STATS_CALL (cif);
+  else if (cif->abi == FFI_EFI64)
+    ffi_call_efi64(cif, fn, rvalue, avalue);
+  else
+    ffi_call_int (cif, fn, rvalue, avalue, NULL);
+  FFI_OBSERVE (FFI_OBSERVE_CALL_EXIT, cif, fn, rvalue, avalue);
 }
 
 extern void
@@ -682,11 +710,615 @@ void
 ffi_call_go (ffi_cif *cif, void (*fn)(void), void *rvalue,
 	     void **avalue, void *closure)
 {
+  FFI_OBSERVE (FFI_OBSERVE_CALL_ENTER, cif, fn, rvalue, avalue);
   if (cif->abi == FFI_EFI64)
     ffi_call_go_efi64(cif, fn, rvalue, avalue, closure);
   ffi_call_int (cif, fn, rvalue, avalue, closure);
+  FFI_OBSERVE (FFI_OBSERVE_CALL_EXIT, cif, fn, rvalue, avalue);
 }
 
+/* Columnar calls.  A signature made only of scalars that all travel in
+   registers is classified once; each row then loads the register image
+   straight from the columns.  */
+
+struct column_arg
+{
+  unsigned short type;
+  unsigned short reg;
+};
+
+static void
+ffi_call_column_row (const struct column_arg *plan, char **cur,
+		     unsigned avn, int ssecount, unsigned flags,
+		     void *rvalue, void (*fn)(void))
+{
+  struct register_args *reg_args;
+  char *stack;
+  unsigned i;
+
+  /* As in ffi_call_int, the call deallocates this block, so it has to be
+     allocated afresh for every row.  */
+  stack = alloca (sizeof (struct register_args) + 4*8);
+  reg_args = (struct register_args *) stack;
+
+  for (i = 0; i < avn; i++)
+    {
+      char *a = cur[i];
+      unsigned r = plan[i].reg;
+
+      switch (plan[i].type)
+	{
+	case FFI_TYPE_UINT8:
+	  reg_args->gpr[r] = *(UINT8 *) a;
+	  break;
+	case FFI_TYPE_SINT8:
+	  reg_args->gpr[r] = (SINT64) *(SINT8 *) a;
+	  break;
+	case FFI_TYPE_UINT16:
+	  reg_args->gpr[r] = *(UINT16 *) a;
+	  break;
+	case FFI_TYPE_SINT16:
+	  reg_args->gpr[r] = (SINT64) *(SINT16 *) a;
+	  break;
+	case FFI_TYPE_UINT32:
+	  reg_args->gpr[r] = *(UINT32 *) a;
+	  break;
+	case FFI_TYPE_INT:
+	case FFI_TYPE_SINT32:
+	  reg_args->gpr[r] = (SINT64) *(SINT32 *) a;
+	  break;
+	case FFI_TYPE_POINTER:
+	  reg_args->gpr[r] = (uintptr_t) *(void **) a;
+	  break;
+	case FFI_TYPE_FLOAT:
+	  reg_args->sse[r].i32 = *(UINT32 *) a;
+	  break;
+	case FFI_TYPE_DOUBLE:
+	  reg_args->sse[r].i64 = *(UINT64 *) a;
+	  break;
+	default:
+	  reg_args->gpr[r] = *(UINT64 *) a;
+	  break;
+	}
+    }
+  reg_args->rax = ssecount;
+  reg_args->r10 = 0;
+
+  ffi_call_unix64 (stack, sizeof (struct register_args), flags, rvalue, fn);
+}
+
+ffi_status FFI_HIDDEN
+ffi_call_columns_machdep (ffi_cif *cif, void (*fn)(void), size_t nrows,
+			  void *rvalue, size_t rstride, void **columns,
+			  const size_t *strides)
+{
+  struct column_arg *plan;
+  char **cur;
+  char *rcur = rvalue;
+  ffi_arg tmp;
+  unsigned i, avn, flags;
+  int gprcount, ssecount, widened;
+
+  /* Anything that needs the stack or a hidden return pointer goes
+     through ffi_call one row at a time.  */
+  if (cif->abi != FFI_UNIX64 || cif->bytes != 0
+      || (cif->flags & UNIX64_FLAG_RET_IN_MEM))
+    return FFI_BAD_TYPEDEF;
+
+  avn = cif->nargs;
+  plan = alloca (avn * sizeof (struct column_arg));
+  gprcount = ssecount = 0;
+
+  for (i = 0; i < avn; i++)
+    {
+      unsigned short type = cif->arg_types[i]->type;
+
+      switch (type)
+	{
+	case FFI_TYPE_FLOAT:
+	case FFI_TYPE_DOUBLE:
+	  plan[i].reg = ssecount++;
+	  break;
+	case FFI_TYPE_INT:
+	case FFI_TYPE_UINT8:
+	case FFI_TYPE_SINT8:
+	case FFI_TYPE_UINT16:
+	case FFI_TYPE_SINT16:
+	case FFI_TYPE_UINT32:
+	case FFI_TYPE_SINT32:
+	case FFI_TYPE_UINT64:
+	case FFI_TYPE_SINT64:
+	case FFI_TYPE_POINTER:
+	  plan[i].reg = gprcount++;
+	  break;
+	default:
+	  return FFI_BAD_TYPEDEF;
+	}
+      plan[i].type = type;
+    }
+
+  cur = alloca (avn * sizeof (char *));
+  for (i = 0; i < avn; i++)
+    cur[i] = columns[i];
+
+  flags = rcur != NULL ? cif->flags : UNIX64_RET_VOID;
+  widened = rcur != NULL && ffi_column_rvalue_is_widened (cif->rtype);
+
+  while (nrows-- > 0)
+    {
+      if (widened)
+	{
+	  ffi_call_column_row (plan, cur, avn, ssecount, flags, &tmp, fn);
+	  ffi_column_store_rvalue (cif->rtype, rcur, &tmp);
+	}
+      else
+	ffi_call_column_row (plan, cur, avn, ssecount, flags, rcur, fn);
+
+      for (i = 0; i < avn; i++)
+	cur[i] += strides[i];
+      if (rcur != NULL)
+	rcur += rstride;
+    }
+
+  return FFI_OK;
+}
+
+/* Where each argument of a cif is passed.  This is the assignment made
+   by ffi_call_int, worked out ahead of time for the interfaces that
+   marshal arguments before the call.  */
+
+struct arg_location
+{
+  /* The number of eightbytes passed in registers, or zero if the
+     argument is passed in memory.  */
+  unsigned char n;
+  unsigned char gpr, sse;
+  unsigned char classes[MAX_CLASSES];
+  /* The offset in the stack argument area, for memory arguments.  */
+  unsigned stack;
+};
+
+/* The locations of all the arguments of a cif, kept by the interfaces
+   that call it repeatedly.  */
+
+struct arg_plan
+{
+  unsigned ssecount;
+  struct arg_location locs[];
+};
+
+/* Fill in LOCS for every argument of CIF, and return the number of SSE
+   registers used.  */
+
+static int
+ffi_arg_locations (ffi_cif *cif, struct arg_location *locs)
+{
+  enum x86_64_reg_class classes[MAX_CLASSES];
+  int gprcount, ssecount, ngpr, nsse;
+  unsigned i, j;
+  size_t n, bytes;
+
+  gprcount = ssecount = 0;
+  bytes = 0;
+
+  /* The hidden return pointer takes the first integer register.  */
+  if (cif->flags & UNIX64_FLAG_RET_IN_MEM)
+    gprcount++;
+
+  for (i = 0; i < cif->nargs; i++)
+    {
+      ffi_type *type = cif->arg_types[i];
+
+      n = examine_argument (type, classes, 0, &ngpr, &nsse);
+      if (n == 0
+	  || gprcount + ngpr > MAX_GPR_REGS
+	  || ssecount + nsse > MAX_SSE_REGS)
+	{
+	  long align = type->alignment;
+
+	  if (align < 8)
+	    align = 8;
+
+	  bytes = ALIGN (bytes, align);
+	  locs[i].n = 0;
+	  locs[i].stack = bytes;
+	  bytes += type->size;
+	}
+      else
+	{
+	  locs[i].n = n;
+	  locs[i].gpr = gprcount;
+	  locs[i].sse = ssecount;
+	  for (j = 0; j < n; j++)
+	    locs[i].classes[j] = classes[j];
+	  gprcount += ngpr;
+	  ssecount += nsse;
+	}
+    }
+
+  return ssecount;
+}
+
+/* Marshal VALUE, an argument of type TYPE, into the register image
+   REG_ARGS or the stack argument area ARGP, as described by LOC.  */
+
+static void
+ffi_store_argument (struct register_args *reg_args, char *argp,
+		    ffi_type *type, const struct arg_location *loc,
+		    void *value)
+{
+  size_t size = type->size;
+  char *a = value;
+  unsigned gpr = loc->gpr, sse = loc->sse;
+  unsigned j;
+
+  if (loc->n == 0)
+    {
+      memcpy (argp + loc->stack, value, size);
+      return;
+    }
+
+  for (j = 0; j < loc->n; j++, a += 8, size -= 8)
+    {
+      switch (loc->classes[j])
+	{
+	case X86_64_NO_CLASS:
+	case X86_64_SSEUP_CLASS:
+	  break;
+	case X86_64_INTEGER_CLASS:
+	case X86_64_INTEGERSI_CLASS:
+	  /* Sign-extend as ffi_call_int does.  */
+	  switch (type->type)
+	    {
+	    case FFI_TYPE_SINT8:
+	      reg_args->gpr[gpr] = (SINT64) *((SINT8 *) a);
+	      break;
+	    case FFI_TYPE_SINT16:
+	      reg_args->gpr[gpr] = (SINT64) *((SINT16 *) a);
+	      break;
+	    case FFI_TYPE_SINT32:
+	      reg_args->gpr[gpr] = (SINT64) *((SINT32 *) a);
+	      break;
+	    default:
+	      reg_args->gpr[gpr] = 0;
+	      memcpy (&reg_args->gpr[gpr], a, size < 8 ? size : 8);
+	    }
+	  gpr++;
+	  break;
+	case X86_64_SSE_CLASS:
+	case X86_64_SSEDF_CLASS:
+	  reg_args->sse[sse++].i64 = *(UINT64 *) a;
+	  break;
+	case X86_64_SSESF_CLASS:
+	  reg_args->sse[sse++].i32 = *(UINT32 *) a;
+	  break;
+	default:
+	  abort();
+	}
+    }
+}
+
+/* The reverse of ffi_store_argument: copy the argument of type TYPE
+   described by LOC out of REG_ARGS or ARGP into VALUE.  */
+
+static void
+ffi_load_argument (const struct register_args *reg_args, const char *argp,
+		   ffi_type *type, const struct arg_location *loc,
+		   void *value)
+{
+  size_t size = type->size;
+  char *a = value;
+  unsigned gpr = loc->gpr, sse = loc->sse;
+  unsigned j;
+
+  if (loc->n == 0)
+    {
+      memcpy (value, argp + loc->stack, size);
+      return;
+    }
+
+  for (j = 0; j < loc->n; j++, a += 8, size -= 8)
+    {
+      switch (loc->classes[j])
+	{
+	case X86_64_NO_CLASS:
+	case X86_64_SSEUP_CLASS:
+	  break;
+	case X86_64_INTEGER_CLASS:
+	case X86_64_INTEGERSI_CLASS:
+	  memcpy (a, &reg_args->gpr[gpr++], size < 8 ? size : 8);
+	  break;
+	default:
+	  memcpy (a, &reg_args->sse[sse++], size < 8 ? size : 8);
+	  break;
+	}
+    }
+}
+
+/* Argument frames.  The image holds the register_args block followed
+   by the stack argument area, exactly as ffi_call_unix64 wants them;
+   a call only has to copy it into place.  */
+
+ffi_status FFI_HIDDEN
+ffi_prep_frame_machdep (ffi_frame *frame, void **avalue)
+{
+  ffi_cif *cif = frame->cif;
+  struct arg_location *locs;
+  struct register_args *reg_args;
+  unsigned i;
+
+  if (cif->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  locs = malloc (cif->nargs * sizeof (struct arg_location) + 1);
+  reg_args = calloc (1, sizeof (struct register_args) + cif->bytes);
+  if (locs == NULL || reg_args == NULL)
+    {
+      free (locs);
+      free (reg_args);
+      return FFI_BAD_TYPEDEF;
+    }
+
+  reg_args->rax = ffi_arg_locations (cif, locs);
+  if (avalue != NULL)
+    for (i = 0; i < cif->nargs; i++)
+      ffi_store_argument (reg_args, (char *) (reg_args + 1),
+			  cif->arg_types[i], &locs[i], avalue[i]);
+
+  frame->image = reg_args;
+  frame->plan = locs;
+  return FFI_OK;
+}
+
+void FFI_HIDDEN
+ffi_frame_set_arg_machdep (ffi_frame *frame, unsigned n, void *value)
+{
+  struct register_args *reg_args = frame->image;
+  struct arg_location *locs = frame->plan;
+
+  ffi_store_argument (reg_args, (char *) (reg_args + 1),
+		      frame->cif->arg_types[n], &locs[n], value);
+}
+
+void FFI_HIDDEN
+ffi_frame_get_arg_machdep (ffi_frame *frame, unsigned n, void *value)
+{
+  struct register_args *reg_args = frame->image;
+  struct arg_location *locs = frame->plan;
+
+  ffi_load_argument (reg_args, (char *) (reg_args + 1),
+		     frame->cif->arg_types[n], &locs[n], value);
+}
+
+void FFI_HIDDEN
+ffi_frame_call_machdep (ffi_frame *frame, void (*fn)(void), void *rvalue)
+{
+  ffi_cif *cif = frame->cif;
+  struct register_args *reg_args;
+  char *stack;
+  int flags;
+
+  flags = cif->flags;
+  if (rvalue == NULL)
+    {
+      if (flags & UNIX64_FLAG_RET_IN_MEM)
+	rvalue = alloca (cif->rtype->size);
+      else
+	flags = UNIX64_RET_VOID;
+    }
+
+  /* As in ffi_call_int, this block is consumed by the call.  */
+  stack = alloca (sizeof (struct register_args) + cif->bytes + 4*8);
+  memcpy (stack, frame->image, sizeof (struct register_args) + cif->bytes);
+  reg_args = (struct register_args *) stack;
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    reg_args->gpr[0] = (unsigned long) rvalue;
+
+  ffi_call_unix64 (stack, cif->bytes + sizeof (struct register_args),
+		   flags, rvalue, fn);
+}
+
+/* Packed plans and Java raw plans keep the place of every argument,
+   and each argument is stored straight from its offset in the caller's
+   buffer into the register block, as ffi_frame_set_arg_machdep does.  */
+
+static struct arg_plan *
+ffi_prep_arg_plan (ffi_cif *cif)
+{
+  struct arg_plan *p;
+
+  if (cif->abi != FFI_UNIX64)
+    return NULL;
+
+  p = malloc (sizeof (struct arg_plan)
+	      + cif->nargs * sizeof (struct arg_location));
+  if (p != NULL)
+    p->ssecount = ffi_arg_locations (cif, p->locs);
+  return p;
+}
+
+static void
+ffi_call_arg_plan (ffi_cif *cif, struct arg_plan *p, const size_t *offsets,
+		   void (*fn)(void), void *rvalue, char *args)
+{
+  struct register_args *reg_args;
+  char *stack, *argp;
+  int flags = cif->flags;
+  unsigned i;
+
+  if (rvalue == NULL)
+    {
+      if (flags & UNIX64_FLAG_RET_IN_MEM)
+	rvalue = alloca (cif->rtype->size);
+      else
+	flags = UNIX64_RET_VOID;
+    }
+
+  /* As in ffi_call_int, this block is consumed by the call.  */
+  stack = alloca (sizeof (struct register_args) + cif->bytes + 4*8);
+  reg_args = (struct register_args *) stack;
+  argp = stack + sizeof (struct register_args);
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    reg_args->gpr[0] = (uintptr_t) rvalue;
+  for (i = 0; i < cif->nargs; i++)
+    ffi_store_argument (reg_args, argp, cif->arg_types[i], &p->locs[i],
+			args + offsets[i]);
+  reg_args->rax = p->ssecount;
+  reg_args->r10 = 0;
+
+  ffi_call_unix64 (stack, cif->bytes + sizeof (struct register_args),
+		   flags, rvalue, fn);
+}
+
+ffi_status FFI_HIDDEN
+ffi_prep_packed_plan_machdep (ffi_packed_plan *plan)
+{
+  plan->machdep = ffi_prep_arg_plan (plan->cif);
+  return plan->machdep != NULL ? FFI_OK : FFI_BAD_ABI;
+}
+
+void FFI_HIDDEN
+ffi_packed_plan_call_machdep (ffi_packed_plan *plan, void (*fn)(void),
+			      void *rvalue, void *args)
+{
+  ffi_call_arg_plan (plan->cif, plan->machdep, plan->offsets, fn, rvalue,
+		     args);
+}
+
+ffi_status FFI_HIDDEN
+ffi_prep_java_raw_plan_machdep (ffi_java_raw_plan *plan)
+{
+  plan->machdep = ffi_prep_arg_plan (plan->cif);
+  return plan->machdep != NULL ? FFI_OK : FFI_BAD_ABI;
+}
+
+void FFI_HIDDEN
+ffi_java_raw_plan_call_machdep (ffi_java_raw_plan *plan, void (*fn)(void),
+				void *rvalue, ffi_java_raw *raw)
+{
+  ffi_call_arg_plan (plan->cif, plan->machdep, plan->offsets, fn, rvalue,
+		     (char *) raw);
+}
+
+/* Argument placement, from the assignment ffi_arg_locations shares
+   with ffi_call_int.  */
+
+const char *
+ffi_explain_reg_machdep (int fp, int ret, unsigned n)
+{
+  static const char *const gpr[] = {
+    "rdi", "rsi", "rdx", "rcx", "r8", "r9"
+  };
+  static const char *const sse[] = {
+    "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+  };
+
+  if (fp)
+    return n < MAX_SSE_REGS ? sse[n] : "?";
+  if (ret)
+    return n == 0 ? "rax" : n == 1 ? "rdx" : "?";
+  return n < MAX_GPR_REGS ? gpr[n] : "?";
+}
+
+ffi_status FFI_HIDDEN
+ffi_explain_machdep (ffi_cif *cif, ffi_placement *rvalue,
+		     ffi_placement *args)
+{
+  struct arg_location *locs;
+  unsigned i, j;
+  int aggregate;
+
+  if (cif->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  aggregate = (cif->rtype->type == FFI_TYPE_STRUCT
+	       || cif->rtype->type == FFI_TYPE_COMPLEX);
+  if (cif->flags & UNIX64_FLAG_RET_IN_MEM)
+    {
+      rvalue->kind = FFI_PLACE_MEMORY;
+      rvalue->ngpr = 1;
+    }
+  else
+    switch (cif->flags & (UNIX64_FLAG_RET_IN_MEM - 1))
+      {
+      case UNIX64_RET_VOID:
+	break;
+      case UNIX64_RET_XMM32:
+      case UNIX64_RET_XMM64:
+	rvalue->kind = FFI_PLACE_FPR;
+	rvalue->nfpr = 1;
+	break;
+      case UNIX64_RET_X87:
+      case UNIX64_RET_X87_2:
+	rvalue->kind = FFI_PLACE_X87;
+	break;
+      case UNIX64_RET_ST_XMM0_RAX:
+      case UNIX64_RET_ST_RAX_XMM0:
+	rvalue->kind = FFI_PLACE_GPR_FPR;
+	rvalue->ngpr = rvalue->nfpr = 1;
+	rvalue->flags = FFI_PLACE_FLATTENED;
+	break;
+      case UNIX64_RET_ST_XMM0_XMM1:
+	rvalue->kind = FFI_PLACE_FPR;
+	rvalue->nfpr = 2;
+	rvalue->flags = aggregate ? FFI_PLACE_FLATTENED : 0;
+	break;
+      case UNIX64_RET_ST_RAX_RDX:
+	rvalue->kind = FFI_PLACE_GPR;
+	rvalue->ngpr = 2;
+	rvalue->flags = aggregate ? FFI_PLACE_FLATTENED : 0;
+	break;
+      default:
+	rvalue->kind = FFI_PLACE_GPR;
+	rvalue->ngpr = 1;
+	break;
+      }
+
+  locs = alloca (cif->nargs * sizeof (struct arg_location));
+  ffi_arg_locations (cif, locs);
+  for (i = 0; i < cif->nargs; i++)
+    {
+      ffi_type *type = cif->arg_types[i];
+      ffi_placement *p = &args[i];
+
+      if (i >= cif->nfixedargs)
+	p->flags |= FFI_PLACE_VARIADIC;
+      if (locs[i].n == 0)
+	{
+	  p->kind = FFI_PLACE_STACK;
+	  p->stack = locs[i].stack;
+	  p->stack_size = ALIGN (type->size, 8);
+	  continue;
+	}
+
+      p->gpr = locs[i].gpr;
+      p->fpr = locs[i].sse;
+      /* Count registers as examine_argument does.  */
+      for (j = 0; j < locs[i].n; j++)
+	switch (locs[i].classes[j])
+	  {
+	  case X86_64_INTEGER_CLASS:
+	  case X86_64_INTEGERSI_CLASS:
+	    p->ngpr++;
+	    break;
+	  case X86_64_SSE_CLASS:
+	  case X86_64_SSESF_CLASS:
+	  case X86_64_SSEDF_CLASS:
+	    p->nfpr++;
+	    break;
+	  default:
+	    break;
+	  }
+      p->kind = (p->ngpr == 0 ? FFI_PLACE_FPR
+		 : p->nfpr == 0 ? FFI_PLACE_GPR : FFI_PLACE_GPR_FPR);
+      if ((type->type == FFI_TYPE_STRUCT || type->type == FFI_TYPE_COMPLEX)
+	  && p->ngpr + p->nfpr > 1)
+	p->flags |= FFI_PLACE_FLATTENED;
+    }
+
+  return FFI_OK;
+}
 
 extern void ffi_closure_unix64(void) FFI_HIDDEN;
 extern void ffi_closure_unix64_sse(void) FFI_HIDDEN;
@@ -698,12 +1330,11 @@ ffi_prep_closure_loc_efi64(ffi_closure* closure,
 			   void *user_data,
 			   void *codeloc);
 
-ffi_status
-ffi_prep_closure_loc (ffi_closure* closure,
-		      ffi_cif* cif,
-		      void (*fun)(ffi_cif*, void*, void**, void*),
-		      void *user_data,
-		      void *codeloc)
+/* Point the trampoline of CLOSURE, at CODELOC, to DEST.  */
+
+static void
+ffi_closure_set_entry (ffi_closure *closure, void *codeloc,
+		       void (*dest)(void))
 {
   static const unsigned char trampoline[16] = {
     /* leaq  -0x7(%rip),%r10   # 0x0  */
@@ -713,9 +1344,28 @@ ffi_prep_closure_loc (ffi_closure* closure,
     /* nopl  (%rax) */
     0x0f, 0x1f, 0x00
   };
-  void (*dest)(void);
   char *tramp = closure->tramp;
 
+#if FFI_EXEC_STATIC_TRAMP
+  if (ffi_tramp_is_present (codeloc))
+    ffi_tramp_set_parms (codeloc, dest, closure);
+  else
+#endif
+    {
+      memcpy (tramp, trampoline, sizeof(trampoline));
+      *(UINT64 *)(tramp + 16) = (uintptr_t)dest;
+    }
+}
+
+ffi_status
+ffi_prep_closure_loc (ffi_closure* closure,
+		      ffi_cif* cif,
+		      void (*fun)(ffi_cif*, void*, void**, void*),
+		      void *user_data,
+		      void *codeloc)
+{
+  void (*dest)(void);
+
   if (cif->abi == FFI_EFI64)
     return ffi_prep_closure_loc_efi64(closure, cif, fun, user_data, codeloc);
   if (cif->abi != FFI_UNIX64)
@@ -726,8 +1376,7 @@ ffi_prep_closure_loc (ffi_closure* closure,
   else
     dest = ffi_closure_unix64;
 
-  memcpy (tramp, trampoline, sizeof(trampoline));
-  *(UINT64 *)(tramp + 16) = (uintptr_t)dest;
+  ffi_closure_set_entry (closure, codeloc, dest);
 
   closure->cif = cif;
   closure->fun = fun;
@@ -736,6 +1385,196 @@ ffi_prep_closure_loc (ffi_closure* closure,
   return FFI_OK;
 }
 
+/* Dense closure arrays.  The code starts with a head that loads the
+   array into %r10 and jumps to the dispatcher, followed by groups of
+   eight byte slots.  The middle slot of each group jumps to the head;
+   each of the others is an entry that loads its index into %r11 and
+   makes a short jump to the middle slot.  */
+
+#define ARRAY_HEAD_SIZE		32
+#define ARRAY_GROUP_SLOTS	32
+#define ARRAY_GROUP_SIZE	(ARRAY_GROUP_SLOTS * 8)
+#define ARRAY_HUB_SLOT		(ARRAY_GROUP_SLOTS / 2)
+
+extern void ffi_closure_unix64_array(void) FFI_HIDDEN;
+extern void ffi_closure_unix64_array_sse(void) FFI_HIDDEN;
+
+size_t FFI_HIDDEN
+ffi_closure_array_size_machdep (size_t count)
+{
+  size_t groups = (count + ARRAY_GROUP_SLOTS - 2) / (ARRAY_GROUP_SLOTS - 1);
+
+  return ARRAY_HEAD_SIZE + groups * ARRAY_GROUP_SIZE;
+}
+
+void *
+ffi_closure_array_entry_machdep (ffi_closure_array *array, size_t index)
+{
+  size_t group = index / (ARRAY_GROUP_SLOTS - 1);
+  size_t slot = index % (ARRAY_GROUP_SLOTS - 1);
+
+  if (slot >= ARRAY_HUB_SLOT)
+    slot++;
+  return (char *) array->code + ARRAY_HEAD_SIZE
+	 + group * ARRAY_GROUP_SIZE + slot * 8;
+}
+
+ffi_status FFI_HIDDEN
+ffi_prep_closure_array_machdep (ffi_closure_array *array)
+{
+  unsigned char *code = array->writable;
+  unsigned char *group, *slot;
+  void (*dest)(void);
+  unsigned s;
+  size_t i;
+
+  /* The entries encode their index in 32 bits.  */
+  if (array->cif->abi != FFI_UNIX64 || array->count > 0xffffffff)
+    return FFI_BAD_ABI;
+
+  if (array->cif->flags & UNIX64_FLAG_XMM_ARGS)
+    dest = ffi_closure_unix64_array_sse;
+  else
+    dest = ffi_closure_unix64_array;
+
+  /* Unused slots are filled with int3.  */
+  memset (code, 0xcc, ffi_closure_array_size_machdep (array->count));
+
+  /* movabs $array,%r10 */
+  code[0] = 0x49;
+  code[1] = 0xba;
+  *(UINT64 *)(code + 2) = (uintptr_t) array;
+  /* jmpq *0x0(%rip)  # 0x10 */
+  code[10] = 0xff;
+  code[11] = 0x25;
+  *(UINT32 *)(code + 12) = 0;
+  *(UINT64 *)(code + 16) = (uintptr_t) dest;
+
+  for (i = 0; i < array->count; i++)
+    {
+      group = code + ARRAY_HEAD_SIZE
+	      + i / (ARRAY_GROUP_SLOTS - 1) * ARRAY_GROUP_SIZE;
+      s = i % (ARRAY_GROUP_SLOTS - 1);
+      if (s >= ARRAY_HUB_SLOT)
+	s++;
+
+      if (s == 0)
+	{
+	  /* jmp head */
+	  slot = group + ARRAY_HUB_SLOT * 8;
+	  slot[0] = 0xe9;
+	  *(SINT32 *)(slot + 1) = (SINT32) (code - (slot + 5));
+	}
+
+      /* movl $index,%r11d */
+      slot = group + s * 8;
+      slot[0] = 0x41;
+      slot[1] = 0xbb;
+      *(UINT32 *)(slot + 2) = i;
+      /* jmp hub */
+      slot[6] = 0xeb;
+      slot[7] = (UINT8) ((ARRAY_HUB_SLOT - s - 1) * 8);
+    }
+
+  return FFI_OK;
+}
+
+/* Forwarding closures.  When every argument of the target is passed in
+   registers and each bound one takes a single general register, the
+   stub moves the general registers of the incoming arguments up past
+   the bound ones, loads the bound values, sets %al as ffi_call does
+   and jumps to the target.  */
+
+#define FORWARD_STUB_SIZE	128
+
+static const unsigned char gpr_numbers[MAX_GPR_REGS] = {
+  7, 6, 2, 1, 8, 9		/* %rdi, %rsi, %rdx, %rcx, %r8, %r9 */
+};
+
+static int
+gpr_count (const struct arg_location *loc)
+{
+  int j, n = 0;
+
+  for (j = 0; j < loc->n; j++)
+    if (loc->classes[j] == X86_64_INTEGER_CLASS
+	|| loc->classes[j] == X86_64_INTEGERSI_CLASS)
+      n++;
+  return n;
+}
+
+ffi_status FFI_HIDDEN
+ffi_prep_forward_closure_machdep (ffi_forward_closure *fwd, void **code)
+{
+  ffi_cif *target = fwd->target;
+  struct arg_location *locs, *inlocs;
+  struct register_args reg_args;
+  unsigned char *p;
+  unsigned i, nbound = fwd->nbound;
+  int k, ssecount;
+
+  if (target->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  locs = alloca (target->nargs * sizeof (struct arg_location));
+  inlocs = alloca (fwd->cif.nargs * sizeof (struct arg_location));
+  ssecount = ffi_arg_locations (target, locs);
+  ffi_arg_locations (&fwd->cif, inlocs);
+
+  for (i = 0; i < target->nargs; i++)
+    if (locs[i].n == 0)
+      return FFI_BAD_TYPEDEF;
+  for (i = 0; i < nbound; i++)
+    if (locs[i].n != 1 || gpr_count (&locs[i]) != 1)
+      return FFI_BAD_TYPEDEF;
+
+  p = fwd->stub = ffi_closure_code_alloc (FORWARD_STUB_SIZE, code);
+  if (p == NULL)
+    return FFI_BAD_TYPEDEF;
+
+  /* The incoming arguments only move up, so start from the last.  */
+  for (i = fwd->cif.nargs; i-- > 0; )
+    for (k = gpr_count (&inlocs[i]); k-- > 0; )
+      {
+	unsigned src = gpr_numbers[inlocs[i].gpr + k];
+	unsigned dst = gpr_numbers[locs[nbound + i].gpr + k];
+
+	/* movq %src,%dst */
+	*p++ = 0x48 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0);
+	*p++ = 0x89;
+	*p++ = 0xc0 | (src & 7) << 3 | (dst & 7);
+      }
+
+  for (i = 0; i < nbound; i++)
+    {
+      unsigned dst = gpr_numbers[locs[i].gpr];
+
+      ffi_store_argument (&reg_args, NULL, target->arg_types[i], &locs[i],
+			  fwd->bound[i]);
+      /* movabs $value,%dst */
+      *p++ = 0x48 | (dst >= 8 ? 1 : 0);
+      *p++ = 0xb8 | (dst & 7);
+      memcpy (p, &reg_args.gpr[locs[i].gpr], 8);
+      p += 8;
+    }
+
+  /* movl $ssecount,%eax */
+  *p++ = 0xb8;
+  *(UINT32 *) p = ssecount;
+  p += 4;
+  /* movabs $fn,%r11 */
+  *p++ = 0x49;
+  *p++ = 0xbb;
+  *(UINT64 *) p = (uintptr_t) fwd->fn;
+  p += 8;
+  /* jmpq *%r11 */
+  *p++ = 0x41;
+  *p++ = 0xff;
+  *p++ = 0xe3;
+
+  return FFI_OK;
+}
+
 int FFI_HIDDEN
 ffi_closure_unix64_inner(ffi_cif *cif,
 			 void (*fun)(ffi_cif*, void*, void**, void*),
@@ -749,6 +1588,10 @@ ffi_closure_unix64_inner(ffi_cif *cif,
   long i, avn;
   int gprcount, ssecount, ngpr, nsse;
   int flags;
+  FFI_PROFILE_DECL
+
+  FFI_PROFILE_STAMP (0);
+  FFI_STATS_CLOSURE_CALL (cif);
 
   avn = cif->nargs;
   flags = cif->flags;
@@ -823,12 +1666,154 @@ ffi_closure_unix64_inner(ffi_cif *cif,
     }
 
   /* Invoke the closure.  */
+  FFI_OBSERVE (FFI_OBSERVE_CLOSURE_ENTER, cif, FFI_FN (fun), rvalue, avalue);
+  FFI_PROFILE_STAMP (1);
   fun (cif, rvalue, avalue, user_data);
+  FFI_PROFILE_STAMP (2);
+  FFI_OBSERVE (FFI_OBSERVE_CLOSURE_EXIT, cif, FFI_FN (fun), rvalue, avalue);
+  FFI_PROFILE_RECORD (cif, FFI_PROFILE_CLOSURE);
 
   /* Tell assembly how to perform return type promotions.  */
   return flags;
 }
 
+/* Interposers.  The closure entry saves the argument registers as
+   usual; ffi_interpose_unix64_inner copies them, and the stack
+   arguments, straight into a call of the target.  The plan only
+   records where each argument is, for the hooks.  */
+
+extern void ffi_closure_unix64_interpose(void) FFI_HIDDEN;
+extern void ffi_closure_unix64_interpose_sse(void) FFI_HIDDEN;
+
+ffi_status FFI_HIDDEN
+ffi_prep_interposer_machdep (ffi_interposer *ip, void **code)
+{
+  ffi_cif *cif = ip->cif;
+  struct arg_plan *plan;
+  ffi_closure *closure;
+
+  if (cif->abi != FFI_UNIX64)
+    return FFI_BAD_ABI;
+
+  plan = ip->plan = malloc (sizeof (struct arg_plan)
+			    + cif->nargs * sizeof (struct arg_location));
+  if (plan == NULL)
+    return FFI_BAD_TYPEDEF;
+  plan->ssecount = ffi_arg_locations (cif, plan->locs);
+
+  closure = ip->closure = ffi_closure_alloc (sizeof (ffi_closure), code);
+  if (closure == NULL)
+    return FFI_BAD_TYPEDEF;
+
+  ffi_closure_set_entry (closure, *code,
+			 (cif->flags & UNIX64_FLAG_XMM_ARGS)
+			 ? ffi_closure_unix64_interpose_sse
+			 : ffi_closure_unix64_interpose);
+  closure->cif = cif;
+  closure->fun = NULL;
+  closure->user_data = ip;
+
+  return FFI_OK;
+}
+
+const void *
+ffi_interposer_arg_machdep (ffi_interposer_call *call, unsigned n)
+{
+  struct arg_plan *plan = call->interposer->plan;
+  const struct arg_location *loc = &plan->locs[n];
+  struct register_args *reg_args = call->regs;
+  char *a;
+  unsigned gpr = loc->gpr, sse = loc->sse;
+  int j;
+
+  if (loc->n == 0)
+    return call->stack + loc->stack;
+
+  /* As in ffi_closure_unix64_inner, an argument in one register or in
+     two integer registers can be used where it is; the rest are
+     gathered into the scratch area.  */
+  if (loc->n == 1
+      || (loc->n == 2 && !(SSE_CLASS_P (loc->classes[0])
+			   || SSE_CLASS_P (loc->classes[1]))))
+    {
+      if (SSE_CLASS_P (loc->classes[0]))
+	return &reg_args->sse[sse];
+      return &reg_args->gpr[gpr];
+    }
+
+  a = call->scratch + n * 16;
+  for (j = 0; j < loc->n; j++)
+    {
+      if (SSE_CLASS_P (loc->classes[j]))
+	memcpy (a + j * 8, &reg_args->sse[sse++], 8);
+      else
+	memcpy (a + j * 8, &reg_args->gpr[gpr++], 8);
+    }
+  return a;
+}
+
+int FFI_HIDDEN
+ffi_interpose_unix64_inner (ffi_interposer *ip, void *rvalue,
+			    struct register_args *reg_args, char *argp)
+{
+  ffi_cif *cif = ip->cif;
+  struct arg_plan *plan = ip->plan;
+  ffi_interposer_call call;
+  struct register_args *stack;
+  void *r = rvalue;
+  void **avalue = NULL;
+  int flags = cif->flags;
+  unsigned i;
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    r = (void *)(uintptr_t)reg_args->gpr[0];
+
+  call.interposer = ip;
+  call.avalue = NULL;
+  call.regs = reg_args;
+  call.stack = argp;
+  call.scratch = alloca (cif->nargs * 16 + 1);
+
+  /* Observers see the invocation of the interposer and the call of its
+     target, as with the generic interposer.  */
+  if (FFI_OBSERVING ())
+    {
+      avalue = alloca (cif->nargs * sizeof (void *) + 1);
+      for (i = 0; i < cif->nargs; i++)
+	avalue[i] = (void *) ffi_interposer_arg_machdep (&call, i);
+      ffi_observe (FFI_OBSERVE_CLOSURE_ENTER, cif, ip->fn, r, avalue);
+    }
+
+  if (ip->pre != NULL)
+    ip->pre (&call, ip->user_data);
+  if (avalue != NULL)
+    ffi_observe (FFI_OBSERVE_CALL_ENTER, cif, ip->fn, r, avalue);
+
+  /* Pass the frame on as it came in, with the hidden return pointer
+     still in %rdi.  */
+  stack = alloca (sizeof (struct register_args) + cif->bytes + 4*8);
+  memcpy (stack, reg_args, offsetof (struct register_args, rax));
+  stack->rax = plan->ssecount;
+  stack->r10 = 0;
+  memcpy (stack + 1, argp, cif->bytes);
+  ffi_call_unix64 (stack, cif->bytes + sizeof (struct register_args),
+		   flags, r, ip->fn);
+
+  if (avalue != NULL)
+    ffi_observe (FFI_OBSERVE_CALL_EXIT, cif, ip->fn, r, avalue);
+  if (ip->post != NULL)
+    ip->post (&call, r, ip->user_data);
+  if (avalue != NULL)
+    ffi_observe (FFI_OBSERVE_CLOSURE_EXIT, cif, ip->fn, r, avalue);
+
+  if (flags & UNIX64_FLAG_RET_IN_MEM)
+    {
+      *(void **)rvalue = r;
+      flags = (sizeof(void *) == 4 ? UNIX64_RET_UINT32 : UNIX64_RET_INT64);
+    }
+  return flags;
+}
+
 extern void ffi_go_closure_unix64(void) FFI_HIDDEN;
 extern void ffi_go_closure_unix64_sse(void) FFI_HIDDEN;
 
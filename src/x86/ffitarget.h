@@ -137,5 +137,28 @@ typedef enum ffi_abi {
 # define FFI_NATIVE_RAW_API 1  /* x86 has native raw api support */
 #endif
 
+#if defined (X86_64) || (defined (__x86_64__) && defined (X86_DARWIN))
+# define FFI_TARGET_HAS_COLUMN_CALL
+# define FFI_TARGET_HAS_FRAMES
+# define FFI_TARGET_HAS_PACKED_CALL
+# define FFI_TARGET_HAS_CLOSURE_ARRAY
+# define FFI_TARGET_HAS_FORWARD_CLOSURE
+# define FFI_TARGET_HAS_INTERPOSER
+# define FFI_TARGET_HAS_JAVA_RAW_PLAN
+# define FFI_TARGET_HAS_EXPLAIN
+# define FFI_TARGET_HAS_ARRAY_TYPE
+/* The variable arguments are passed as the fixed ones; the count of
+   fixed ones is only kept for ffi_explain.  */
+# define FFI_TARGET_SPECIFIC_VARIADIC 1
+# define FFI_EXTRA_CIF_FIELDS unsigned nfixedargs
+#endif
+
+/* On Linux, closure trampolines come from prebuilt pages in the text
+   segment; see closures.c.  */
+#if defined (X86_64) && defined (__linux__) && !defined (__ANDROID__) \
+    && !defined (__ILP32__)
+# define FFI_EXEC_STATIC_TRAMP 1
+#endif
+
 #endif
 
@@ -199,8 +199,15 @@ EFI64(ffi_prep_closure_loc)(ffi_closure* closure,
   if (cif->abi != FFI_WIN64)
     return FFI_BAD_ABI;
 
-  memcpy (tramp, trampoline, sizeof(trampoline));
-  *(UINT64 *)(tramp + 16) = (uintptr_t)ffi_closure_win64;
+#if FFI_EXEC_STATIC_TRAMP
+  if (ffi_tramp_is_present (codeloc))
+    ffi_tramp_set_parms (codeloc, ffi_closure_win64, closure);
+  else
+#endif
+    {
+      memcpy (tramp, trampoline, sizeof(trampoline));
+      *(UINT64 *)(tramp + 16) = (uintptr_t)ffi_closure_win64;
+    }
 
   closure->cif = cif;
   closure->fun = fun;
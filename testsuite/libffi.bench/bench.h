@@ -0,0 +1,76 @@
+/* Area:	benchmarks
+   Purpose:	Common code for the libffi microbenchmarks.
+   Originator:	libffi-riscv.  */
+
+#ifndef LIBFFI_BENCH_H
+#define LIBFFI_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ffi.h>
+
+/* Each benchmark prints one line: its name, the time per operation in
+   nanoseconds and the number of operations timed, separated by tabs.
+   The number of operations grows until one run takes at least
+   FFI_BENCH_TIME seconds, 0.2 by default.  */
+
+#define CHECK(x) \
+  do { if (!(x)) { fprintf (stderr, "%s:%d: %s\n", __FILE__, __LINE__, #x); \
+		    abort (); } } while (0)
+
+#define NOINLINE __attribute__((noinline))
+
+typedef void (*bench_fn) (void *ctx, unsigned long n);
+
+static inline double
+bench_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline double
+bench_min_time (void)
+{
+  const char *s = getenv ("FFI_BENCH_TIME");
+  double t = s != NULL ? atof (s) : 0;
+
+  return t > 0 ? t : 0.2;
+}
+
+static inline void
+bench_header (void)
+{
+  printf ("# benchmark\tns/op\toperations\n");
+}
+
+static inline void
+bench_run (const char *name, bench_fn fn, void *ctx)
+{
+  double min_time = bench_min_time (), t, t0;
+  unsigned long n = 1, grow;
+
+  for (;;)
+    {
+      t0 = bench_now ();
+      fn (ctx, n);
+      t = bench_now () - t0;
+      if (t >= min_time || n >= (1UL << 40))
+	break;
+      grow = t > 0 ? (unsigned long) (min_time / t * 1.2) + 1 : 100;
+      if (grow > 100)
+	grow = 100;
+      if (grow < 2)
+	grow = 2;
+      n *= grow;
+    }
+
+  printf ("%s\t%.2f\t%lu\n", name, t * 1e9 / n, n);
+  fflush (stdout);
+}
+
+#endif /* LIBFFI_BENCH_H */
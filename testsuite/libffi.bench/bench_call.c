@@ -0,0 +1,211 @@
+/* Area:	ffi_call
+   Purpose:	Time ffi_call for each class of signature.
+   Originator:	libffi-riscv.  */
+
+#include "bench.h"
+#include <stdarg.h>
+
+struct small
+{
+  int a, b;
+};
+
+struct huge
+{
+  long v[32];
+};
+
+struct triple
+{
+  long a, b, c;
+};
+
+static NOINLINE long f0 (void) { return 0; }
+static NOINLINE long f1 (long a) { return a; }
+static NOINLINE long f2 (long a, long b) { return a + b; }
+static NOINLINE long f3 (long a, long b, long c) { return a + b + c; }
+static NOINLINE long f4 (long a, long b, long c, long d)
+{ return a + b + c + d; }
+static NOINLINE long f5 (long a, long b, long c, long d, long e)
+{ return a + b + c + d + e; }
+static NOINLINE long f6 (long a, long b, long c, long d, long e, long f)
+{ return a + b + c + d + e + f; }
+static NOINLINE long f7 (long a, long b, long c, long d, long e, long f,
+			 long g)
+{ return a + b + c + d + e + f + g; }
+static NOINLINE long f8 (long a, long b, long c, long d, long e, long f,
+			 long g, long h)
+{ return a + b + c + d + e + f + g + h; }
+
+static void (*const int_fns[9]) (void) = {
+  FFI_FN (f0), FFI_FN (f1), FFI_FN (f2), FFI_FN (f3), FFI_FN (f4),
+  FFI_FN (f5), FFI_FN (f6), FFI_FN (f7), FFI_FN (f8)
+};
+
+static NOINLINE double mixed (int a, double b, float c, long d, double e)
+{
+  return a + b + c + d + e;
+}
+
+static NOINLINE int small_arg (struct small s)
+{
+  return s.a + s.b;
+}
+
+static NOINLINE long huge_arg (struct huge h)
+{
+  return h.v[0] + h.v[31];
+}
+
+static NOINLINE struct triple struct_ret (long a)
+{
+  struct triple t;
+
+  t.a = a;
+  t.b = a + 1;
+  t.c = a + 2;
+  return t;
+}
+
+static NOINLINE long variadic (int n, ...)
+{
+  va_list ap;
+  long r = 0;
+
+  va_start (ap, n);
+  while (n-- > 0)
+    r += va_arg (ap, long);
+  va_end (ap);
+  return r;
+}
+
+struct call
+{
+  ffi_cif cif;
+  void (*fn) (void);
+  void *rvalue;
+  void **avalue;
+};
+
+static void
+run_call (void *ctx, unsigned long n)
+{
+  struct call *c = ctx;
+
+  while (n-- > 0)
+    ffi_call (&c->cif, c->fn, c->rvalue, c->avalue);
+}
+
+int
+main (void)
+{
+  struct call c;
+  ffi_type *args[8];
+  void *values[8];
+  long l[8];
+  int i32 = 1, vn = 4;
+  double d = 2.0;
+  float f = 3.0f;
+  ffi_arg rc;
+  double rd;
+  ffi_type small_type, huge_type, triple_type;
+  ffi_type *small_elements[3], *huge_elements[33], *triple_elements[4];
+  struct small s = { 1, 2 };
+  struct huge h;
+  struct triple t;
+  char name[32];
+  unsigned i;
+
+  bench_header ();
+
+  for (i = 0; i < 8; i++)
+    {
+      args[i] = &ffi_type_slong;
+      l[i] = i;
+      values[i] = &l[i];
+    }
+  c.rvalue = &rc;
+  c.avalue = values;
+  for (i = 0; i <= 8; i++)
+    {
+      CHECK (ffi_prep_cif (&c.cif, FFI_DEFAULT_ABI, i, &ffi_type_slong, args)
+	     == FFI_OK);
+      c.fn = int_fns[i];
+      sprintf (name, "call.int%u", i);
+      bench_run (name, run_call, &c);
+    }
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_float;
+  args[3] = &ffi_type_slong;
+  args[4] = &ffi_type_double;
+  values[0] = &i32;
+  values[1] = &d;
+  values[2] = &f;
+  values[3] = &l[3];
+  values[4] = &d;
+  CHECK (ffi_prep_cif (&c.cif, FFI_DEFAULT_ABI, 5, &ffi_type_double, args)
+	 == FFI_OK);
+  c.fn = FFI_FN (mixed);
+  c.rvalue = &rd;
+  bench_run ("call.mixed_fp", run_call, &c);
+
+  small_type.size = small_type.alignment = 0;
+  small_type.type = FFI_TYPE_STRUCT;
+  small_type.elements = small_elements;
+  small_elements[0] = small_elements[1] = &ffi_type_sint;
+  small_elements[2] = NULL;
+  args[0] = &small_type;
+  values[0] = &s;
+  CHECK (ffi_prep_cif (&c.cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args)
+	 == FFI_OK);
+  c.fn = FFI_FN (small_arg);
+  c.rvalue = &rc;
+  bench_run ("call.small_struct", run_call, &c);
+
+  huge_type.size = huge_type.alignment = 0;
+  huge_type.type = FFI_TYPE_STRUCT;
+  huge_type.elements = huge_elements;
+  for (i = 0; i < 32; i++)
+    {
+      huge_elements[i] = &ffi_type_slong;
+      h.v[i] = i;
+    }
+  huge_elements[32] = NULL;
+  args[0] = &huge_type;
+  values[0] = &h;
+  CHECK (ffi_prep_cif (&c.cif, FFI_DEFAULT_ABI, 1, &ffi_type_slong, args)
+	 == FFI_OK);
+  c.fn = FFI_FN (huge_arg);
+  bench_run ("call.huge_struct", run_call, &c);
+
+  triple_type.size = triple_type.alignment = 0;
+  triple_type.type = FFI_TYPE_STRUCT;
+  triple_type.elements = triple_elements;
+  triple_elements[0] = triple_elements[1] = triple_elements[2]
+    = &ffi_type_slong;
+  triple_elements[3] = NULL;
+  args[0] = &ffi_type_slong;
+  values[0] = &l[1];
+  CHECK (ffi_prep_cif (&c.cif, FFI_DEFAULT_ABI, 1, &triple_type, args)
+	 == FFI_OK);
+  c.fn = FFI_FN (struct_ret);
+  c.rvalue = &t;
+  bench_run ("call.struct_return", run_call, &c);
+
+  args[0] = &ffi_type_sint;
+  for (i = 1; i < 5; i++)
+    {
+      args[i] = &ffi_type_slong;
+      values[i] = &l[i];
+    }
+  values[0] = &vn;
+  CHECK (ffi_prep_cif_var (&c.cif, FFI_DEFAULT_ABI, 1, 5, &ffi_type_slong,
+			   args) == FFI_OK);
+  c.fn = FFI_FN (variadic);
+  c.rvalue = &rc;
+  bench_run ("call.variadic", run_call, &c);
+
+  return 0;
+}
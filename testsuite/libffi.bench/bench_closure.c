@@ -0,0 +1,139 @@
+/* Area:	closures
+   Purpose:	Time closure invocation, and closure allocation and
+		release.
+   Originator:	libffi-riscv.  */
+
+#include "bench.h"
+
+static void
+sum_handler (ffi_cif *cif, void *rvalue, void **avalue, void *user_data)
+{
+  ffi_arg r = 0;
+  unsigned i;
+
+  for (i = 0; i < cif->nargs; i++)
+    r += *(long *) avalue[i];
+  *(ffi_arg *) rvalue = r;
+}
+
+static void
+mixed_handler (ffi_cif *cif, void *rvalue, void **avalue, void *user_data)
+{
+  *(double *) rvalue = *(int *) avalue[0] + *(double *) avalue[1]
+    + *(float *) avalue[2] + *(long *) avalue[3];
+}
+
+static void
+run_invoke2 (void *ctx, unsigned long n)
+{
+  long (*volatile fn) (long, long) = (long (*) (long, long)) ctx;
+
+  while (n-- > 0)
+    fn (1, 2);
+}
+
+static void
+run_invoke6 (void *ctx, unsigned long n)
+{
+  long (*volatile fn) (long, long, long, long, long, long)
+    = (long (*) (long, long, long, long, long, long)) ctx;
+
+  while (n-- > 0)
+    fn (1, 2, 3, 4, 5, 6);
+}
+
+static void
+run_invoke_mixed (void *ctx, unsigned long n)
+{
+  double (*volatile fn) (int, double, float, long)
+    = (double (*) (int, double, float, long)) ctx;
+
+  while (n-- > 0)
+    fn (1, 2.0, 3.0f, 4);
+}
+
+static void
+run_alloc_free (void *ctx, unsigned long n)
+{
+  ffi_cif *cif = ctx;
+  ffi_closure *cl;
+  void *code;
+
+  while (n-- > 0)
+    {
+      cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+      CHECK (cl != NULL);
+      CHECK (ffi_prep_closure_loc (cl, cif, sum_handler, NULL, code)
+	     == FFI_OK);
+      ffi_closure_free (cl);
+    }
+}
+
+#define CHURN 64
+
+static void
+run_churn (void *ctx, unsigned long n)
+{
+  ffi_cif *cif = ctx;
+  ffi_closure *cl[CHURN];
+  void *code;
+  unsigned long i, j, k;
+
+  /* Hold CHURN closures at a time, so that the allocator cannot keep
+     handing out the same block.  */
+  for (i = 0; i < n; i += k)
+    {
+      k = n - i < CHURN ? n - i : CHURN;
+      for (j = 0; j < k; j++)
+	{
+	  cl[j] = ffi_closure_alloc (sizeof (ffi_closure), &code);
+	  CHECK (cl[j] != NULL);
+	  CHECK (ffi_prep_closure_loc (cl[j], cif, sum_handler, NULL, code)
+		 == FFI_OK);
+	}
+      for (j = 0; j < k; j++)
+	ffi_closure_free (cl[j]);
+    }
+}
+
+int
+main (void)
+{
+  ffi_cif cif2, cif6, cifm;
+  ffi_type *args[6];
+  ffi_closure *cl;
+  void *code;
+  unsigned i;
+
+  bench_header ();
+
+  for (i = 0; i < 6; i++)
+    args[i] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif2, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+  CHECK (ffi_prep_cif (&cif6, FFI_DEFAULT_ABI, 6, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &cif2, sum_handler, NULL, code) == FFI_OK);
+  bench_run ("closure.invoke_int2", run_invoke2, code);
+  CHECK (ffi_prep_closure_loc (cl, &cif6, sum_handler, NULL, code) == FFI_OK);
+  bench_run ("closure.invoke_int6", run_invoke6, code);
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_float;
+  args[3] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cifm, FFI_DEFAULT_ABI, 4, &ffi_type_double, args)
+	 == FFI_OK);
+  CHECK (ffi_prep_closure_loc (cl, &cifm, mixed_handler, NULL, code)
+	 == FFI_OK);
+  bench_run ("closure.invoke_mixed_fp", run_invoke_mixed, code);
+  ffi_closure_free (cl);
+
+  bench_run ("closure.alloc_free", run_alloc_free, &cif2);
+  bench_run ("closure.alloc_free_64", run_churn, &cif2);
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+/* Area:	ffi_prep_cif
+   Purpose:	Time cif preparation for scalar and nested structure
+		signatures.
+   Originator:	libffi-riscv.  */
+
+#include "bench.h"
+
+struct prep
+{
+  ffi_cif cif;
+  unsigned nargs;
+  ffi_type *rtype;
+  ffi_type **args;
+  /* Structure types whose layout is computed again on every
+     preparation, innermost first.  */
+  ffi_type **reset;
+  unsigned nreset;
+};
+
+static void
+run_prep (void *ctx, unsigned long n)
+{
+  struct prep *p = ctx;
+  unsigned i;
+
+  while (n-- > 0)
+    {
+      for (i = 0; i < p->nreset; i++)
+	p->reset[i]->size = p->reset[i]->alignment = 0;
+      CHECK (ffi_prep_cif (&p->cif, FFI_DEFAULT_ABI, p->nargs, p->rtype,
+			   p->args) == FFI_OK);
+    }
+}
+
+static void
+init_struct (ffi_type *t, ffi_type **elements)
+{
+  t->size = t->alignment = 0;
+  t->type = FFI_TYPE_STRUCT;
+  t->elements = elements;
+}
+
+int
+main (void)
+{
+  struct prep p;
+  ffi_type *args[8];
+  ffi_type inner, middle, outer;
+  ffi_type *inner_elements[3], *middle_elements[4], *outer_elements[4];
+  ffi_type *reset[3];
+  unsigned i;
+
+  bench_header ();
+
+  for (i = 0; i < 8; i++)
+    args[i] = &ffi_type_slong;
+  p.nargs = 8;
+  p.rtype = &ffi_type_slong;
+  p.args = args;
+  p.nreset = 0;
+  bench_run ("prep.int8", run_prep, &p);
+
+  /* struct outer { struct middle { char; struct inner; short; } x2;
+     float; } */
+  init_struct (&inner, inner_elements);
+  inner_elements[0] = &ffi_type_schar;
+  inner_elements[1] = &ffi_type_double;
+  inner_elements[2] = NULL;
+  init_struct (&middle, middle_elements);
+  middle_elements[0] = &ffi_type_schar;
+  middle_elements[1] = &inner;
+  middle_elements[2] = &ffi_type_sshort;
+  middle_elements[3] = NULL;
+  init_struct (&outer, outer_elements);
+  outer_elements[0] = &middle;
+  outer_elements[1] = &middle;
+  outer_elements[2] = &ffi_type_float;
+  outer_elements[3] = NULL;
+
+  args[0] = &outer;
+  args[1] = &ffi_type_sint;
+  args[2] = &middle;
+  p.nargs = 3;
+  p.rtype = &outer;
+  bench_run ("prep.nested_struct_cached", run_prep, &p);
+
+  reset[0] = &inner;
+  reset[1] = &middle;
+  reset[2] = &outer;
+  p.reset = reset;
+  p.nreset = 3;
+  bench_run ("prep.nested_struct", run_prep, &p);
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/* Area:	call traces
+   Purpose:	Replay a trace recorded with ffi_trace_start against stub
+		callees.  The trace is named on the command line or in
+		FFI_BENCH_TRACE; without one, a small mix of calls and
+		closure invocations is recorded first.
+   Originator:	libffi-riscv.  */
+
+#include "bench.h"
+#include <unistd.h>
+
+struct pair
+{
+  double d;
+  int i;
+};
+
+static NOINLINE long
+add (long a, long b)
+{
+  return a + b;
+}
+
+static NOINLINE struct pair
+make_pair (double d, int i)
+{
+  struct pair p;
+
+  p.d = d;
+  p.i = i;
+  return p;
+}
+
+static void
+twice_handler (ffi_cif *cif, void *rvalue, void **avalue, void *user_data)
+{
+  *(double *) rvalue = *(double *) avalue[0] * 2;
+}
+
+/* Record a mix of three calls and a closure invocation to PATH.  */
+static void
+record (const char *path)
+{
+  ffi_cif add_cif, pair_cif, twice_cif;
+  ffi_type *add_args[2], *pair_args[2], *twice_args[1];
+  ffi_type pair_type;
+  ffi_type *pair_elements[3];
+  void *values[2];
+  ffi_closure *cl;
+  double (*twice) (double);
+  struct pair p;
+  void *code;
+  long a = 1, b = 2;
+  double d = 0.5;
+  int i = 3, n;
+  ffi_arg rc;
+
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_double;
+  pair_elements[1] = &ffi_type_sint;
+  pair_elements[2] = NULL;
+
+  add_args[0] = add_args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&add_cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong,
+		       add_args) == FFI_OK);
+  pair_args[0] = &ffi_type_double;
+  pair_args[1] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&pair_cif, FFI_DEFAULT_ABI, 2, &pair_type,
+		       pair_args) == FFI_OK);
+  twice_args[0] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&twice_cif, FFI_DEFAULT_ABI, 1, &ffi_type_double,
+		       twice_args) == FFI_OK);
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &twice_cif, twice_handler, NULL, code)
+	 == FFI_OK);
+  twice = (double (*) (double)) code;
+
+  CHECK (ffi_trace_start (path, FFI_TRACE_ARGS) == FFI_OK);
+  for (n = 0; n < 100; n++)
+    {
+      values[0] = &a;
+      values[1] = &b;
+      ffi_call (&add_cif, FFI_FN (add), &rc, values);
+      if (n % 4 == 0)
+	{
+	  values[0] = &d;
+	  values[1] = &i;
+	  ffi_call (&pair_cif, FFI_FN (make_pair), &p, values);
+	}
+      if (n % 2 == 0)
+	twice (d);
+    }
+  CHECK (ffi_trace_stop () == FFI_OK);
+  ffi_closure_free (cl);
+}
+
+static void
+run_replay (void *ctx, unsigned long n)
+{
+  while (n-- > 0)
+    ffi_trace_replay (ctx);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : getenv ("FFI_BENCH_TRACE");
+  char tmp[64], name[64];
+  ffi_trace *trace;
+  size_t events;
+
+  if (path == NULL)
+    {
+      sprintf (tmp, "/tmp/ffi-bench-trace-%d", (int) getpid ());
+      record (tmp);
+      path = tmp;
+    }
+
+  trace = ffi_trace_load (path);
+  if (path == tmp)
+    unlink (tmp);
+  if (trace == NULL)
+    {
+      fprintf (stderr, "%s: cannot load trace %s\n", argv[0], path);
+      return 1;
+    }
+
+  /* One operation is one pass over the whole trace.  */
+  events = ffi_trace_replay (trace);
+  snprintf (name, sizeof (name), "replay/%lu-events", (unsigned long) events);
+  bench_header ();
+  bench_run (name, run_replay, trace);
+
+  ffi_trace_free (trace);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/* Area:	closures, ffi_prep_cif
+   Purpose:	Measure how closure allocation, preparation, invocation
+		and release, and cif preparation on shared structure
+		types, scale with the number of threads.
+   Originator:	libffi-riscv.  */
+
+#include "bench.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/* Each benchmark runs with 1, 2, 4, ... threads up to the number of
+   processors, or FFI_BENCH_THREADS, for FFI_BENCH_TIME seconds.  It
+   prints the name, the number of threads, the total throughput in
+   millions of operations per second and the time per operation seen
+   by each thread.  */
+
+enum kind
+{
+  LIFECYCLE,
+  INVOKE,
+  PREP
+};
+
+struct shared
+{
+  enum kind kind;
+  ffi_cif cif;
+  ffi_type *struct_args[3];
+  pthread_barrier_t start;
+  int stop;
+};
+
+struct worker
+{
+  pthread_t thread;
+  struct shared *shared;
+  unsigned long ops;
+};
+
+static ffi_type inner, outer;
+static ffi_type *inner_elements[3], *outer_elements[4];
+
+static void
+sum_handler (ffi_cif *cif, void *rvalue, void **avalue, void *user_data)
+{
+  *(ffi_arg *) rvalue = *(long *) avalue[0] + *(long *) avalue[1];
+}
+
+static void *
+work (void *arg)
+{
+  struct worker *w = arg;
+  struct shared *s = w->shared;
+  ffi_closure *cl = NULL;
+  long (*fn) (long, long);
+  ffi_cif cif;
+  void *code;
+  unsigned long ops = 0;
+  unsigned i;
+
+  if (s->kind == INVOKE)
+    {
+      cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+      CHECK (cl != NULL);
+      CHECK (ffi_prep_closure_loc (cl, &s->cif, sum_handler, NULL, code)
+	     == FFI_OK);
+    }
+
+  pthread_barrier_wait (&s->start);
+  while (!__atomic_load_n (&s->stop, __ATOMIC_RELAXED))
+    {
+      /* Check the flag every few operations only.  */
+      for (i = 0; i < 16; i++)
+	switch (s->kind)
+	  {
+	  case LIFECYCLE:
+	    cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+	    CHECK (cl != NULL);
+	    CHECK (ffi_prep_closure_loc (cl, &s->cif, sum_handler, NULL, code)
+		   == FFI_OK);
+	    fn = (long (*) (long, long)) code;
+	    CHECK (fn (1, 2) == 3);
+	    ffi_closure_free (cl);
+	    break;
+	  case INVOKE:
+	    fn = (long (*) (long, long)) code;
+	    CHECK (fn (1, 2) == 3);
+	    break;
+	  case PREP:
+	    CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &outer,
+				 s->struct_args) == FFI_OK);
+	    break;
+	  }
+      ops += 16;
+    }
+
+  if (s->kind == INVOKE)
+    ffi_closure_free (cl);
+  w->ops = ops;
+  return NULL;
+}
+
+static void
+run_threads (const char *name, struct shared *s, unsigned nthreads)
+{
+  struct worker *w = calloc (nthreads, sizeof (struct worker));
+  double t0, t;
+  unsigned long ops = 0;
+  unsigned i;
+
+  CHECK (w != NULL);
+  s->stop = 0;
+  CHECK (pthread_barrier_init (&s->start, NULL, nthreads + 1) == 0);
+  if (s->kind == PREP)
+    {
+      /* Let the threads race to lay out the shared types.  */
+      inner.size = inner.alignment = 0;
+      outer.size = outer.alignment = 0;
+    }
+  for (i = 0; i < nthreads; i++)
+    {
+      w[i].shared = s;
+      CHECK (pthread_create (&w[i].thread, NULL, work, &w[i]) == 0);
+    }
+
+  pthread_barrier_wait (&s->start);
+  t0 = bench_now ();
+  while (bench_now () - t0 < bench_min_time ())
+    usleep (1000);
+  __atomic_store_n (&s->stop, 1, __ATOMIC_RELAXED);
+  for (i = 0; i < nthreads; i++)
+    {
+      CHECK (pthread_join (w[i].thread, NULL) == 0);
+      ops += w[i].ops;
+    }
+  t = bench_now () - t0;
+  pthread_barrier_destroy (&s->start);
+  free (w);
+
+  printf ("%s\t%u\t%.2f\t%.2f\n", name, nthreads, ops / t * 1e-6,
+	  t * 1e9 * nthreads / ops);
+  fflush (stdout);
+}
+
+static void
+run_all (const char *name, struct shared *s, unsigned max_threads)
+{
+  unsigned n;
+
+  for (n = 1; n < max_threads; n *= 2)
+    run_threads (name, s, n);
+  run_threads (name, s, max_threads);
+}
+
+int
+main (void)
+{
+  static struct shared s;
+  ffi_type *args[2];
+  const char *env = getenv ("FFI_BENCH_THREADS");
+  long max_threads = env != NULL ? atol (env) : sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (max_threads < 1)
+    max_threads = 1;
+
+  printf ("# benchmark\tthreads\tMops/s\tns/op per thread\n");
+
+  args[0] = args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&s.cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  s.kind = LIFECYCLE;
+  run_all ("threads.closure_lifecycle", &s, max_threads);
+  s.kind = INVOKE;
+  run_all ("threads.closure_invoke", &s, max_threads);
+
+  /* struct outer { struct inner { char; double; }; short; struct inner; } */
+  inner.type = FFI_TYPE_STRUCT;
+  inner.elements = inner_elements;
+  inner_elements[0] = &ffi_type_schar;
+  inner_elements[1] = &ffi_type_double;
+  inner_elements[2] = NULL;
+  outer.type = FFI_TYPE_STRUCT;
+  outer.elements = outer_elements;
+  outer_elements[0] = &inner;
+  outer_elements[1] = &ffi_type_sshort;
+  outer_elements[2] = &inner;
+  outer_elements[3] = NULL;
+  s.struct_args[0] = &outer;
+  s.struct_args[1] = &ffi_type_sint;
+  s.struct_args[2] = &inner;
+  s.kind = PREP;
+  run_all ("threads.prep_shared_struct", &s, max_threads);
+
+  return 0;
+}
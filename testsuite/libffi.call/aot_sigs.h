@@ -0,0 +1,123 @@
+/* Generated by aot.py from call_aot.sigs.  Do not edit.  */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ffi.h>
+
+struct aot_sigs_pair {
+  double f0;
+  int32_t f1;
+};
+static ffi_type *aot_sigs_pair_elements[] = { &ffi_type_double, &ffi_type_sint32, NULL };
+static ffi_type aot_sigs_pair_type = { 0, 0, FFI_TYPE_STRUCT, aot_sigs_pair_elements };
+
+/* sint64 (sint64, sint64) */
+static ffi_type *aot_sigs_0_args[] = { &ffi_type_sint64, &ffi_type_sint64, NULL };
+static void
+aot_sigs_0_call (void (*fn) (void), void *rvalue, void **avalue)
+{
+  int64_t r = ((int64_t (*) (int64_t, int64_t)) fn) (*(int64_t *) avalue[0], *(int64_t *) avalue[1]);
+  if (rvalue != NULL)
+    *(int64_t *) rvalue = r;
+}
+
+/* uint8 (uint8, sint16) closures=1 */
+static ffi_type *aot_sigs_1_args[] = { &ffi_type_uint8, &ffi_type_sint16, NULL };
+static void
+aot_sigs_1_call (void (*fn) (void), void *rvalue, void **avalue)
+{
+  uint8_t r = ((uint8_t (*) (uint8_t, int16_t)) fn) (*(uint8_t *) avalue[0], *(int16_t *) avalue[1]);
+  if (rvalue != NULL)
+    *(ffi_arg *) rvalue = r;
+}
+
+static ffi_aot_closure aot_sigs_1_closures[1];
+
+static uint8_t
+aot_sigs_1_entry_0 (uint8_t a0, int16_t a1)
+{
+  ffi_aot_closure *c = &aot_sigs_1_closures[0];
+  void *avalue[2];
+  ffi_arg r;
+
+  avalue[0] = &a0;
+  avalue[1] = &a1;
+  c->fun (c->cif, &r, avalue, c->user_data);
+  return r;
+}
+
+static void (*const aot_sigs_1_entries[]) (void) = {
+  (void (*) (void)) aot_sigs_1_entry_0,
+};
+
+/* pair (pair, double) closures=2 */
+static ffi_type *aot_sigs_2_args[] = { &aot_sigs_pair_type, &ffi_type_double, NULL };
+static void
+aot_sigs_2_call (void (*fn) (void), void *rvalue, void **avalue)
+{
+  struct aot_sigs_pair r = ((struct aot_sigs_pair (*) (struct aot_sigs_pair, double)) fn) (*(struct aot_sigs_pair *) avalue[0], *(double *) avalue[1]);
+  if (rvalue != NULL)
+    *(struct aot_sigs_pair *) rvalue = r;
+}
+
+static ffi_aot_closure aot_sigs_2_closures[2];
+
+static struct aot_sigs_pair
+aot_sigs_2_entry_0 (struct aot_sigs_pair a0, double a1)
+{
+  ffi_aot_closure *c = &aot_sigs_2_closures[0];
+  void *avalue[2];
+  struct aot_sigs_pair r;
+
+  avalue[0] = &a0;
+  avalue[1] = &a1;
+  c->fun (c->cif, &r, avalue, c->user_data);
+  return r;
+}
+
+static struct aot_sigs_pair
+aot_sigs_2_entry_1 (struct aot_sigs_pair a0, double a1)
+{
+  ffi_aot_closure *c = &aot_sigs_2_closures[1];
+  void *avalue[2];
+  struct aot_sigs_pair r;
+
+  avalue[0] = &a0;
+  avalue[1] = &a1;
+  c->fun (c->cif, &r, avalue, c->user_data);
+  return r;
+}
+
+static void (*const aot_sigs_2_entries[]) (void) = {
+  (void (*) (void)) aot_sigs_2_entry_0,
+  (void (*) (void)) aot_sigs_2_entry_1,
+};
+
+/* void (pointer, float) */
+static ffi_type *aot_sigs_3_args[] = { &ffi_type_pointer, &ffi_type_float, NULL };
+static void
+aot_sigs_3_call (void (*fn) (void), void *rvalue, void **avalue)
+{
+  ((void (*) (void *, float)) fn) (*(void **) avalue[0], *(float *) avalue[1]);
+}
+
+const ffi_aot_signature aot_sigs_signatures[] = {
+  { FFI_DEFAULT_ABI, 2, &ffi_type_sint64, aot_sigs_0_args, aot_sigs_0_call, 0, NULL, NULL },
+  { FFI_DEFAULT_ABI, 2, &ffi_type_uint8, aot_sigs_1_args, aot_sigs_1_call, 1, aot_sigs_1_closures, aot_sigs_1_entries },
+  { FFI_DEFAULT_ABI, 2, &aot_sigs_pair_type, aot_sigs_2_args, aot_sigs_2_call, 2, aot_sigs_2_closures, aot_sigs_2_entries },
+  { FFI_DEFAULT_ABI, 2, &ffi_type_void, aot_sigs_3_args, aot_sigs_3_call, 0, NULL, NULL },
+};
+
+ffi_status
+aot_sigs_register (void)
+{
+  return ffi_aot_register (aot_sigs_signatures, 4);
+}
+
+#if defined (__GNUC__) && !defined (FFI_AOT_NO_CONSTRUCTOR)
+static void __attribute__ ((constructor))
+aot_sigs_init (void)
+{
+  aot_sigs_register ();
+}
+#endif
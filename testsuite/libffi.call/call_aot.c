@@ -0,0 +1,241 @@
+/* Area:		ffi_aot_register, ffi_aot_closure_alloc
+   Purpose:		Check that cifs matching a precompiled signature are
+			called through its thunk, and that precompiled
+			closures work.  aot_sigs.h is generated from
+			call_aot.sigs by src/riscv/aot.py.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define FFI_AOT_NO_CONSTRUCTOR
+#include "aot_sigs.h"
+
+static int thunk_calls;
+
+static void
+half_call (void (*fn) (void), void *rvalue, void **avalue)
+{
+  thunk_calls++;
+  *(double *) rvalue = ((double (*) (double)) fn) (*(double *) avalue[0]);
+}
+
+static ffi_type *half_args[] = { &ffi_type_double, NULL };
+
+static const ffi_aot_signature half_signature[] = {
+  { FFI_DEFAULT_ABI, 1, &ffi_type_double, half_args, half_call, 0, NULL, NULL }
+};
+
+static double half (double d)
+{
+  return d / 2;
+}
+
+static double vhalf (double d, ...)
+{
+  return d / 2;
+}
+
+static float halff (float f)
+{
+  return f / 2;
+}
+
+static int64_t add (int64_t a, int64_t b)
+{
+  return a + b;
+}
+
+static struct aot_sigs_pair scale (struct aot_sigs_pair p, double d)
+{
+  p.f0 *= d;
+  p.f1 += 1;
+  return p;
+}
+
+static void mix_handler (ffi_cif *cif, void *rvalue, void **avalue,
+			 void *user_data)
+{
+  (void) cif;
+  *(ffi_arg *) rvalue = (uint8_t) (*(uint8_t *) avalue[0]
+				   + *(int16_t *) avalue[1]
+				   + *(int *) user_data);
+}
+
+static void scale_handler (ffi_cif *cif, void *rvalue, void **avalue,
+			   void *user_data)
+{
+  (void) user_data;
+  ffi_call (cif, FFI_FN (scale), rvalue, avalue);
+}
+
+int main (void)
+{
+  ffi_cif cif, pair_cif;
+  ffi_type *args[2];
+  void *values[2];
+  ffi_aot_closure *c1, *c2;
+  ffi_cif *early;
+  void *code1, *code2;
+  double d, dr;
+  float f, fr;
+  int64_t a, b, r64;
+  uint8_t u8;
+  int16_t s16;
+  ffi_arg rc;
+  int bias = 3;
+  struct aot_sigs_pair p, pr;
+
+  /* Nothing is precompiled yet.  */
+  args[0] = &ffi_type_uint8;
+  args[1] = &ffi_type_sint16;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_uint8, args)
+	 == FFI_OK);
+  CHECK (ffi_aot_closure_alloc (&cif, mix_handler, &bias, &code1) == NULL);
+
+  /* A variadic cif prepared before any signature was registered.  */
+  args[0] = &ffi_type_double;
+  early = malloc (sizeof (ffi_cif));
+  CHECK (early != NULL);
+  CHECK (ffi_prep_cif_var (early, FFI_DEFAULT_ABI, 1, 1, &ffi_type_double,
+			   args) == FFI_OK);
+
+  CHECK (ffi_aot_register (half_signature, 1) == FFI_OK);
+
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_double, args)
+	 == FFI_OK);
+  d = 5;
+  values[0] = &d;
+  ffi_call (&cif, FFI_FN (half), &dr, values);
+  CHECK (dr == 2.5 && thunk_calls == 1);
+
+  /* Variadic cifs keep the generic path.  */
+  CHECK (ffi_prep_cif_var (&cif, FFI_DEFAULT_ABI, 1, 1, &ffi_type_double,
+			   args) == FFI_OK);
+  ffi_call (&cif, FFI_FN (vhalf), &dr, values);
+  CHECK (dr == 2.5 && thunk_calls == 1);
+
+  /* So does a cif prepared again for another signature.  */
+  args[0] = &ffi_type_float;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_float, args)
+	 == FFI_OK);
+  f = 3;
+  values[0] = &f;
+  ffi_call (&cif, FFI_FN (halff), &fr, values);
+  CHECK (fr == 1.5f && thunk_calls == 1);
+
+  /* Cifs that share a cache slot each keep their thunk: two cifs
+     16 KiB apart, and more cifs than the cache has room for.  */
+  {
+    enum { NCIFS = 8192 };
+    char *block = malloc (16384 + sizeof (ffi_cif));
+    ffi_cif *cifs = malloc (NCIFS * sizeof (ffi_cif));
+    ffi_cif *pair[2];
+    int i;
+
+    CHECK (block != NULL && cifs != NULL);
+    pair[0] = (ffi_cif *) block;
+    pair[1] = (ffi_cif *) (block + 16384);
+    args[0] = &ffi_type_double;
+    d = 5;
+    values[0] = &d;
+    thunk_calls = 0;
+    for (i = 0; i < 2; i++)
+      CHECK (ffi_prep_cif (pair[i], FFI_DEFAULT_ABI, 1, &ffi_type_double,
+			   args) == FFI_OK);
+    for (i = 0; i < NCIFS; i++)
+      CHECK (ffi_prep_cif (&cifs[i], FFI_DEFAULT_ABI, 1, &ffi_type_double,
+			   args) == FFI_OK);
+    for (i = 0; i < 2; i++)
+      {
+	dr = 0;
+	ffi_call (pair[i], FFI_FN (half), &dr, values);
+	CHECK (dr == 2.5 && thunk_calls == i + 1);
+      }
+    for (i = 0; i < NCIFS; i++)
+      ffi_call (&cifs[i], FFI_FN (half), &dr, values);
+    CHECK (thunk_calls == NCIFS + 2);
+
+    /* None of them may use it once prepared as variadic.  */
+    for (i = 0; i < NCIFS; i++)
+      {
+	CHECK (ffi_prep_cif_var (&cifs[i], FFI_DEFAULT_ABI, 1, 1,
+				 &ffi_type_double, args) == FFI_OK);
+	dr = 0;
+	ffi_call (&cifs[i], FFI_FN (vhalf), &dr, values);
+	CHECK (dr == 2.5);
+      }
+    CHECK (thunk_calls == NCIFS + 2);
+
+    /* Nor may a cif that was never bound, whatever its slot holds.  */
+    dr = 0;
+    ffi_call (early, FFI_FN (vhalf), &dr, values);
+    CHECK (dr == 2.5 && thunk_calls == NCIFS + 2);
+    free (early);
+    free (cifs);
+    free (block);
+    thunk_calls = 1;
+  }
+
+  /* The generated signatures.  */
+  CHECK (aot_sigs_register () == FFI_OK);
+
+  args[0] = args[1] = &ffi_type_sint64;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_sint64, args)
+	 == FFI_OK);
+  a = 1LL << 40;
+  b = -7;
+  values[0] = &a;
+  values[1] = &b;
+  ffi_call (&cif, FFI_FN (add), &r64, values);
+  CHECK (r64 == (1LL << 40) - 7);
+
+  args[0] = &ffi_type_uint8;
+  args[1] = &ffi_type_sint16;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_uint8, args)
+	 == FFI_OK);
+  c1 = ffi_aot_closure_alloc (&cif, mix_handler, &bias, &code1);
+  CHECK (c1 != NULL);
+  CHECK (ffi_aot_closure_alloc (&cif, mix_handler, &bias, &code2) == NULL);
+  CHECK (((uint8_t (*) (uint8_t, int16_t)) code1) (250, 4) == 1);
+
+  u8 = 10;
+  s16 = -2;
+  values[0] = &u8;
+  values[1] = &s16;
+  ffi_call (&cif, FFI_FN (code1), &rc, values);
+  CHECK ((uint8_t) rc == 11);
+  ffi_aot_closure_free (c1);
+  CHECK ((c1 = ffi_aot_closure_alloc (&cif, mix_handler, &bias, &code1))
+	 != NULL);
+  ffi_aot_closure_free (c1);
+
+  /* Structures match by their layout, not their ffi_type.  */
+  {
+    ffi_type pair_type;
+    ffi_type *pair_elements[3] = { &ffi_type_double, &ffi_type_sint32, NULL };
+
+    pair_type.size = pair_type.alignment = 0;
+    pair_type.type = FFI_TYPE_STRUCT;
+    pair_type.elements = pair_elements;
+    args[0] = &pair_type;
+    args[1] = &ffi_type_double;
+    CHECK (ffi_prep_cif (&pair_cif, FFI_DEFAULT_ABI, 2, &pair_type, args)
+	   == FFI_OK);
+    c1 = ffi_aot_closure_alloc (&pair_cif, scale_handler, NULL, &code1);
+    c2 = ffi_aot_closure_alloc (&pair_cif, scale_handler, NULL, &code2);
+    CHECK (c1 != NULL && c2 != NULL && code1 != code2);
+
+    p.f0 = 1.5;
+    p.f1 = 41;
+    pr = ((struct aot_sigs_pair (*) (struct aot_sigs_pair, double)) code2)
+      (p, 4);
+    CHECK (pr.f0 == 6 && pr.f1 == 42);
+    ffi_aot_closure_free (c1);
+    ffi_aot_closure_free (c2);
+  }
+
+  exit (0);
+}
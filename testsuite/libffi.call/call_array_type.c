@@ -0,0 +1,170 @@
+/* Area:		ffi_prep_array_type, FFI_TYPE_ARRAY
+   Purpose:		Check that structures holding fixed-size arrays are
+			laid out and passed as the compiler does.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <stddef.h>
+
+struct vec
+{
+  float v[2];
+};
+
+struct pt
+{
+  int x, y;
+};
+
+struct segment
+{
+  struct pt p[2];
+};
+
+struct record
+{
+  char name[256];
+  double vals[64];
+  short tag;
+};
+
+static struct vec scale (struct vec a, float f)
+{
+  a.v[0] *= f;
+  a.v[1] *= f;
+  return a;
+}
+
+static struct segment flip (struct segment s)
+{
+  struct pt t = s.p[0];
+
+  s.p[0] = s.p[1];
+  s.p[1] = t;
+  return s;
+}
+
+static double total (struct record r)
+{
+  double sum = r.tag;
+  int i;
+
+  for (i = 0; i < 64; i++)
+    sum += r.vals[i];
+  return sum + r.name[255];
+}
+
+int main (void)
+{
+#ifdef FFI_TARGET_HAS_ARRAY_TYPE
+  ffi_array_type float2 = FFI_ARRAY_TYPE_INIT (float2, &ffi_type_float, 2);
+  ffi_array_type chars, doubles, pts;
+  ffi_type vec_type, pt_type, seg_type, rec_type;
+  ffi_type *vec_elts[2], *pt_elts[3], *seg_elts[2], *rec_elts[4];
+  ffi_type *args[2];
+  void *values[2];
+  size_t offsets[3];
+  ffi_cif cif;
+  struct vec v, vr;
+  struct segment s, sr;
+  struct record r;
+  float f;
+  double d;
+  int i;
+
+  vec_type.size = vec_type.alignment = 0;
+  vec_type.type = FFI_TYPE_STRUCT;
+  vec_type.elements = vec_elts;
+  vec_elts[0] = &float2.type;
+  vec_elts[1] = NULL;
+
+  pt_type.size = pt_type.alignment = 0;
+  pt_type.type = FFI_TYPE_STRUCT;
+  pt_type.elements = pt_elts;
+  pt_elts[0] = pt_elts[1] = &ffi_type_sint;
+  pt_elts[2] = NULL;
+  CHECK (ffi_prep_array_type (&pts, &pt_type, 2) == FFI_OK);
+  seg_type.size = seg_type.alignment = 0;
+  seg_type.type = FFI_TYPE_STRUCT;
+  seg_type.elements = seg_elts;
+  seg_elts[0] = &pts.type;
+  seg_elts[1] = NULL;
+
+  CHECK (ffi_prep_array_type (&chars, &ffi_type_schar, 256) == FFI_OK);
+  CHECK (ffi_prep_array_type (&doubles, &ffi_type_double, 64) == FFI_OK);
+  rec_type.size = rec_type.alignment = 0;
+  rec_type.type = FFI_TYPE_STRUCT;
+  rec_type.elements = rec_elts;
+  rec_elts[0] = &chars.type;
+  rec_elts[1] = &doubles.type;
+  rec_elts[2] = &ffi_type_sshort;
+  rec_elts[3] = NULL;
+
+  /* Layout.  */
+  CHECK (ffi_get_struct_offsets (FFI_DEFAULT_ABI, &rec_type, offsets)
+	 == FFI_OK);
+  CHECK (rec_type.size == sizeof (struct record));
+  CHECK (rec_type.alignment == __alignof__ (struct record));
+  CHECK (offsets[0] == offsetof (struct record, name));
+  CHECK (offsets[1] == offsetof (struct record, vals));
+  CHECK (offsets[2] == offsetof (struct record, tag));
+  CHECK (doubles.type.size == sizeof (r.vals));
+
+  /* A small array of floats travels in registers.  */
+  args[0] = &vec_type;
+  args[1] = &ffi_type_float;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &vec_type, args) == FFI_OK);
+  CHECK (vec_type.size == sizeof (struct vec));
+  v.v[0] = 1.5f;
+  v.v[1] = -2.0f;
+  f = 3.0f;
+  values[0] = &v;
+  values[1] = &f;
+  ffi_call (&cif, FFI_FN (scale), &vr, values);
+  CHECK (vr.v[0] == 4.5f && vr.v[1] == -6.0f);
+
+  /* So does a small array of structures.  */
+  args[0] = &seg_type;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &seg_type, args) == FFI_OK);
+  CHECK (seg_type.size == sizeof (struct segment));
+  s.p[0].x = 1;
+  s.p[0].y = 2;
+  s.p[1].x = 3;
+  s.p[1].y = 4;
+  values[0] = &s;
+  ffi_call (&cif, FFI_FN (flip), &sr, values);
+  CHECK (sr.p[0].x == 3 && sr.p[0].y == 4 && sr.p[1].x == 1 && sr.p[1].y == 2);
+
+  /* A large one goes in memory.  */
+  args[0] = &rec_type;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_double, args)
+	 == FFI_OK);
+  memset (&r, 0, sizeof (r));
+  for (i = 0; i < 64; i++)
+    r.vals[i] = i;
+  r.name[255] = 7;
+  r.tag = 100;
+  values[0] = &r;
+  ffi_call (&cif, FFI_FN (total), &d, values);
+  CHECK (d == 2016 + 7 + 100);
+
+  /* Arrays are never arguments or results themselves.  */
+  CHECK (ffi_prep_array_type (&chars, &ffi_type_void, 4) == FFI_BAD_TYPEDEF);
+  CHECK (ffi_prep_array_type (&chars, &ffi_type_schar, 0) == FFI_BAD_TYPEDEF);
+  CHECK (ffi_prep_array_type (&chars, &ffi_type_schar, 4) == FFI_OK);
+  args[0] = &chars.type;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_void, args)
+	 == FFI_BAD_TYPEDEF);
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 0, &chars.type, NULL)
+	 == FFI_BAD_TYPEDEF);
+#else
+  ffi_array_type chars;
+
+  CHECK (ffi_prep_array_type (&chars, &ffi_type_schar, 4) == FFI_BAD_TYPEDEF);
+#endif
+
+  exit (0);
+}
@@ -0,0 +1,137 @@
+/* Area:		ffi_cif_cache_open, ffi_prep_cif_cached,
+			ffi_cif_cache_save
+   Purpose:		Check that prepared cifs saved to a cache file are
+			loaded again instead of being prepared.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <unistd.h>
+
+struct tagged
+{
+  char tag;
+  double d;
+  int i;
+};
+
+static struct tagged bump (struct tagged t, int n)
+{
+  t.tag += n;
+  t.d += n;
+  t.i += n;
+  return t;
+}
+
+static double mix (float f, long long l)
+{
+  return (double) f + l;
+}
+
+static void init_tagged (ffi_type *type, ffi_type **elements)
+{
+  type->size = type->alignment = 0;
+  type->type = FFI_TYPE_STRUCT;
+  type->elements = elements;
+  elements[0] = &ffi_type_schar;
+  elements[1] = &ffi_type_double;
+  elements[2] = &ffi_type_sint;
+  elements[3] = NULL;
+}
+
+/* Prepare both signatures from CACHE and check that calls work.  */
+static void prep_and_call (ffi_cif_cache *cache, ffi_cif *tagged_cif,
+			   ffi_cif *mix_cif, ffi_type *tagged_type)
+{
+  static ffi_type *tagged_args[2], *mix_args[2];
+  struct tagged t, r;
+  void *values[2];
+  float f = 1.5f;
+  long long l = 1LL << 33;
+  int n = 2;
+  double d;
+
+  tagged_args[0] = tagged_type;
+  tagged_args[1] = &ffi_type_sint;
+  CHECK (ffi_prep_cif_cached (cache, tagged_cif, FFI_DEFAULT_ABI, 2,
+			      tagged_type, tagged_args) == FFI_OK);
+  mix_args[0] = &ffi_type_float;
+  mix_args[1] = &ffi_type_sint64;
+  CHECK (ffi_prep_cif_cached (cache, mix_cif, FFI_DEFAULT_ABI, 2,
+			      &ffi_type_double, mix_args) == FFI_OK);
+
+  CHECK (tagged_type->size == sizeof (struct tagged));
+  CHECK (tagged_type->alignment == __alignof__ (struct tagged));
+
+  t.tag = 'a';
+  t.d = 0.5;
+  t.i = 40;
+  values[0] = &t;
+  values[1] = &n;
+  ffi_call (tagged_cif, FFI_FN (bump), &r, values);
+  CHECK (r.tag == 'c' && r.d == 2.5 && r.i == 42);
+
+  values[0] = &f;
+  values[1] = &l;
+  ffi_call (mix_cif, FFI_FN (mix), &d, values);
+  CHECK (d == 1.5 + (1LL << 33));
+}
+
+int main (void)
+{
+  ffi_cif_cache *cache;
+  ffi_cif tagged_cif, mix_cif, cif;
+  ffi_type tagged_type, *tagged_elements[4], *args[1];
+  char path[64];
+  size_t hits, misses;
+  FILE *f;
+
+  sprintf (path, "/tmp/ffi-cif-cache-%d", (int) getpid ());
+  unlink (path);
+
+  /* A missing file gives an empty cache.  */
+  cache = ffi_cif_cache_open (path);
+  CHECK (cache != NULL);
+  init_tagged (&tagged_type, tagged_elements);
+  prep_and_call (cache, &tagged_cif, &mix_cif, &tagged_type);
+  ffi_cif_cache_stats (cache, &hits, &misses);
+  CHECK (hits == 0 && misses == 2);
+  CHECK (ffi_cif_cache_save (cache, path) == FFI_OK);
+  ffi_cif_cache_free (cache);
+
+  /* The next start loads both, and fills in the structure layout.  */
+  cache = ffi_cif_cache_open (path);
+  CHECK (cache != NULL);
+  init_tagged (&tagged_type, tagged_elements);
+  prep_and_call (cache, &cif, &mix_cif, &tagged_type);
+  ffi_cif_cache_stats (cache, &hits, &misses);
+  CHECK (hits == 2 && misses == 0);
+  CHECK (cif.abi == tagged_cif.abi && cif.nargs == tagged_cif.nargs
+	 && cif.bytes == tagged_cif.bytes && cif.flags == tagged_cif.flags);
+
+  /* Other signatures are still prepared.  */
+  args[0] = &ffi_type_double;
+  CHECK (ffi_prep_cif_cached (cache, &cif, FFI_DEFAULT_ABI, 1,
+			      &ffi_type_void, args) == FFI_OK);
+  ffi_cif_cache_stats (cache, &hits, &misses);
+  CHECK (hits == 2 && misses == 1);
+  ffi_cif_cache_free (cache);
+
+  /* A file that is not a cache is ignored.  */
+  f = fopen (path, "wb");
+  CHECK (f != NULL);
+  fputs ("not a cache", f);
+  fclose (f);
+  cache = ffi_cif_cache_open (path);
+  CHECK (cache != NULL);
+  init_tagged (&tagged_type, tagged_elements);
+  prep_and_call (cache, &tagged_cif, &mix_cif, &tagged_type);
+  ffi_cif_cache_stats (cache, &hits, &misses);
+  CHECK (hits == 0 && misses == 2);
+  ffi_cif_cache_free (cache);
+  unlink (path);
+
+  exit (0);
+}
@@ -0,0 +1,109 @@
+/* Area:		ffi_call_columns
+   Purpose:		Check columnar calls, for both scalar-only signatures
+			and ones that need the stack.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define NROWS 5
+
+static double scale (double x, int k)
+{
+  return x * k;
+}
+
+static signed char add8 (signed char a, float b, long long c)
+{
+  return (signed char) (a + (int) b + c);
+}
+
+static int sum9 (int a, int b, int c, int d, int e, int f, int g,
+		 int h, int i)
+{
+  return a + b + c + d + e + f + g + h + i;
+}
+
+struct row
+{
+  float b;
+  signed char a;
+  long long c;
+};
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[9];
+  void *columns[9];
+  size_t strides[9];
+  double x[NROWS] = { 1.5, -2.0, 0.25, 8.0, 3.0 };
+  int k[NROWS] = { 2, 3, -4, 0, 7 };
+  double out[NROWS];
+  struct row rows[NROWS];
+  signed char out8[NROWS + 1];
+  int m[9][NROWS], out9[NROWS];
+  int i, j;
+
+  /* Two plain columns into a double column.  */
+  args[0] = &ffi_type_double;
+  args[1] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_double, args)
+	 == FFI_OK);
+
+  columns[0] = x;
+  strides[0] = sizeof (double);
+  columns[1] = k;
+  strides[1] = sizeof (int);
+  ffi_call_columns (&cif, FFI_FN (scale), NROWS, out, sizeof (double),
+		    columns, strides);
+  for (i = 0; i < NROWS; i++)
+    CHECK (out[i] == x[i] * k[i]);
+
+  /* Columns interleaved in an array of structs, narrow results.  */
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_float;
+  args[2] = &ffi_type_sint64;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &ffi_type_schar, args)
+	 == FFI_OK);
+
+  for (i = 0; i < NROWS; i++)
+    {
+      rows[i].a = (signed char) (i - 3);
+      rows[i].b = (float) (i * 2);
+      rows[i].c = -10 * i;
+    }
+  columns[0] = &rows[0].a;
+  columns[1] = &rows[0].b;
+  columns[2] = &rows[0].c;
+  strides[0] = strides[1] = strides[2] = sizeof (struct row);
+  out8[NROWS] = 42;
+  ffi_call_columns (&cif, FFI_FN (add8), NROWS, out8, 1, columns, strides);
+  for (i = 0; i < NROWS; i++)
+    CHECK (out8[i] == add8 (rows[i].a, rows[i].b, rows[i].c));
+  CHECK (out8[NROWS] == 42);
+
+  /* More arguments than registers, and a zero stride.  */
+  for (j = 0; j < 9; j++)
+    {
+      args[j] = &ffi_type_sint;
+      for (i = 0; i < NROWS; i++)
+	m[j][i] = j * 100 + i;
+      columns[j] = m[j];
+      strides[j] = j == 4 ? 0 : sizeof (int);
+    }
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &ffi_type_sint, args)
+	 == FFI_OK);
+  ffi_call_columns (&cif, FFI_FN (sum9), NROWS, out9, sizeof (int),
+		    columns, strides);
+  for (i = 0; i < NROWS; i++)
+    CHECK (out9[i] == sum9 (m[0][i], m[1][i], m[2][i], m[3][i], m[4][0],
+			    m[5][i], m[6][i], m[7][i], m[8][i]));
+
+  /* Results may be discarded.  */
+  ffi_call_columns (&cif, FFI_FN (sum9), NROWS, NULL, 0, columns, strides);
+
+  exit (0);
+}
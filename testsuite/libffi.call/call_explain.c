@@ -0,0 +1,101 @@
+/* Area:		ffi_explain, ffi_explain_print
+   Purpose:		Check the reported placement of return values and
+			arguments.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+static char report[4096];
+
+static void collect (const char *line, void *user_data)
+{
+  size_t *len = user_data;
+  size_t n = strlen (line);
+
+  CHECK (*len + n < sizeof (report));
+  memcpy (report + *len, line, n + 1);
+  *len += n;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[12];
+  ffi_placement rv, p[12];
+  ffi_type big_type;
+  ffi_type *big_elements[5];
+  size_t len = 0;
+  int i;
+
+  /* Nine integers: the first go in registers, the last on the stack.  */
+  for (i = 0; i < 9; i++)
+    args[i] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &ffi_type_sint, args)
+	 == FFI_OK);
+  if (ffi_explain (&cif, &rv, p) != FFI_OK)
+    {
+      /* This port does not describe its placement.  */
+      CHECK (ffi_explain_print (&cif, collect, &len) != FFI_OK);
+      exit (0);
+    }
+
+  CHECK (rv.kind == FFI_PLACE_GPR && rv.gpr == 0 && rv.ngpr == 1);
+  CHECK (p[0].kind == FFI_PLACE_GPR && p[0].gpr == 0 && p[0].ngpr == 1);
+  CHECK (p[1].kind == FFI_PLACE_GPR && p[1].gpr == 1);
+  CHECK (p[8].kind == FFI_PLACE_STACK && p[8].stack_size == 8);
+  for (i = 0; i < 9; i++)
+    CHECK (p[i].flags == 0);
+
+  /* A floating point argument and a structure returned in memory.  */
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  for (i = 0; i < 4; i++)
+    big_elements[i] = &ffi_type_slong;
+  big_elements[4] = NULL;
+
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_double;
+  args[2] = &big_type;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &big_type, args) == FFI_OK);
+  CHECK (ffi_explain (&cif, &rv, p) == FFI_OK);
+
+  /* The hidden return pointer takes the first integer register.  */
+  CHECK (rv.kind == FFI_PLACE_MEMORY && rv.gpr == 0);
+  CHECK (p[0].kind == FFI_PLACE_GPR && p[0].gpr == 1);
+#if defined (__x86_64__) || defined (__riscv_float_abi_double)
+  CHECK (p[1].kind == FFI_PLACE_FPR && p[1].fpr == 0 && p[1].nfpr == 1);
+#endif
+#if defined (__x86_64__)
+  CHECK (p[2].kind == FFI_PLACE_STACK && p[2].stack_size == 32);
+#elif defined (__riscv)
+  CHECK (p[2].kind == FFI_PLACE_GPR
+	 && (p[2].flags & FFI_PLACE_BY_REFERENCE));
+#endif
+
+  CHECK (ffi_explain_print (&cif, collect, &len) == FFI_OK);
+  printf ("%s", report);
+  CHECK (strstr (report, "return\t{sint64, sint64, sint64, sint64}\t")
+	 != NULL);
+  CHECK (strstr (report, "arg 0\tpointer\t") != NULL);
+  CHECK (strstr (report, "arg 2\t") != NULL);
+
+  /* Only the variable arguments of a variadic cif are flagged.  */
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_double;
+  CHECK (ffi_prep_cif_var (&cif, FFI_DEFAULT_ABI, 1, 3, &ffi_type_sint, args)
+	 == FFI_OK);
+  CHECK (ffi_explain (&cif, &rv, p) == FFI_OK);
+  CHECK (!(p[0].flags & FFI_PLACE_VARIADIC));
+  CHECK (p[1].flags & FFI_PLACE_VARIADIC);
+  CHECK (p[2].flags & FFI_PLACE_VARIADIC);
+  len = 0;
+  CHECK (ffi_explain_print (&cif, collect, &len) == FFI_OK);
+  CHECK (strstr (report, "variadic") != NULL);
+
+  exit (0);
+}
@@ -0,0 +1,136 @@
+/* Area:		ffi_frame_alloc, ffi_frame_set_arg, ffi_frame_call
+   Purpose:		Check that argument frames can be called repeatedly
+			with some of their arguments changed in place.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct pair
+{
+  double d;
+  int i;
+};
+
+struct big
+{
+  long a, b, c, d;
+};
+
+static long poll_one (void *handle, int index, double scale)
+{
+  return (long) (((long *) handle)[index] * scale);
+}
+
+static struct big spread (struct pair p, signed char c, long a, long b,
+			  long d, long e, long f, float g)
+{
+  struct big r;
+
+  r.a = (long) p.d + p.i;
+  r.b = c;
+  r.c = a + b + d + e + f;
+  r.d = (long) g;
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[8];
+  void *values[8];
+  ffi_frame *frame;
+  long table[4] = { 10, 20, 30, 40 };
+  void *handle = table;
+  int index = 0;
+  double scale = 2.0;
+  ffi_arg rc;
+  ffi_type pair_type, big_type;
+  ffi_type *pair_elements[3], *big_elements[5];
+  struct pair p;
+  struct big r;
+  signed char c;
+  long l[5];
+  float g;
+  int i;
+
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  values[0] = &handle;
+  values[1] = &index;
+  values[2] = &scale;
+  frame = ffi_frame_alloc (&cif, values);
+  CHECK (frame != NULL);
+
+  /* The frame holds copies; later changes to the originals are not
+     seen until they are stored with ffi_frame_set_arg.  */
+  scale = 100.0;
+  for (i = 0; i < 4; i++)
+    {
+      ffi_frame_set_arg (frame, 1, &i);
+      ffi_frame_call (frame, FFI_FN (poll_one), &rc);
+      CHECK ((long) rc == table[i] * 2);
+    }
+  scale = 0.5;
+  ffi_frame_set_arg (frame, 2, &scale);
+  ffi_frame_call (frame, FFI_FN (poll_one), &rc);
+  CHECK ((long) rc == table[3] / 2);
+  ffi_frame_free (frame);
+
+  /* Structures, stack arguments and a structure returned in memory.  */
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_double;
+  pair_elements[1] = &ffi_type_sint;
+  pair_elements[2] = NULL;
+
+  big_type.size = big_type.alignment = 0;
+  big_type.type = FFI_TYPE_STRUCT;
+  big_type.elements = big_elements;
+  big_elements[0] = big_elements[1] = &ffi_type_slong;
+  big_elements[2] = big_elements[3] = &ffi_type_slong;
+  big_elements[4] = NULL;
+
+  args[0] = &pair_type;
+  args[1] = &ffi_type_schar;
+  for (i = 0; i < 5; i++)
+    args[2 + i] = &ffi_type_slong;
+  args[7] = &ffi_type_float;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 8, &big_type, args) == FFI_OK);
+
+  /* Start from zeroed arguments.  */
+  frame = ffi_frame_alloc (&cif, NULL);
+  CHECK (frame != NULL);
+  ffi_frame_call (frame, FFI_FN (spread), &r);
+  CHECK (r.a == 0 && r.b == 0 && r.c == 0 && r.d == 0);
+
+  p.d = 3.0;
+  p.i = 4;
+  c = -5;
+  g = 9.0f;
+  ffi_frame_set_arg (frame, 0, &p);
+  ffi_frame_set_arg (frame, 1, &c);
+  ffi_frame_set_arg (frame, 7, &g);
+  for (i = 0; i < 5; i++)
+    {
+      l[i] = 1L << i;
+      ffi_frame_set_arg (frame, 2 + i, &l[i]);
+    }
+  ffi_frame_call (frame, FFI_FN (spread), &r);
+  CHECK (r.a == 7 && r.b == -5 && r.c == 31 && r.d == 9);
+
+  l[4] = 100;
+  ffi_frame_set_arg (frame, 6, &l[4]);
+  ffi_frame_call (frame, FFI_FN (spread), &r);
+  CHECK (r.a == 7 && r.b == -5 && r.c == 115 && r.d == 9);
+  ffi_frame_free (frame);
+
+  exit (0);
+}
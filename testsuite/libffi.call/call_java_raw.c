@@ -0,0 +1,135 @@
+/* Area:		ffi_java_raw_plan_alloc, ffi_java_raw_plan_call,
+			ffi_prep_java_raw_closure_loc
+   Purpose:		Check calls and closures that take their arguments
+			in Java raw format.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+static long mixed (int a, long long b, double c, float d, unsigned short e,
+		   void *f, signed char g)
+{
+  return a + (long) b + (long) c + (long) d + e + (f != NULL) + g;
+}
+
+static double spill (long long a, long long b, long long c, long long d,
+		     long long e, long long f, long long g, double h, int i)
+{
+  return a + b + c + d + e + f + g + h + i;
+}
+
+static void mixed_handler (ffi_cif *cif, void *rvalue, ffi_java_raw *raw,
+			   void *user_data)
+{
+  void *avalue[7];
+
+  (void) user_data;
+  ffi_java_raw_to_ptrarray (cif, raw, avalue);
+  *(ffi_arg *) rvalue = *(int *) avalue[0] + (long) *(long long *) avalue[1]
+    + (long) *(double *) avalue[2] + (long) *(float *) avalue[3]
+    + *(unsigned short *) avalue[4] + (*(void **) avalue[5] != NULL)
+    + *(signed char *) avalue[6];
+}
+
+static void ints_handler (ffi_cif *cif, void *rvalue, ffi_java_raw *raw,
+			  void *user_data)
+{
+  (void) cif;
+  *(ffi_arg *) rvalue = (int) raw[0].sint * 100 + (int) raw[1].sint
+    + (raw[2].ptr == user_data);
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[9];
+  void *values[9];
+  ffi_java_raw raw[18];
+  ffi_java_raw_plan *plan;
+  ffi_java_raw_closure *cl;
+  void *code;
+  ffi_arg rc;
+  int a = -7, i;
+  long long b = 1000000, l[7];
+  double c = 20.5, d2;
+  float d = 3.0f;
+  unsigned short e = 60000;
+  void *f = &a;
+  signed char g = -1;
+
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sint64;
+  args[2] = &ffi_type_double;
+  args[3] = &ffi_type_float;
+  args[4] = &ffi_type_ushort;
+  args[5] = &ffi_type_pointer;
+  args[6] = &ffi_type_schar;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 7, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  values[0] = &a;
+  values[1] = &b;
+  values[2] = &c;
+  values[3] = &d;
+  values[4] = &e;
+  values[5] = &f;
+  values[6] = &g;
+  ffi_java_ptrarray_to_raw (&cif, values, raw);
+
+  plan = ffi_java_raw_plan_alloc (&cif);
+  CHECK (plan != NULL);
+  for (i = 0; i < 3; i++)
+    {
+      ffi_java_raw_plan_call (plan, FFI_FN (mixed), &rc, raw);
+      CHECK ((long) rc == -7 + 1000000 + 20 + 3 + 60000 + 1 - 1);
+    }
+  ffi_java_raw_plan_free (plan);
+
+  cl = ffi_closure_alloc (sizeof (ffi_java_raw_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_java_raw_closure_loc (cl, &cif, mixed_handler, NULL, code)
+	 == FFI_OK);
+  CHECK (((long (*)(int, long long, double, float, unsigned short, void *,
+		    signed char)) code) (a, b, c, d, e, f, g)
+	 == -7 + 1000000 + 20 + 3 + 60000 + 1 - 1);
+  ffi_closure_free (cl);
+
+  /* Arguments passed on the stack.  */
+  for (i = 0; i < 7; i++)
+    {
+      args[i] = &ffi_type_sint64;
+      l[i] = 1LL << (i * 4);
+      values[i] = &l[i];
+    }
+  args[7] = &ffi_type_double;
+  args[8] = &ffi_type_sint;
+  values[7] = &c;
+  values[8] = &a;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &ffi_type_double, args)
+	 == FFI_OK);
+  ffi_java_ptrarray_to_raw (&cif, values, raw);
+
+  plan = ffi_java_raw_plan_alloc (&cif);
+  CHECK (plan != NULL);
+  ffi_java_raw_plan_call (plan, FFI_FN (spill), &d2, raw);
+  CHECK (d2 == 0x1111111 + 20.5 - 7);
+  ffi_java_raw_plan_free (plan);
+
+  /* Integers and references only.  */
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_pointer;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &ffi_type_sint, args)
+	 == FFI_OK);
+  cl = ffi_closure_alloc (sizeof (ffi_java_raw_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_java_raw_closure_loc (cl, &cif, ints_handler, f, code)
+	 == FFI_OK);
+  CHECK (((int (*)(int, int, void *)) code) (-3, 4, f) == -300 + 4 + 1);
+  ffi_closure_free (cl);
+
+  exit (0);
+}
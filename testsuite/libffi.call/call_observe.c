@@ -0,0 +1,104 @@
+/* Area:		ffi_observer_add, ffi_observer_remove
+   Purpose:		Check that observers see calls and closure
+			invocations, with their arguments and results,
+			until they are removed.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct log
+{
+  int n;
+  ffi_observe_event events[8];
+  long args[8];
+  long results[8];
+};
+
+static void observe (ffi_observe_event event, ffi_cif *cif, void (*fn)(void),
+		     void *rvalue, void **avalue, void *user_data)
+{
+  struct log *log = user_data;
+
+  CHECK (cif->nargs == 2 && fn != NULL);
+  CHECK (log->n < 8);
+  log->events[log->n] = event;
+  log->args[log->n] = *(long *) avalue[0];
+  log->results[log->n] = (event == FFI_OBSERVE_CALL_EXIT
+			  || event == FFI_OBSERVE_CLOSURE_EXIT)
+    ? (long) *(ffi_arg *) rvalue : 0;
+  log->n++;
+}
+
+static long sub (long a, long b)
+{
+  return a - b;
+}
+
+static void sub_handler (ffi_cif *cif, void *rvalue, void **avalue,
+			 void *user_data)
+{
+  (void) cif;
+  (void) user_data;
+  *(ffi_arg *) rvalue = *(long *) avalue[0] - *(long *) avalue[1];
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[2];
+  void *values[2];
+  ffi_observer *o1, *o2;
+  struct log log1, log2;
+  ffi_closure *cl;
+  void *code;
+  long a = 10, b = 3;
+  ffi_arg rc;
+
+  memset (&log1, 0, sizeof (log1));
+  memset (&log2, 0, sizeof (log2));
+
+  args[0] = args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+  values[0] = &a;
+  values[1] = &b;
+
+  /* Nothing is seen before an observer is added.  */
+  ffi_call (&cif, FFI_FN (sub), &rc, values);
+  CHECK ((long) rc == 7);
+
+  o1 = ffi_observer_add (observe, &log1);
+  CHECK (o1 != NULL);
+  ffi_call (&cif, FFI_FN (sub), &rc, values);
+  CHECK ((long) rc == 7);
+  CHECK (log1.n == 2);
+  CHECK (log1.events[0] == FFI_OBSERVE_CALL_ENTER && log1.args[0] == 10);
+  CHECK (log1.events[1] == FFI_OBSERVE_CALL_EXIT && log1.results[1] == 7);
+
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &cif, sub_handler, NULL, code) == FFI_OK);
+
+  o2 = ffi_observer_add (observe, &log2);
+  CHECK (o2 != NULL && o2 != o1);
+  CHECK (((long (*) (long, long)) code) (50, 8) == 42);
+  CHECK (log1.n == 4 && log2.n == 2);
+  CHECK (log1.events[2] == FFI_OBSERVE_CLOSURE_ENTER && log1.args[2] == 50);
+  CHECK (log1.events[3] == FFI_OBSERVE_CLOSURE_EXIT && log1.results[3] == 42);
+  CHECK (log2.events[0] == FFI_OBSERVE_CLOSURE_ENTER);
+  CHECK (log2.events[1] == FFI_OBSERVE_CLOSURE_EXIT);
+
+  ffi_observer_remove (o1);
+  ffi_call (&cif, FFI_FN (sub), &rc, values);
+  CHECK (log1.n == 4 && log2.n == 4);
+
+  ffi_observer_remove (o2);
+  CHECK (((long (*) (long, long)) code) (50, 8) == 42);
+  CHECK (log1.n == 4 && log2.n == 4);
+
+  ffi_closure_free (cl);
+  exit (0);
+}
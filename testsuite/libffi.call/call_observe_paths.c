@@ -0,0 +1,153 @@
+/* Area:		ffi_observer_add
+   Purpose:		Check that observers see the calls made through
+			frames, packed plans, columns, the raw API and
+			interposers, with their arguments and results.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct log
+{
+  int n;
+  ffi_observe_event events[16];
+  long args[16];
+  long results[16];
+};
+
+static void observe (ffi_observe_event event, ffi_cif *cif, void (*fn)(void),
+		     void *rvalue, void **avalue, void *user_data)
+{
+  struct log *log = user_data;
+
+  CHECK (cif->nargs == 2 && fn != NULL && avalue != NULL);
+  CHECK (log->n < 16);
+  log->events[log->n] = event;
+  log->args[log->n] = *(long *) avalue[0] * 100 + *(long *) avalue[1];
+  log->results[log->n] = (event == FFI_OBSERVE_CALL_EXIT
+			  || event == FFI_OBSERVE_CLOSURE_EXIT)
+    ? (long) *(ffi_arg *) rvalue : 0;
+  log->n++;
+}
+
+static long sub (long a, long b)
+{
+  return a - b;
+}
+
+/* Check that the last two events of LOG are a call of ARGS
+   returning RESULT, and forget them.  */
+static void check_call (struct log *log, long args, long result)
+{
+  CHECK (log->n == 2);
+  CHECK (log->events[0] == FFI_OBSERVE_CALL_ENTER && log->args[0] == args);
+  CHECK (log->events[1] == FFI_OBSERVE_CALL_EXIT
+	 && log->results[1] == result);
+  log->n = 0;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[2];
+  void *values[2];
+  ffi_observer *o;
+  struct log log;
+  long a = 10, b = 3, packed[2], col0[2], col1[2], results[2];
+  void *columns[2];
+  size_t strides[2];
+  ffi_frame *frame;
+  ffi_packed_plan *plan;
+  ffi_arg rc;
+
+  memset (&log, 0, sizeof (log));
+  args[0] = args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+  values[0] = &a;
+  values[1] = &b;
+
+  frame = ffi_frame_alloc (&cif, values);
+  plan = ffi_packed_plan_alloc (&cif);
+  CHECK (frame != NULL && plan != NULL);
+
+  o = ffi_observer_add (observe, &log);
+  CHECK (o != NULL);
+
+  /* Frames.  */
+  ffi_frame_call (frame, FFI_FN (sub), &rc);
+  CHECK ((long) rc == 7);
+  check_call (&log, 1003, 7);
+  b = 4;
+  ffi_frame_set_arg (frame, 1, &b);
+  ffi_frame_call (frame, FFI_FN (sub), &rc);
+  CHECK ((long) rc == 6);
+  check_call (&log, 1004, 6);
+
+  /* Packed plans.  */
+  packed[0] = 20;
+  packed[1] = 5;
+  ffi_packed_plan_call (plan, FFI_FN (sub), &rc, packed);
+  CHECK ((long) rc == 15);
+  check_call (&log, 2005, 15);
+
+  /* Columns, one call per row.  */
+  col0[0] = 30;
+  col0[1] = 40;
+  col1[0] = 1;
+  col1[1] = 2;
+  columns[0] = col0;
+  columns[1] = col1;
+  strides[0] = strides[1] = sizeof (long);
+  ffi_call_columns (&cif, FFI_FN (sub), 2, results, sizeof (long), columns,
+		    strides);
+  CHECK (results[0] == 29 && results[1] == 38);
+  CHECK (log.n == 4);
+  CHECK (log.args[0] == 3001 && log.results[1] == 29);
+  CHECK (log.args[2] == 4002 && log.results[3] == 38);
+  log.n = 0;
+
+#if !FFI_NO_RAW_API
+  {
+    ffi_raw raw[2];
+
+    raw[0].sint = 50;
+    raw[1].sint = 8;
+    ffi_raw_call (&cif, FFI_FN (sub), &rc, raw);
+    CHECK ((long) rc == 42);
+    check_call (&log, 5008, 42);
+  }
+#endif
+
+#if FFI_CLOSURES
+  {
+    ffi_interposer *ip;
+    void *code;
+
+    ip = ffi_interposer_alloc (&cif, FFI_FN (sub), NULL, NULL, NULL, &code);
+    CHECK (ip != NULL);
+    CHECK (((long (*) (long, long)) code) (60, 9) == 51);
+    CHECK (log.n == 4);
+    CHECK (log.events[0] == FFI_OBSERVE_CLOSURE_ENTER
+	   && log.args[0] == 6009);
+    CHECK (log.events[1] == FFI_OBSERVE_CALL_ENTER && log.args[1] == 6009);
+    CHECK (log.events[2] == FFI_OBSERVE_CALL_EXIT && log.results[2] == 51);
+    CHECK (log.events[3] == FFI_OBSERVE_CLOSURE_EXIT
+	   && log.results[3] == 51);
+    log.n = 0;
+    ffi_interposer_free (ip);
+  }
+#endif
+
+  /* Without observers the shortcuts are taken again.  */
+  ffi_observer_remove (o);
+  ffi_frame_call (frame, FFI_FN (sub), &rc);
+  ffi_packed_plan_call (plan, FFI_FN (sub), &rc, packed);
+  CHECK ((long) rc == 15 && log.n == 0);
+
+  ffi_packed_plan_free (plan);
+  ffi_frame_free (frame);
+  exit (0);
+}
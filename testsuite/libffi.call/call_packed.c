@@ -0,0 +1,136 @@
+/* Area:		ffi_packed_size, ffi_packed_offsets, ffi_call_packed,
+			ffi_packed_plan_call
+   Purpose:		Check calls whose arguments are passed in one
+			packed buffer.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <stddef.h>
+
+struct pair
+{
+  double d;
+  int i;
+};
+
+struct mix_args
+{
+  signed char c;
+  double d;
+  short s;
+  float f;
+  long l;
+};
+
+struct big_args
+{
+  struct pair p;
+  char c;
+  long a, b, d, e, f;
+  double g;
+};
+
+static long mix (signed char c, double d, short s, float f, long l)
+{
+  return c + (long) d + s + (long) f + l;
+}
+
+static struct pair big (struct pair p, char c, long a, long b, long d,
+			long e, long f, double g)
+{
+  struct pair r;
+
+  r.d = p.d + g;
+  r.i = p.i + c + a + b + d + e + f;
+  return r;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_packed_plan *plan;
+  ffi_type *args[8];
+  size_t offsets[8];
+  ffi_arg rc;
+  ffi_type pair_type;
+  ffi_type *pair_elements[3];
+  struct mix_args m;
+  struct big_args b;
+  struct pair r;
+  int i;
+
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_double;
+  args[2] = &ffi_type_sshort;
+  args[3] = &ffi_type_float;
+  args[4] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 5, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  CHECK (ffi_packed_size (&cif) == sizeof (struct mix_args));
+  ffi_packed_offsets (&cif, offsets);
+  CHECK (offsets[0] == offsetof (struct mix_args, c));
+  CHECK (offsets[1] == offsetof (struct mix_args, d));
+  CHECK (offsets[2] == offsetof (struct mix_args, s));
+  CHECK (offsets[3] == offsetof (struct mix_args, f));
+  CHECK (offsets[4] == offsetof (struct mix_args, l));
+
+  m.c = -3;
+  m.d = 40.0;
+  m.s = -500;
+  m.f = 6.0f;
+  m.l = 100000;
+  ffi_call_packed (&cif, FFI_FN (mix), &rc, &m);
+  CHECK ((long) rc == -3 + 40 - 500 + 6 + 100000);
+
+  plan = ffi_packed_plan_alloc (&cif);
+  CHECK (plan != NULL);
+  for (i = 0; i < 3; i++)
+    {
+      m.l = i;
+      ffi_packed_plan_call (plan, FFI_FN (mix), &rc, &m);
+      CHECK ((long) rc == -3 + 40 - 500 + 6 + i);
+    }
+  ffi_packed_plan_free (plan);
+
+  /* Structures, stack arguments and a structure return.  */
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = &ffi_type_double;
+  pair_elements[1] = &ffi_type_sint;
+  pair_elements[2] = NULL;
+
+  args[0] = &pair_type;
+  args[1] = &ffi_type_schar;
+  for (i = 0; i < 5; i++)
+    args[2 + i] = &ffi_type_slong;
+  args[7] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 8, &pair_type, args) == FFI_OK);
+  CHECK (ffi_packed_size (&cif) == sizeof (struct big_args));
+
+  b.p.d = 1.5;
+  b.p.i = 1;
+  b.c = 2;
+  b.a = 4;
+  b.b = 8;
+  b.d = 16;
+  b.e = 32;
+  b.f = 64;
+  b.g = 0.25;
+  ffi_call_packed (&cif, FFI_FN (big), &r, &b);
+  CHECK (r.d == 1.75 && r.i == 127);
+
+  plan = ffi_packed_plan_alloc (&cif);
+  CHECK (plan != NULL);
+  b.c = 3;
+  memset (&r, 0, sizeof (r));
+  ffi_packed_plan_call (plan, FFI_FN (big), &r, &b);
+  CHECK (r.d == 1.75 && r.i == 128);
+  ffi_packed_plan_free (plan);
+
+  exit (0);
+}
@@ -0,0 +1,129 @@
+/* Area:		ffi_call_parallel
+   Purpose:		Check that every call of a batch runs exactly once,
+			with and without a worker pool, and that a pool
+			can be re-entered.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define NCALLS 1000
+
+static long long square (int x)
+{
+  return (long long) x * x;
+}
+
+static double halve (double x)
+{
+  return x / 2;
+}
+
+static char seen[NCALLS];
+
+static void done (ffi_call_desc *call, void *user_data)
+{
+  /* Each call owns one slot, so no locking is needed.  */
+  seen[call - (ffi_call_desc *) user_data]++;
+}
+
+static ffi_pool *nested_pool;
+static ffi_call_desc *nested_calls;
+
+/* Outer call K submits calls 2K and 2K+1 to the pool running it.  */
+static void nested_done (ffi_call_desc *call, void *user_data)
+{
+  size_t k = call - (ffi_call_desc *) user_data;
+
+  ffi_call_parallel (nested_pool, &nested_calls[2 * k], 2, done,
+		     nested_calls);
+}
+
+int main (void)
+{
+  static ffi_call_desc calls[NCALLS];
+  static int ivals[NCALLS];
+  static double dvals[NCALLS];
+  static void *values[NCALLS];
+  static long long iresults[NCALLS];
+  static double dresults[NCALLS];
+  ffi_cif icif, dcif;
+  ffi_type *iargs[1] = { &ffi_type_sint };
+  ffi_type *dargs[1] = { &ffi_type_double };
+  ffi_pool *pool;
+  int i, round;
+
+  CHECK (ffi_prep_cif (&icif, FFI_DEFAULT_ABI, 1, &ffi_type_sint64, iargs)
+	 == FFI_OK);
+  CHECK (ffi_prep_cif (&dcif, FFI_DEFAULT_ABI, 1, &ffi_type_double, dargs)
+	 == FFI_OK);
+
+  for (i = 0; i < NCALLS; i++)
+    {
+      ivals[i] = i;
+      dvals[i] = i;
+      if (i % 3 == 0)
+	{
+	  calls[i].cif = &dcif;
+	  calls[i].fn = FFI_FN (halve);
+	  calls[i].rvalue = &dresults[i];
+	  values[i] = &dvals[i];
+	}
+      else
+	{
+	  calls[i].cif = &icif;
+	  calls[i].fn = FFI_FN (square);
+	  calls[i].rvalue = &iresults[i];
+	  values[i] = &ivals[i];
+	}
+      calls[i].avalue = &values[i];
+    }
+
+  for (round = 0; round < 3; round++)
+    {
+      pool = round == 0 ? NULL : ffi_pool_create (round == 1 ? 0 : 3);
+
+      memset (iresults, 0, sizeof (iresults));
+      memset (dresults, 0, sizeof (dresults));
+      ffi_call_parallel (pool, calls, NCALLS, NULL, NULL);
+      for (i = 0; i < NCALLS; i++)
+	if (i % 3 == 0)
+	  CHECK (dresults[i] == i / 2.0);
+	else
+	  CHECK (iresults[i] == (long long) i * i);
+
+      /* The same pool can run several batches.  */
+      memset (seen, 0, sizeof (seen));
+      ffi_call_parallel (pool, calls, NCALLS, done, calls);
+      for (i = 0; i < NCALLS; i++)
+	CHECK (seen[i] == 1);
+
+      /* Batches submitted from inside a batch of the same pool.  */
+      {
+	static ffi_call_desc outer[NCALLS / 2];
+	static long long oresults[NCALLS / 2];
+
+	for (i = 0; i < NCALLS / 2; i++)
+	  {
+	    outer[i].cif = &icif;
+	    outer[i].fn = FFI_FN (square);
+	    outer[i].rvalue = &oresults[i];
+	    outer[i].avalue = &values[1];
+	  }
+	memset (seen, 0, sizeof (seen));
+	nested_pool = pool;
+	nested_calls = calls;
+	ffi_call_parallel (pool, outer, NCALLS / 2, nested_done, outer);
+	for (i = 0; i < NCALLS; i++)
+	  CHECK (seen[i] == 1);
+	for (i = 0; i < NCALLS / 2; i++)
+	  CHECK (oresults[i] == 1);
+      }
+
+      ffi_pool_destroy (pool);
+    }
+
+  exit (0);
+}
@@ -0,0 +1,90 @@
+/* Area:		ffi_profile_report
+   Purpose:		Check that calls and closure invocations are
+			attributed to their signature when libffi is
+			configured with --enable-profile.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+static char report[8192];
+
+static void collect (const char *line, void *user_data)
+{
+  size_t *len = user_data;
+  size_t n = strlen (line);
+
+  CHECK (*len + n < sizeof (report));
+  memcpy (report + *len, line, n + 1);
+  *len += n;
+}
+
+static long add (long a, long b)
+{
+  return a + b;
+}
+
+static void scale_handler (ffi_cif *cif, void *rvalue, void **avalue,
+			   void *user_data)
+{
+  (void) cif;
+  (void) user_data;
+  *(double *) rvalue = *(double *) avalue[0] * *(int *) avalue[1];
+}
+
+int main (void)
+{
+  ffi_cif add_cif, scale_cif;
+  ffi_type *add_args[2], *scale_args[2];
+  void *values[2];
+  ffi_closure *cl;
+  void *code;
+  long a, b;
+  ffi_arg rc;
+  size_t len = 0;
+  int i;
+
+  if (ffi_profile_report (collect, &len, 0) != FFI_OK)
+    {
+      /* Profiling is not configured in.  */
+      CHECK (len == 0);
+      exit (0);
+    }
+
+  add_args[0] = add_args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&add_cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong,
+		       add_args) == FFI_OK);
+  scale_args[0] = &ffi_type_double;
+  scale_args[1] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&scale_cif, FFI_DEFAULT_ABI, 2, &ffi_type_double,
+		       scale_args) == FFI_OK);
+
+  values[0] = &a;
+  values[1] = &b;
+  for (i = 0; i < 100; i++)
+    {
+      a = i;
+      b = 1;
+      ffi_call (&add_cif, FFI_FN (add), &rc, values);
+      CHECK ((long) rc == i + 1);
+    }
+
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &scale_cif, scale_handler, NULL, code)
+	 == FFI_OK);
+  for (i = 0; i < 7; i++)
+    CHECK (((double (*) (double, int)) code) (1.5, i) == 1.5 * i);
+  ffi_closure_free (cl);
+
+  len = 0;
+  CHECK (ffi_profile_report (collect, &len, 10) == FFI_OK);
+  CHECK (strstr (report, "call\t100\t") != NULL);
+  CHECK (strstr (report, "sint64 (sint64, sint64)\n") != NULL);
+  CHECK (strstr (report, "closure\t7\t") != NULL);
+  CHECK (strstr (report, "double (double, sint32)\n") != NULL);
+
+  exit (0);
+}
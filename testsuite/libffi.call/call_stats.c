@@ -0,0 +1,104 @@
+/* Area:		ffi_get_stats
+   Purpose:		Check that calls, closure invocations and closure
+			allocations are counted when libffi is configured
+			with --enable-stats.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct pair
+{
+  long a, b;
+};
+
+static long add_pair (struct pair p, long c)
+{
+  return p.a + p.b + c;
+}
+
+static void add_handler (ffi_cif *cif, void *rvalue, void **avalue,
+			 void *user_data)
+{
+  (void) cif;
+  (void) user_data;
+  *(ffi_arg *) rvalue = *(long *) avalue[0] + *(long *) avalue[1];
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[2];
+  ffi_type pair_type;
+  ffi_type *pair_elements[3];
+  void *values[2];
+  ffi_stats before, after;
+  ffi_closure *cl;
+  void *code;
+  struct pair p;
+  long c;
+  ffi_arg rc;
+  int i;
+
+  if (ffi_get_stats (&before) != FFI_OK)
+    {
+      /* Statistics are not configured in.  */
+      CHECK (before.calls == 0 && before.closures_live == 0);
+      exit (0);
+    }
+
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = pair_elements[1] = &ffi_type_slong;
+  pair_elements[2] = NULL;
+
+  args[0] = &pair_type;
+  args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  p.a = 1;
+  p.b = 2;
+  c = 3;
+  values[0] = &p;
+  values[1] = &c;
+  for (i = 0; i < 3; i++)
+    {
+      ffi_call (&cif, FFI_FN (add_pair), &rc, values);
+      CHECK ((long) rc == 6);
+    }
+
+  CHECK (ffi_get_stats (&after) == FFI_OK);
+  CHECK (after.calls - before.calls == 3);
+  CHECK (after.struct_copies - before.struct_copies == 3);
+  CHECK (after.bytes_marshalled - before.bytes_marshalled
+	 == 3 * (sizeof (struct pair) + 2 * sizeof (long)));
+  CHECK (after.stack_bytes - before.stack_bytes == 3 * cif.bytes);
+
+  args[0] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  before = after;
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &cif, add_handler, NULL, code) == FFI_OK);
+  CHECK (ffi_get_stats (&after) == FFI_OK);
+  CHECK (after.closures_live == before.closures_live + 1);
+  CHECK (after.exec_bytes > 0);
+
+  CHECK (((long (*) (long, long)) code) (40, 2) == 42);
+  CHECK (((long (*) (long, long)) code) (-1, 1) == 0);
+  CHECK (ffi_get_stats (&after) == FFI_OK);
+  CHECK (after.closure_calls - before.closure_calls == 2);
+  CHECK (after.calls == before.calls);
+
+  ffi_closure_free (cl);
+  CHECK (ffi_get_stats (&after) == FFI_OK);
+  CHECK (after.closures_live == before.closures_live);
+
+  exit (0);
+}
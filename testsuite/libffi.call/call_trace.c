@@ -0,0 +1,118 @@
+/* Area:		ffi_trace_start, ffi_trace_load, ffi_trace_replay
+   Purpose:		Check that recorded calls and closure invocations
+			are replayed with their argument bytes.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+#include <unistd.h>
+
+static int call_enters, closure_enters;
+static long sum;
+
+static void observe (ffi_observe_event event, ffi_cif *cif,
+		     void (*fn) (void), void *rvalue, void **avalue,
+		     void *user_data)
+{
+  (void) fn;
+  (void) rvalue;
+  (void) user_data;
+  if (event == FFI_OBSERVE_CALL_ENTER)
+    {
+      call_enters++;
+      if (cif->nargs == 2 && cif->arg_types[0] == &ffi_type_slong)
+	sum += *(long *) avalue[0] + *(long *) avalue[1];
+    }
+  else if (event == FFI_OBSERVE_CLOSURE_ENTER)
+    closure_enters++;
+}
+
+static long add (long a, long b)
+{
+  return a + b;
+}
+
+static size_t length (const char *s)
+{
+  return strlen (s);
+}
+
+static void handler (ffi_cif *cif, void *rvalue, void **avalue,
+		     void *user_data)
+{
+  (void) cif;
+  (void) user_data;
+  *(double *) rvalue = *(double *) avalue[0] * 2;
+}
+
+int main (void)
+{
+  ffi_cif add_cif, length_cif, twice_cif;
+  ffi_type *add_args[2], *length_args[1], *twice_args[1];
+  void *values[2];
+  ffi_closure *cl;
+  ffi_observer *o;
+  ffi_trace *trace;
+  void *code;
+  const char *s = "trace";
+  char path[64];
+  long a, b;
+  ffi_arg rc;
+  int i;
+
+  add_args[0] = add_args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&add_cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong,
+		       add_args) == FFI_OK);
+  length_args[0] = &ffi_type_pointer;
+  CHECK (ffi_prep_cif (&length_cif, FFI_DEFAULT_ABI, 1, &ffi_type_ulong,
+		       length_args) == FFI_OK);
+  twice_args[0] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&twice_cif, FFI_DEFAULT_ABI, 1, &ffi_type_double,
+		       twice_args) == FFI_OK);
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &twice_cif, handler, NULL, code)
+	 == FFI_OK);
+
+  sprintf (path, "/tmp/ffi-trace-%d", (int) getpid ());
+  CHECK (ffi_trace_start (path, FFI_TRACE_ARGS) == FFI_OK);
+  CHECK (ffi_trace_start (path, 0) != FFI_OK);
+
+  values[0] = &a;
+  values[1] = &b;
+  for (i = 0; i < 10; i++)
+    {
+      a = i;
+      b = 100;
+      ffi_call (&add_cif, FFI_FN (add), &rc, values);
+      CHECK ((long) rc == i + 100);
+    }
+  values[0] = &s;
+  ffi_call (&length_cif, FFI_FN (length), &rc, values);
+  CHECK (rc == 5);
+  for (i = 0; i < 3; i++)
+    CHECK (((double (*) (double)) code) (i) == 2 * i);
+
+  CHECK (ffi_trace_stop () == FFI_OK);
+  CHECK (ffi_trace_stop () != FFI_OK);
+  ffi_closure_free (cl);
+
+  trace = ffi_trace_load (path);
+  unlink (path);
+  CHECK (trace != NULL);
+
+  /* Closure invocations are replayed as calls to a closure.  */
+  o = ffi_observer_add (observe, NULL);
+  CHECK (o != NULL);
+  CHECK (ffi_trace_replay (trace) == 14);
+  ffi_observer_remove (o);
+  CHECK (call_enters == 14);
+  CHECK (closure_enters == 3);
+  CHECK (sum == 45 + 10 * 100);
+
+  ffi_trace_free (trace);
+  CHECK (ffi_trace_load (path) == NULL);
+  exit (0);
+}
@@ -0,0 +1,71 @@
+/* Area:		ffi_closure_alloc_many, ffi_closure_free_many
+   Purpose:		Check that closures allocated in bulk are distinct,
+			callable and can be freed in bulk or one by one.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define COUNT 1000
+
+typedef int (*adder_fn) (int);
+
+static void
+adder (ffi_cif *cif __UNUSED__, void *resp, void **args, void *userdata)
+{
+  *(ffi_arg *) resp = *(int *) args[0] + (int) (intptr_t) userdata;
+}
+
+static void *writable[COUNT], *code[COUNT];
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[1];
+  int i, round;
+
+  args[0] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args)
+	 == FFI_OK);
+
+  CHECK (ffi_closure_alloc_many (0, sizeof (ffi_closure), writable, code)
+	 == 0);
+
+  for (round = 0; round < 3; round++)
+    {
+      CHECK (ffi_closure_alloc_many (COUNT, sizeof (ffi_closure),
+				     writable, code) == COUNT);
+      for (i = 0; i < COUNT; i++)
+	{
+	  CHECK (writable[i] != NULL && code[i] != NULL);
+	  CHECK (i == 0 || code[i] != code[i - 1]);
+	  CHECK (ffi_prep_closure_loc (writable[i], &cif, adder,
+				       (void *) (intptr_t) i, code[i])
+		 == FFI_OK);
+	}
+
+      for (i = 0; i < COUNT; i++)
+	CHECK (((adder_fn) code[i]) (round) == i + round);
+
+      /* Closures from a bulk allocation can also be freed singly.  */
+      if (round == 1)
+	{
+	  for (i = 0; i < COUNT; i++)
+	    ffi_closure_free (writable[i]);
+	}
+      else
+	ffi_closure_free_many (COUNT, writable);
+    }
+
+  /* And closures from ffi_closure_alloc can be freed in bulk.  */
+  for (i = 0; i < 10; i++)
+    {
+      writable[i] = ffi_closure_alloc (sizeof (ffi_closure), &code[i]);
+      CHECK (writable[i] != NULL);
+    }
+  ffi_closure_free_many (10, writable);
+
+  exit (0);
+}
@@ -0,0 +1,93 @@
+/* Area:		ffi_closure_array_alloc, ffi_closure_array_entry
+   Purpose:		Check that every entry of a closure array calls the
+			shared handler with its own user_data.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+#define COUNT 70000
+
+typedef long (*scale_fn) (long);
+typedef double (*mix_fn) (int, double, long, long, long, long, long, float,
+			  double);
+
+static void
+scale (ffi_cif *cif __UNUSED__, void *resp, void **args, void *userdata)
+{
+  *(ffi_arg *) resp = *(long *) args[0] * (long) (intptr_t) userdata;
+}
+
+static void
+mix (ffi_cif *cif __UNUSED__, void *resp, void **args, void *userdata)
+{
+  double r = *(int *) args[0] + *(double *) args[1] + *(float *) args[7]
+	     + *(double *) args[8];
+  int i;
+
+  for (i = 2; i < 7; i++)
+    r += *(long *) args[i];
+  *(double *) resp = r * *(double *) userdata;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[9];
+  ffi_closure_array *array;
+  void **user_data;
+  double factors[40];
+  size_t i;
+  int j;
+
+  /* Integer arguments, enough entries for several blocks of stubs.  */
+  args[0] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  array = ffi_closure_array_alloc (&cif, scale, COUNT);
+  CHECK (array != NULL);
+  user_data = ffi_closure_array_user_data (array);
+  for (i = 0; i < COUNT; i++)
+    {
+      CHECK (user_data[i] == NULL);
+      user_data[i] = (void *) (intptr_t) (i + 1);
+    }
+
+  for (i = 0; i < COUNT; i++)
+    CHECK (((scale_fn) ffi_closure_array_entry (array, i)) (3)
+	   == 3 * (long) (i + 1));
+
+  /* The user_data table can change after the entries are handed out.  */
+  user_data[12345] = (void *) (intptr_t) -1;
+  CHECK (((scale_fn) ffi_closure_array_entry (array, 12345)) (7) == -7);
+  ffi_closure_array_free (array);
+
+  /* Floating point and stack arguments.  */
+  args[0] = &ffi_type_sint;
+  args[1] = &ffi_type_double;
+  for (j = 2; j < 7; j++)
+    args[j] = &ffi_type_slong;
+  args[7] = &ffi_type_float;
+  args[8] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &ffi_type_double, args)
+	 == FFI_OK);
+
+  array = ffi_closure_array_alloc (&cif, mix, 40);
+  CHECK (array != NULL);
+  user_data = ffi_closure_array_user_data (array);
+  for (j = 0; j < 40; j++)
+    {
+      factors[j] = j * 0.5;
+      user_data[j] = &factors[j];
+    }
+
+  for (j = 0; j < 40; j++)
+    CHECK (((mix_fn) ffi_closure_array_entry (array, j))
+	   (1, 2.5, 3, 4, 5, 6, 7, 8.0f, 0.5) == 37.0 * j * 0.5);
+  ffi_closure_array_free (array);
+
+  exit (0);
+}
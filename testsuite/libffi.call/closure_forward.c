@@ -0,0 +1,138 @@
+/* Area:		ffi_forward_closure_alloc
+   Purpose:		Check that forwarding closures prepend their bound
+			values to the arguments they receive.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct triple
+{
+  long a, b, c;
+};
+
+static long with_context (long *ctx, int a, double b, long c)
+{
+  return *ctx * 1000 + a * 100 + (long) b * 10 + c;
+}
+
+static long six (signed char a, long b, int c, long d, short e, long f)
+{
+  return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6;
+}
+
+static long many (long ctx, long a, long b, long c, long d, long e, long f,
+		  long g, double h)
+{
+  return ctx * (a + b + c + d + e + f + g + (long) h);
+}
+
+static struct triple spread (long *ctx, long x, float y)
+{
+  struct triple r;
+
+  r.a = *ctx;
+  r.b = x;
+  r.c = (long) y;
+  return r;
+}
+
+static double scale (double x, int y)
+{
+  return x * y;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[9];
+  ffi_forward_closure *fwd;
+  void *code, *bound[2];
+  long context = 7, *ctx = &context;
+  signed char sc = -5;
+  long l = 11;
+  ffi_type triple_type;
+  ffi_type *triple_elements[4];
+  struct triple t;
+  int i;
+
+  /* One bound pointer in front of mixed register arguments.  */
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_double;
+  args[3] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 4, &ffi_type_slong, args)
+	 == FFI_OK);
+  bound[0] = &ctx;
+  fwd = ffi_forward_closure_alloc (&cif, FFI_FN (with_context), 1, bound,
+				   &code);
+  CHECK (fwd != NULL);
+  CHECK (((long (*)(int, double, long)) code) (1, 2.0, 3) == 7123);
+  context = 8;
+  CHECK (((long (*)(int, double, long)) code) (4, 5.5, 6) == 8456);
+  ffi_forward_closure_free (fwd);
+
+  /* Two bound narrow values, with all general registers in use.  */
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_slong;
+  args[2] = &ffi_type_sint;
+  args[3] = &ffi_type_slong;
+  args[4] = &ffi_type_sshort;
+  args[5] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 6, &ffi_type_slong, args)
+	 == FFI_OK);
+  bound[0] = &sc;
+  bound[1] = &l;
+  fwd = ffi_forward_closure_alloc (&cif, FFI_FN (six), 2, bound, &code);
+  CHECK (fwd != NULL);
+  CHECK (((long (*)(int, long, short, long)) code) (-1, 2, -3, 4)
+	 == -5 + 22 - 3 + 8 - 15 + 24);
+  ffi_forward_closure_free (fwd);
+
+  /* Arguments on the stack.  */
+  args[0] = &ffi_type_slong;
+  for (i = 1; i < 8; i++)
+    args[i] = &ffi_type_slong;
+  args[8] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &ffi_type_slong, args)
+	 == FFI_OK);
+  bound[0] = &l;
+  fwd = ffi_forward_closure_alloc (&cif, FFI_FN (many), 1, bound, &code);
+  CHECK (fwd != NULL);
+  CHECK (((long (*)(long, long, long, long, long, long, long, double)) code)
+	 (1, 2, 3, 4, 5, 6, 7, 8.0) == 11 * 36);
+  ffi_forward_closure_free (fwd);
+
+  /* A structure returned in memory.  */
+  triple_type.size = triple_type.alignment = 0;
+  triple_type.type = FFI_TYPE_STRUCT;
+  triple_type.elements = triple_elements;
+  triple_elements[0] = triple_elements[1] = &ffi_type_slong;
+  triple_elements[2] = &ffi_type_slong;
+  triple_elements[3] = NULL;
+  args[0] = &ffi_type_pointer;
+  args[1] = &ffi_type_slong;
+  args[2] = &ffi_type_float;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 3, &triple_type, args)
+	 == FFI_OK);
+  bound[0] = &ctx;
+  fwd = ffi_forward_closure_alloc (&cif, FFI_FN (spread), 1, bound, &code);
+  CHECK (fwd != NULL);
+  t = ((struct triple (*)(long, float)) code) (-2, 9.0f);
+  CHECK (t.a == 8 && t.b == -2 && t.c == 9);
+  ffi_forward_closure_free (fwd);
+
+  /* Nothing bound.  */
+  args[0] = &ffi_type_double;
+  args[1] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_double, args)
+	 == FFI_OK);
+  fwd = ffi_forward_closure_alloc (&cif, FFI_FN (scale), 0, NULL, &code);
+  CHECK (fwd != NULL);
+  CHECK (((double (*)(double, int)) code) (1.5, 4) == 6.0);
+  ffi_forward_closure_free (fwd);
+
+  exit (0);
+}
@@ -0,0 +1,179 @@
+/* Area:		ffi_interposer_alloc, ffi_interposer_arg
+   Purpose:		Check that interposers pass calls on unchanged and
+			let their hooks see the arguments and the result.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct mixed
+{
+  double d;
+  long l;
+};
+
+struct triple
+{
+  long a, b, c;
+};
+
+struct seen
+{
+  int pre, post;
+  long first;
+  double last;
+  long result;
+};
+
+static long mix (signed char a, double b, struct mixed c, float d, long e)
+{
+  return a + (long) b * 10 + (long) c.d * 100 + c.l * 1000
+    + (long) d * 10000 + e;
+}
+
+static struct triple spread (long a, long b, long c, long d, long e, long f,
+			     long g, double h, struct mixed i)
+{
+  struct triple r;
+
+  r.a = a + b + c + d + e + f + g;
+  r.b = (long) h;
+  r.c = (long) i.d + i.l;
+  return r;
+}
+
+static double half (double x)
+{
+  return x / 2;
+}
+
+static void pre_mix (ffi_interposer_call *call, void *user_data)
+{
+  struct seen *s = user_data;
+  const struct mixed *c = ffi_interposer_arg (call, 2);
+
+  s->pre++;
+  s->first = *(const signed char *) ffi_interposer_arg (call, 0);
+  CHECK (*(const double *) ffi_interposer_arg (call, 1) == 2.0);
+  CHECK (c->d == 3.0 && c->l == 4);
+  CHECK (*(const float *) ffi_interposer_arg (call, 3) == 5.0f);
+  s->last = *(const long *) ffi_interposer_arg (call, 4);
+}
+
+static void post_mix (ffi_interposer_call *call, void *rvalue,
+		      void *user_data)
+{
+  struct seen *s = user_data;
+
+  (void) call;
+  s->post++;
+  s->result = *(ffi_sarg *) rvalue;
+}
+
+static void pre_spread (ffi_interposer_call *call, void *user_data)
+{
+  struct seen *s = user_data;
+  const struct mixed *i = ffi_interposer_arg (call, 8);
+
+  s->pre++;
+  s->first = *(const long *) ffi_interposer_arg (call, 6);
+  s->last = *(const double *) ffi_interposer_arg (call, 7);
+  CHECK (i->d == 9.0 && i->l == 10);
+}
+
+static void post_spread (ffi_interposer_call *call, void *rvalue,
+			 void *user_data)
+{
+  struct seen *s = user_data;
+
+  (void) call;
+  s->post++;
+  s->result = ((struct triple *) rvalue)->a;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[9];
+  ffi_interposer *ip;
+  void *code;
+  struct seen s;
+  ffi_type mixed_type, triple_type;
+  ffi_type *mixed_elements[3], *triple_elements[4];
+  struct mixed m;
+  struct triple t;
+  long r;
+  int i;
+
+  mixed_type.size = mixed_type.alignment = 0;
+  mixed_type.type = FFI_TYPE_STRUCT;
+  mixed_type.elements = mixed_elements;
+  mixed_elements[0] = &ffi_type_double;
+  mixed_elements[1] = &ffi_type_slong;
+  mixed_elements[2] = NULL;
+
+  triple_type.size = triple_type.alignment = 0;
+  triple_type.type = FFI_TYPE_STRUCT;
+  triple_type.elements = triple_elements;
+  triple_elements[0] = triple_elements[1] = triple_elements[2]
+    = &ffi_type_slong;
+  triple_elements[3] = NULL;
+
+  /* Integer, floating point and mixed structure arguments.  */
+  args[0] = &ffi_type_schar;
+  args[1] = &ffi_type_double;
+  args[2] = &mixed_type;
+  args[3] = &ffi_type_float;
+  args[4] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 5, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  memset (&s, 0, sizeof (s));
+  ip = ffi_interposer_alloc (&cif, FFI_FN (mix), pre_mix, post_mix, &s, &code);
+  CHECK (ip != NULL);
+  m.d = 3.0;
+  m.l = 4;
+  for (i = 0; i < 3; i++)
+    {
+      r = ((long (*)(signed char, double, struct mixed, float, long)) code)
+	(-1, 2.0, m, 5.0f, 100000 * i);
+      CHECK (r == -1 + 20 + 300 + 4000 + 50000 + 100000 * i);
+      CHECK (s.pre == i + 1 && s.post == i + 1);
+      CHECK (s.first == -1 && s.last == 100000 * i && s.result == r);
+    }
+  ffi_interposer_free (ip);
+
+  /* Stack arguments and a structure returned in memory.  */
+  for (i = 0; i < 7; i++)
+    args[i] = &ffi_type_slong;
+  args[7] = &ffi_type_double;
+  args[8] = &mixed_type;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 9, &triple_type, args)
+	 == FFI_OK);
+
+  memset (&s, 0, sizeof (s));
+  ip = ffi_interposer_alloc (&cif, FFI_FN (spread), pre_spread, post_spread,
+			     &s, &code);
+  CHECK (ip != NULL);
+  m.d = 9.0;
+  m.l = 10;
+  t = ((struct triple (*)(long, long, long, long, long, long, long, double,
+			  struct mixed)) code) (1, 2, 3, 4, 5, 6, 7, 8.0, m);
+  CHECK (t.a == 28 && t.b == 8 && t.c == 19);
+  CHECK (s.pre == 1 && s.post == 1);
+  CHECK (s.first == 7 && s.last == 8.0 && s.result == 28);
+  ffi_interposer_free (ip);
+
+  /* Hooks are optional.  */
+  args[0] = &ffi_type_double;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_double, args)
+	 == FFI_OK);
+  ip = ffi_interposer_alloc (&cif, FFI_FN (half), NULL, NULL, NULL, &code);
+  CHECK (ip != NULL);
+  CHECK (((double (*)(double)) code) (5.0) == 2.5);
+  ffi_interposer_free (ip);
+
+  exit (0);
+}
@@ -0,0 +1,56 @@
+/* Area:		closure code regions
+   Purpose:		Check that the executable memory of closures is
+			listed in /tmp/perf-PID.map when FFI_PERF_MAP is
+			set.
+   Limitations:		Linux only.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run { target *-*-linux* } } */
+#include "ffitest.h"
+#include <unistd.h>
+
+static void handler (ffi_cif *cif, void *rvalue, void **avalue,
+		     void *user_data)
+{
+  (void) cif;
+  (void) user_data;
+  *(ffi_arg *) rvalue = *(int *) avalue[0] + 1;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[1];
+  ffi_closure *cl;
+  void *code;
+  char path[64], name[64];
+  unsigned long start, size;
+  int found = 0;
+  FILE *f;
+
+  /* The environment is read when the first code region is mapped.  */
+  setenv ("FFI_PERF_MAP", "1", 1);
+  sprintf (path, "/tmp/perf-%d.map", (int) getpid ());
+
+  args[0] = &ffi_type_sint;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 1, &ffi_type_sint, args)
+	 == FFI_OK);
+  cl = ffi_closure_alloc (sizeof (ffi_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_closure_loc (cl, &cif, handler, NULL, code) == FFI_OK);
+  CHECK (((int (*) (int)) code) (41) == 42);
+
+  f = fopen (path, "r");
+  CHECK (f != NULL);
+  while (fscanf (f, "%lx %lx %63s", &start, &size, name) == 3)
+    if ((unsigned long) code >= start && (unsigned long) code < start + size
+	&& strncmp (name, "ffi_closure_", 12) == 0)
+      found = 1;
+  fclose (f);
+  unlink (path);
+  CHECK (found);
+
+  ffi_closure_free (cl);
+  exit (0);
+}
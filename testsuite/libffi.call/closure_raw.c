@@ -0,0 +1,150 @@
+/* Area:		ffi_raw_call, ffi_prep_raw_closure_loc
+   Purpose:		Check calls and closures that take their arguments
+			as an array of ffi_raw.
+   Limitations:		none.
+   PR:			none.
+   Originator:		libffi-riscv.  */
+
+/* { dg-do run } */
+#include "ffitest.h"
+
+struct pair
+{
+  long a, b;
+};
+
+static long ints (long a, int b, signed char c, void *d)
+{
+  return a * 1000 + b * 100 + c * 10 + (d != NULL);
+}
+
+static double mixed (double a, unsigned int b, float c, long d)
+{
+  return a + b + c + d;
+}
+
+static long by_value (struct pair p, long q)
+{
+  return p.a * 100 + p.b * 10 + q;
+}
+
+static void ints_handler (ffi_cif *cif, void *rvalue, ffi_raw *raw,
+			  void *user_data)
+{
+  (void) cif;
+  *(ffi_arg *) rvalue = raw[0].sint * *(long *) user_data + raw[1].sint
+    + (signed char) raw[2].sint + (raw[3].ptr == user_data);
+}
+
+static void mixed_handler (ffi_cif *cif, void *rvalue, ffi_raw *raw,
+			   void *user_data)
+{
+  double a;
+
+  (void) cif;
+  (void) user_data;
+  memcpy (&a, raw[0].data, sizeof (a));
+  CHECK (raw[1].uint == 0x80000001u);
+  *(double *) rvalue = a + raw[2].flt + raw[3].sint;
+}
+
+static void by_value_handler (ffi_cif *cif, void *rvalue, ffi_raw *raw,
+			      void *user_data)
+{
+  struct pair *p = raw[0].ptr;
+
+  (void) cif;
+  (void) user_data;
+  *(ffi_arg *) rvalue = p->a + p->b + raw[1].sint;
+}
+
+int main (void)
+{
+  ffi_cif cif;
+  ffi_type *args[4];
+  ffi_raw raw[4];
+  ffi_raw_closure *cl;
+  void *code;
+  ffi_arg rc;
+  double d;
+  long scale = 3;
+  ffi_type pair_type;
+  ffi_type *pair_elements[3];
+  struct pair p;
+
+  /* Integers and pointers only.  */
+  args[0] = &ffi_type_slong;
+  args[1] = &ffi_type_sint;
+  args[2] = &ffi_type_schar;
+  args[3] = &ffi_type_pointer;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 4, &ffi_type_slong, args)
+	 == FFI_OK);
+  CHECK (ffi_raw_size (&cif) == 4 * sizeof (ffi_raw));
+
+  raw[0].sint = 7;
+  raw[1].sint = -2;
+  raw[2].sint = -3;
+  raw[3].ptr = &scale;
+  ffi_raw_call (&cif, FFI_FN (ints), &rc, raw);
+  CHECK ((long) rc == 7000 - 200 - 30 + 1);
+
+  cl = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_raw_closure_loc (cl, &cif, ints_handler, &scale, code)
+	 == FFI_OK);
+  CHECK (((long (*)(long, int, signed char, void *)) code)
+	 (5, -4, -1, &scale) == 15 - 4 - 1 + 1);
+  ffi_closure_free (cl);
+
+  /* Floating point and unsigned arguments.  */
+  args[0] = &ffi_type_double;
+  args[1] = &ffi_type_uint;
+  args[2] = &ffi_type_float;
+  args[3] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 4, &ffi_type_double, args)
+	 == FFI_OK);
+
+  d = 0.5;
+  memcpy (raw[0].data, &d, sizeof (d));
+  raw[1].uint = 10;
+  raw[2].flt = 0.25f;
+  raw[3].sint = -100;
+  ffi_raw_call (&cif, FFI_FN (mixed), &d, raw);
+  CHECK (d == 0.5 + 10 + 0.25 - 100);
+
+  cl = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_raw_closure_loc (cl, &cif, mixed_handler, NULL, code)
+	 == FFI_OK);
+  CHECK (((double (*)(double, unsigned int, float, long)) code)
+	 (1.5, 0x80000001u, 2.0f, -4) == 1.5 + 2.0 - 4);
+  ffi_closure_free (cl);
+
+  /* Structures are passed by reference in the raw array.  */
+  pair_type.size = pair_type.alignment = 0;
+  pair_type.type = FFI_TYPE_STRUCT;
+  pair_type.elements = pair_elements;
+  pair_elements[0] = pair_elements[1] = &ffi_type_slong;
+  pair_elements[2] = NULL;
+
+  args[0] = &pair_type;
+  args[1] = &ffi_type_slong;
+  CHECK (ffi_prep_cif (&cif, FFI_DEFAULT_ABI, 2, &ffi_type_slong, args)
+	 == FFI_OK);
+
+  p.a = 1;
+  p.b = 2;
+  raw[0].ptr = &p;
+  raw[1].sint = 3;
+  ffi_raw_call (&cif, FFI_FN (by_value), &rc, raw);
+  CHECK ((long) rc == 123);
+
+  cl = ffi_closure_alloc (sizeof (ffi_raw_closure), &code);
+  CHECK (cl != NULL);
+  CHECK (ffi_prep_raw_closure_loc (cl, &cif, by_value_handler, NULL, code)
+	 == FFI_OK);
+  CHECK (((long (*)(struct pair, long)) code) (p, 4) == 7);
+  ffi_closure_free (cl);
+
+  exit (0);
+}